@@ -0,0 +1,346 @@
+// badge_hid_host.c
+//
+// HID host report parser for gamepad, mouse and keyboard input devices.
+// Contains low-level helpers for parsing raw USB HID input reports.
+
+#include "badge_hid_host.h"
+#include <string.h>
+#include "usb/hid_usage_keyboard.h"
+#include "usb/hid_usage_mouse.h"
+
+/**
+ * @brief Sign-extends a 12-bit value to a 16-bit signed integer.
+ *
+ * Many HID mice encode high-resolution X/Y deltas using 12-bit signed values.
+ * This function correctly extends them to usable 16-bit signed values.
+ *
+ * @param value A 12-bit unsigned value (lower 12 bits significant).
+ * @return int16_t Signed version of the value.
+ */
+int16_t sign_extend_12bit(uint16_t value) {
+    if (value & 0x800) {
+        // If the 12th bit is set (negative number in 12-bit signed)
+        return (int16_t)(value | 0xF000);  // Fill top 4 bits with 1s
+    } else {
+        return (int16_t)(value & 0x0FFF);  // Mask to 12 bits
+    }
+}
+
+/**
+ * @brief Parses a mouse input report into a structured format.
+ *
+ * Supports both boot protocol reports (3 or 4 bytes) and extended HID reports.
+ * Guesses the layout from the report length; used when no report descriptor plan is available.
+ *
+ * @param data Raw pointer to HID report data.
+ * @param length Length of the report in bytes.
+ * @return mouse_report_t Parsed report with movement and button states.
+ */
+mouse_report_t parse_mouse_event(const uint8_t* const data, const int length) {
+    mouse_report_t mouse_report = {0};
+
+    if (length <= 4) {
+        hid_mouse_input_report_boot_t* boot_mouse_report = (hid_mouse_input_report_boot_t*)data;
+        mouse_report.x_displacement                      = boot_mouse_report->x_displacement;
+        mouse_report.y_displacement                      = boot_mouse_report->y_displacement;
+        mouse_report.buttons.val                         = boot_mouse_report->buttons.val;
+        if (length == 4) {
+            mouse_report.scroll = (int8_t)data[3];
+        }
+    } else if (length == 5) {
+        mouse_report.buttons.val    = data[0];
+        mouse_report.x_displacement = (int8_t)data[1];
+        mouse_report.y_displacement = (int8_t)data[2];
+        mouse_report.scroll         = (int8_t)data[3];
+        mouse_report.tilt           = (int8_t)data[4];
+    } else if (length < 9) {
+        mouse_report.buttons.val    = data[1];
+        mouse_report.x_displacement = sign_extend_12bit((data[4] & 0x0F) << 8) | data[3];
+        mouse_report.y_displacement = sign_extend_12bit(data[5] << 4) | (data[4] >> 4);
+        if (length >= 7) {
+            mouse_report.scroll = (int8_t)data[6];
+        }
+        if (length == 8) {
+            mouse_report.tilt = (int8_t)data[7];
+        }
+    } else {
+        mouse_report.buttons.val    = data[1];
+        mouse_report.x_displacement = (int16_t)((data[4] << 8) | data[3]);
+        mouse_report.y_displacement = (int16_t)((data[6] << 8) | data[5]);
+        mouse_report.scroll         = (int8_t)data[7];
+        mouse_report.tilt           = (int8_t)data[8];
+    }
+
+    return mouse_report;
+}
+
+/**
+ * @brief Parses a gamepad HID report into the standard format.
+ *
+ * This function should be implemented per controller type (e.g., PS4, Xbox).
+ * It fills out the gamepad_report_t with button and axis values.
+ *
+ * @param rpt Pointer to the report struct to populate.
+ * @param data Raw HID report data.
+ * @param length Report length in bytes.
+ * @return true if parsing was successful; false otherwise.
+ */
+gamepad_report_t parse_gamepad_report(const uint8_t* data, int length) {
+    gamepad_report_t rpt = {0};
+
+    if (length < 10) return rpt;
+
+    rpt.report_id = data[0];
+
+    uint8_t hat = data[1];
+    uint8_t b1  = data[2];
+    uint8_t b2  = data[3];
+
+    rpt.buttons.val = 0;
+
+    rpt.buttons.up    = (hat == 0x00 || hat == 0x01 || hat == 0x07);
+    rpt.buttons.right = (hat == 0x01 || hat == 0x02 || hat == 0x03);
+    rpt.buttons.down  = (hat == 0x03 || hat == 0x04 || hat == 0x05);
+    rpt.buttons.left  = (hat == 0x05 || hat == 0x06 || hat == 0x07);
+
+    // Face buttons
+    rpt.buttons.a = (b2 >> 6) & 1;
+    rpt.buttons.b = (b2 >> 5) & 1;
+    rpt.buttons.x = (b2 >> 4) & 1;
+    rpt.buttons.y = (b2 >> 3) & 1;
+
+    // Thumbsticks
+    rpt.buttons.l1 = (b2 >> 0) & 1;
+    rpt.buttons.r1 = (b1 >> 7) & 1;
+
+    // Shoulders and triggers
+    rpt.buttons.l2 = (b2 >> 2) & 1;
+    rpt.buttons.r2 = (b2 >> 1) & 1;
+    rpt.buttons.l3 = (b1 >> 2) & 1;
+    rpt.buttons.r3 = (b1 >> 3) & 1;
+
+    // Extra buttons
+    rpt.buttons.l4     = (b1 >> 1) & 1;
+    rpt.buttons.r4     = (b1 >> 0) & 1;
+    rpt.buttons.select = (b1 >> 6) & 1;
+    rpt.buttons.start  = (b1 >> 5) & 1;
+    rpt.buttons.home   = (b1 >> 4) & 1;
+
+    rpt.lx = data[4];
+    rpt.ly = data[5];
+    rpt.rx = data[6];
+    rpt.ry = data[7];
+    rpt.lt = data[8];
+    rpt.rt = data[9];
+
+    return rpt;
+}
+
+/**
+ * @brief Formats the pressed gamepad buttons as a "Buttons: A B ..." line.
+ *
+ * @param rpt Parsed gamepad report.
+ * @param out Destination buffer.
+ * @param size Size of the destination buffer.
+ */
+void gamepad_format_buttons(const gamepad_report_t* rpt, char* out, size_t size) {
+    const char* btn_labels[] = {"A",  "B",  "X",      "Y",     "L1",   "R1",   "L2",    "R2", "L3",  "R3",
+                                "L4", "R4", "Select", "Start", "Home", "Left", "Right", "Up", "Down"};
+    const bool  btn_states[] = {rpt->buttons.a,      rpt->buttons.b,     rpt->buttons.x,    rpt->buttons.y,
+                                rpt->buttons.l1,     rpt->buttons.r1,    rpt->buttons.l2,   rpt->buttons.r2,
+                                rpt->buttons.l3,     rpt->buttons.r3,    rpt->buttons.l4,   rpt->buttons.r4,
+                                rpt->buttons.select, rpt->buttons.start, rpt->buttons.home, rpt->buttons.left,
+                                rpt->buttons.right,  rpt->buttons.up,    rpt->buttons.down};
+
+    int used = snprintf(out, size, "Buttons:");
+    for (int i = 0; i < sizeof(btn_labels) / sizeof(btn_labels[0]) && used > 0 && used < size; i++) {
+        if (btn_states[i]) {
+            used += snprintf(out + used, size - used, " %s", btn_labels[i]);
+        }
+    }
+}
+
+/**
+ * @brief Keeps the previously pressed keys when a report signals a rollover error
+ *
+ * A keyboard that cannot tell which keys are down reports ErrorRollOver in every key slot;
+ * only its modifiers are still valid.
+ *
+ * @param keys Keys decoded from the rollover report, everything but the modifiers is replaced.
+ * @param prev Keys before the report.
+ */
+void key_bitmap_keep_on_rollover(key_bitmap_t* keys, const key_bitmap_t* prev) {
+    uint8_t modifiers = key_bitmap_modifiers(keys);
+
+    *keys = *prev;
+    keys->words[KEY_BITMAP_MODIFIERS >> 5] &= ~0xFFu;
+    keys->words[KEY_BITMAP_MODIFIERS >> 5] |= modifiers;
+}
+
+/**
+ * @brief Converts a boot keyboard report into a key bitmap.
+ *
+ * The modifier byte becomes the usages 0xE0 to 0xE7, the key slots their usages.
+ *
+ * @param data Raw boot keyboard report.
+ * @param length Report length in bytes.
+ * @param keys Currently pressed keys, replaced by the keys of the report.
+ * @return false for reports that are too short, keys is left untouched.
+ */
+bool keyboard_boot_to_bitmap(const uint8_t* data, int length, key_bitmap_t* keys) {
+    const hid_keyboard_input_report_boot_t* kb_report = (const hid_keyboard_input_report_boot_t*)data;
+    key_bitmap_t                            next      = {0};
+    bool                                    rollover  = false;
+
+    if (length < sizeof(hid_keyboard_input_report_boot_t)) {
+        return false;
+    }
+
+    next.words[KEY_BITMAP_MODIFIERS >> 5] = kb_report->modifier.val;
+    for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
+        if (kb_report->key[i] == HID_KEY_ROLLOVER) {
+            rollover = true;
+        } else if (kb_report->key[i] > HID_KEY_ERROR_UNDEFINED) {
+            key_bitmap_set(&next, kb_report->key[i]);
+        }
+    }
+
+    if (rollover) {
+        key_bitmap_keep_on_rollover(&next, keys);
+    }
+    *keys = next;
+    return true;
+}
+
+static inline size_t emit_events(uint32_t bits, unsigned int word, enum key_state state, uint8_t modifier,
+                                 key_event_t* events, size_t count, size_t max_events, uint32_t* emitted) {
+    while (bits && count < max_events) {
+        unsigned int bit = __builtin_ctz(bits);
+        bits            &= bits - 1;
+        *emitted        |= 1u << bit;
+
+        events[count].key_code = word * 32 + bit;
+        events[count].modifier = modifier;
+        events[count].state    = state;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Turns the difference between two key bitmaps into key press and release events.
+ *
+ * Changed keys are found by XOR and visited with count trailing zeros, so the cost depends on
+ * the number of changes, not on the number of keys held. All releases are reported before
+ * the presses, each in usage order. Modifiers are keys like any other; every event carries
+ * the modifier state after the report.
+ *
+ * @param prev Keys of the previous report, updated for every event written.
+ * @param next Keys of the new report.
+ * @param events Destination for at most max_events events.
+ * @param max_events Size of events. When it is filled, call again for the remaining changes.
+ * @return size_t Number of events written.
+ */
+size_t key_bitmap_diff(key_bitmap_t* prev, const key_bitmap_t* next, key_event_t* events, size_t max_events) {
+    uint8_t modifier = key_bitmap_modifiers(next);
+    size_t  count    = 0;
+
+    for (unsigned int w = 0; w < KEY_BITMAP_WORDS; w++) {
+        uint32_t released = (prev->words[w] ^ next->words[w]) & prev->words[w];
+        uint32_t emitted  = 0;
+
+        count           = emit_events(released, w, KEY_STATE_RELEASED, modifier, events, count, max_events, &emitted);
+        prev->words[w] &= ~emitted;
+    }
+
+    for (unsigned int w = 0; w < KEY_BITMAP_WORDS; w++) {
+        uint32_t pressed = (prev->words[w] ^ next->words[w]) & next->words[w];
+        uint32_t emitted = 0;
+
+        count           = emit_events(pressed, w, KEY_STATE_PRESSED, modifier, events, count, max_events, &emitted);
+        prev->words[w] |= emitted;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Turns the difference between two sets of consumer keys into press and release events
+ *
+ * Releases are reported before presses.
+ *
+ * @param prev Keys of the previous report.
+ * @param next Keys of the new report.
+ * @param events Destination for up to 2 * CONSUMER_KEYS_MAX events.
+ * @return size_t Number of events written.
+ */
+size_t consumer_keys_diff(const consumer_keys_t* prev, const consumer_keys_t* next, consumer_event_t* events) {
+    size_t count = 0;
+
+    for (uint8_t i = 0; i < prev->count; i++) {
+        if (!consumer_keys_test(next, prev->usages[i])) {
+            events[count++] = (consumer_event_t){.state = KEY_STATE_RELEASED, .usage = prev->usages[i]};
+        }
+    }
+    for (uint8_t i = 0; i < next->count; i++) {
+        if (!consumer_keys_test(prev, next->usages[i])) {
+            events[count++] = (consumer_event_t){.state = KEY_STATE_PRESSED, .usage = next->usages[i]};
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Turns the difference between two gamepad reports into button and axis changes
+ *
+ * Buttons are reported before axes. An axis only counts as moved once it is more than the
+ * threshold away from its position in prev, so a jittering stick at rest stays quiet while
+ * a slow drift is still reported when it adds up. prev is updated with the reported changes.
+ *
+ * @param prev Gamepad state last reported, updated.
+ * @param next New report.
+ * @param threshold Largest axis move that is ignored, 0 reports every move.
+ * @param changes Destination for up to GAMEPAD_DIFF_MAX_CHANGES changes.
+ * @return size_t Number of changes written.
+ */
+size_t gamepad_report_diff(gamepad_report_t* prev, const gamepad_report_t* next, uint8_t threshold,
+                           gamepad_change_t* changes) {
+    size_t   count   = 0;
+    uint32_t toggled = prev->buttons.val ^ next->buttons.val;
+
+    for (uint8_t bit = 0; toggled != 0; bit++, toggled >>= 1) {
+        if (toggled & 1) {
+            changes[count++] = (gamepad_change_t){.axis = false, .index = bit, .value = (next->buttons.val >> bit) & 1};
+        }
+    }
+    prev->buttons.val = next->buttons.val;
+    prev->report_id   = next->report_id;
+
+    uint8_t*      prev_axes[GAMEPAD_AXES] = {&prev->lx, &prev->ly, &prev->rx, &prev->ry, &prev->lt, &prev->rt};
+    const uint8_t next_axes[GAMEPAD_AXES] = {next->lx, next->ly, next->rx, next->ry, next->lt, next->rt};
+    for (uint8_t axis = 0; axis < GAMEPAD_AXES; axis++) {
+        int delta = next_axes[axis] - *prev_axes[axis];
+        if (delta > threshold || delta < -threshold) {
+            changes[count++] = (gamepad_change_t){.axis = true, .index = axis, .value = next_axes[axis]};
+            *prev_axes[axis] = next_axes[axis];
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief HID Keyboard modifier verification for capitalization application (right or left shift)
+ *
+ * @param[in] modifier
+ * @return true  Modifier was pressed (left or right shift)
+ * @return false Modifier was not pressed (left or right shift)
+ *
+ */
+static inline bool hid_keyboard_is_modifier_shift(uint8_t modifier) {
+    if (((modifier & HID_LEFT_SHIFT) == HID_LEFT_SHIFT) || ((modifier & HID_RIGHT_SHIFT) == HID_RIGHT_SHIFT)) {
+        return true;
+    }
+    return false;
+}
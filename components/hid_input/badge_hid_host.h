@@ -0,0 +1,205 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Bit positions of the gamepad buttons in gamepad_report_t.buttons.val
+ */
+typedef enum {
+    GAMEPAD_BUTTON_A = 0,
+    GAMEPAD_BUTTON_B,
+    GAMEPAD_BUTTON_X,
+    GAMEPAD_BUTTON_Y,
+    GAMEPAD_BUTTON_SELECT,
+    GAMEPAD_BUTTON_START,
+    GAMEPAD_BUTTON_L1,
+    GAMEPAD_BUTTON_R1,
+    GAMEPAD_BUTTON_L2,
+    GAMEPAD_BUTTON_R2,
+    GAMEPAD_BUTTON_L3,
+    GAMEPAD_BUTTON_R3,
+    GAMEPAD_BUTTON_HOME,
+    GAMEPAD_BUTTON_L4,
+    GAMEPAD_BUTTON_R4,
+    GAMEPAD_BUTTON_UP,
+    GAMEPAD_BUTTON_DOWN,
+    GAMEPAD_BUTTON_LEFT,
+    GAMEPAD_BUTTON_RIGHT
+} gamepad_button_bit_t;
+
+typedef struct {
+    uint8_t report_id;
+
+    union {
+        struct {
+            uint32_t a : 1;
+            uint32_t b : 1;
+            uint32_t x : 1;
+            uint32_t y : 1;
+
+            uint32_t select : 1;
+            uint32_t start  : 1;
+
+            uint32_t l1 : 1;
+            uint32_t r1 : 1;
+            uint32_t l2 : 1;
+            uint32_t r2 : 1;
+            uint32_t l3 : 1;
+            uint32_t r3 : 1;
+
+            uint32_t home : 1;
+
+            uint32_t l4 : 1;
+            uint32_t r4 : 1;
+
+            uint32_t up    : 1;
+            uint32_t down  : 1;
+            uint32_t left  : 1;
+            uint32_t right : 1;
+
+            uint32_t _reserved : 13;  // Up to 32 bits total
+        };
+        uint32_t val;
+    } buttons;
+
+    uint8_t lx, ly;
+    uint8_t rx, ry;
+    uint8_t lt, rt;
+} gamepad_report_t;
+
+#define GAMEPAD_AXES             6                    // lx, ly, rx, ry, lt, rt
+#define GAMEPAD_DIFF_MAX_CHANGES (32 + GAMEPAD_AXES)  // Changes a gamepad_report_diff() call writes at most
+
+typedef enum {
+    GAMEPAD_AXIS_LX = 0,
+    GAMEPAD_AXIS_LY,
+    GAMEPAD_AXIS_RX,
+    GAMEPAD_AXIS_RY,
+    GAMEPAD_AXIS_LT,
+    GAMEPAD_AXIS_RT
+} gamepad_axis_t;
+
+/**
+ * @brief Change of one gamepad button or axis between two reports
+ */
+typedef struct {
+    bool    axis;   // An axis moved, otherwise a button was pressed or released
+    uint8_t index;  // gamepad_button_bit_t or gamepad_axis_t
+    uint8_t value;  // 1 pressed or 0 released, the new position for axes
+} gamepad_change_t;
+
+typedef struct {
+    union {
+        struct {
+            uint8_t button1  : 1;
+            uint8_t button2  : 1;
+            uint8_t button3  : 1;
+            uint8_t reserved : 5;
+        };
+        uint8_t val;
+    } buttons;
+    int16_t x_displacement;
+    int16_t y_displacement;
+    int8_t  scroll;
+    int8_t  tilt;
+} mouse_report_t;
+
+/**
+ * @brief Key event
+ */
+typedef struct {
+    enum key_state {
+        KEY_STATE_PRESSED  = 0x00,
+        KEY_STATE_RELEASED = 0x01,
+        KEY_STATE_REPEAT   = 0x02  // Synthetic, generated while a key is held (key_repeat.c)
+    } state;
+    uint8_t modifier;
+    uint8_t key_code;
+} key_event_t;
+
+#define KEYBOARD_BOOT_KEYS       6
+#define KEYBOARD_DIFF_MAX_EVENTS 16    // Events per key_bitmap_diff() call, call again while it returns this many
+#define KEY_BITMAP_WORDS         8     // 256 keyboard usages
+#define KEY_BITMAP_MODIFIERS     0xE0  // Usage of the first modifier key (left control)
+
+/**
+ * @brief Set of pressed keys, one bit per keyboard usage
+ *
+ * Used for boot and NKRO keyboards alike. The eight modifiers are the usages 0xE0 to 0xE7,
+ * the low byte of the last word.
+ */
+typedef struct {
+    uint32_t words[KEY_BITMAP_WORDS];
+} key_bitmap_t;
+
+static inline void key_bitmap_set(key_bitmap_t* keys, uint8_t usage) {
+    keys->words[usage >> 5] |= 1u << (usage & 31);
+}
+
+static inline bool key_bitmap_test(const key_bitmap_t* keys, uint8_t usage) {
+    return (keys->words[usage >> 5] >> (usage & 31)) & 1;
+}
+
+static inline uint8_t key_bitmap_modifiers(const key_bitmap_t* keys) {
+    return keys->words[KEY_BITMAP_MODIFIERS >> 5] & 0xFF;
+}
+
+#define CONSUMER_KEYS_MAX 4  // Consumer control usages held at once, further ones are ignored
+
+/**
+ * @brief Consumer control (media) keys held down, as 16 bit consumer page usages
+ */
+typedef struct {
+    uint16_t usages[CONSUMER_KEYS_MAX];
+    uint8_t  count;
+} consumer_keys_t;
+
+/**
+ * @brief Consumer control key event
+ */
+typedef struct {
+    enum key_state state;  // KEY_STATE_PRESSED or KEY_STATE_RELEASED
+    uint16_t       usage;
+} consumer_event_t;
+
+static inline bool consumer_keys_test(const consumer_keys_t* keys, uint16_t usage) {
+    for (uint8_t i = 0; i < keys->count; i++) {
+        if (keys->usages[i] == usage) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void consumer_keys_add(consumer_keys_t* keys, uint16_t usage) {
+    if (usage != 0 && keys->count < CONSUMER_KEYS_MAX && !consumer_keys_test(keys, usage)) {
+        keys->usages[keys->count++] = usage;
+    }
+}
+
+/* Main char symbol for ENTER key */
+#define KEYBOARD_ENTER_MAIN_CHAR '\r'
+/* When set to 1 pressing ENTER will be extending with LineFeed during serial debug output */
+#define KEYBOARD_ENTER_LF_EXTEND 1
+
+int16_t sign_extend_12bit(uint16_t value);
+
+mouse_report_t parse_mouse_event(const uint8_t* const data, const int length);
+
+gamepad_report_t parse_gamepad_report(const uint8_t* data, int length);
+
+bool keyboard_boot_to_bitmap(const uint8_t* data, int length, key_bitmap_t* keys);
+
+void key_bitmap_keep_on_rollover(key_bitmap_t* keys, const key_bitmap_t* prev);
+
+size_t key_bitmap_diff(key_bitmap_t* prev, const key_bitmap_t* next, key_event_t* events, size_t max_events);
+
+size_t consumer_keys_diff(const consumer_keys_t* prev, const consumer_keys_t* next, consumer_event_t* events);
+
+size_t gamepad_report_diff(gamepad_report_t* prev, const gamepad_report_t* next, uint8_t threshold,
+                           gamepad_change_t* changes);
+
+void gamepad_format_buttons(const gamepad_report_t* rpt, char* out, size_t size);
@@ -0,0 +1,294 @@
+// hid_input.c
+//
+// Decodes the raw reports of one HID interface into input events.
+// Reports are routed by report ID (see hid_route.h), decoded with the compiled report
+// descriptor or the boot layout, and published on an event bus. Keyboard and media key
+// state is kept per interface so presses and releases can be told apart.
+
+#include "hid_input.h"
+#include <string.h>
+#include "usb/hid.h"
+#include "usb/hid_usage_mouse.h"
+
+static void build_routes(hid_input_interface_t* iface) {
+    // NKRO keyboards only report all of their keys in report protocol
+    iface->keyboard_boot = HID_SUBCLASS_BOOT_INTERFACE == iface->sub_class &&
+                           !(iface->has_plan && hid_plan_is_nkro_keyboard(&iface->plan));
+    hid_route_build(&iface->routes, iface->has_plan ? &iface->plan : NULL, iface->sub_class, iface->protocol,
+                    iface->keyboard_boot);
+}
+
+/**
+ * @brief Sets up the decoding of an interface at connect
+ *
+ * @param[in] iface        Interface state
+ * @param[in] device_id    Slot of the interface, carried in its events
+ * @param[in] sub_class    Interface subclass
+ * @param[in] protocol     Interface protocol
+ * @param[in] desc         Report descriptor, NULL when there is none
+ * @param[in] desc_length  Length of the report descriptor
+ */
+void hid_input_interface_init(hid_input_interface_t* iface, uint8_t device_id, uint8_t sub_class, uint8_t protocol,
+                              const uint8_t* desc, size_t desc_length) {
+    memset(iface, 0, sizeof(*iface));
+    iface->device_id = device_id;
+    iface->sub_class = sub_class;
+    iface->protocol  = protocol;
+    iface->has_plan  = desc != NULL && hid_plan_compile(desc, desc_length, &iface->plan);
+    build_routes(iface);
+}
+
+/**
+ * @brief Sets up the decoding of an interface with a plan compiled at an earlier connect
+ *
+ * @param[in] iface      Interface state
+ * @param[in] device_id  Slot of the interface, carried in its events
+ * @param[in] sub_class  Interface subclass
+ * @param[in] protocol   Interface protocol
+ * @param[in] plan       Plan of the report descriptor, NULL when it did not compile
+ */
+void hid_input_interface_init_plan(hid_input_interface_t* iface, uint8_t device_id, uint8_t sub_class,
+                                   uint8_t protocol, const hid_plan_t* plan) {
+    memset(iface, 0, sizeof(*iface));
+    iface->device_id = device_id;
+    iface->sub_class = sub_class;
+    iface->protocol  = protocol;
+    iface->has_plan  = plan != NULL;
+    if (plan != NULL) {
+        iface->plan = *plan;
+    }
+    build_routes(iface);
+}
+
+/**
+ * @brief Publishes a key event that is not tied to a report, such as a key repeat
+ *
+ * @return false when the event was dropped, the pool is exhausted
+ */
+bool hid_input_publish_key(hid_input_bus_t* bus, uint8_t device_id, const key_event_t* key, int64_t timestamp_us) {
+    hid_input_event_t* event = hid_input_event_alloc(bus, HID_INPUT_EVENT_KEY, device_id, 0, timestamp_us);
+    if (event == NULL) {
+        return false;
+    }
+    event->key = *key;
+    hid_input_publish(bus, event);
+    return true;
+}
+
+static size_t decode_keyboard(hid_input_interface_t* iface, hid_input_bus_t* bus, hid_route_t route,
+                              uint8_t report_id, const uint8_t* data, size_t length, int64_t timestamp_us) {
+    key_bitmap_t keys = iface->keys;
+    bool         valid;
+
+    if (HID_ROUTE_KEYBOARD_BOOT == route.kind) {
+        valid = keyboard_boot_to_bitmap(data, length, &keys);
+    } else {
+        valid = hid_plan_decode_keyboard(&iface->plan, &iface->plan.reports[route.report], data, length, &keys);
+    }
+    if (!valid) {
+        return 0;
+    }
+
+    // The key state is tracked even without subscribers, so a late one does not see stale presses
+    bool        publish   = hid_input_bus_wants(bus, HID_INPUT_EVENT_KEY);
+    size_t      published = 0;
+    key_event_t key_events[KEYBOARD_DIFF_MAX_EVENTS];
+    size_t      count;
+    do {
+        count = key_bitmap_diff(&iface->keys, &keys, key_events, KEYBOARD_DIFF_MAX_EVENTS);
+        for (size_t i = 0; i < count && publish; i++) {
+            hid_input_event_t* event =
+                hid_input_event_alloc(bus, HID_INPUT_EVENT_KEY, iface->device_id, report_id, timestamp_us);
+            if (event != NULL) {
+                event->key = key_events[i];
+                hid_input_publish(bus, event);
+                published++;
+            }
+        }
+    } while (count == KEYBOARD_DIFF_MAX_EVENTS);
+
+    if (hid_input_bus_wants(bus, HID_INPUT_EVENT_KEYBOARD)) {
+        hid_input_event_t* event =
+            hid_input_event_alloc(bus, HID_INPUT_EVENT_KEYBOARD, iface->device_id, report_id, timestamp_us);
+        if (event != NULL) {
+            event->keys = keys;
+            hid_input_event_set_raw(event, data, length);
+            hid_input_publish(bus, event);
+            published++;
+        }
+    }
+
+    return published;
+}
+
+static size_t decode_mouse(hid_input_interface_t* iface, hid_input_bus_t* bus, hid_route_t route, uint8_t report_id,
+                           const uint8_t* data, size_t length, int64_t timestamp_us) {
+    if (length < sizeof(hid_mouse_input_report_boot_t) || !hid_input_bus_wants(bus, HID_INPUT_EVENT_MOUSE)) {
+        return 0;
+    }
+
+    hid_input_event_t* event = hid_input_event_alloc(bus, HID_INPUT_EVENT_MOUSE, iface->device_id, report_id,
+                                                     timestamp_us);
+    if (event == NULL) {
+        return 0;
+    }
+
+    if (HID_ROUTE_MOUSE != route.kind ||
+        !hid_plan_decode_mouse(&iface->plan, &iface->plan.reports[route.report], data, length, &event->mouse)) {
+        event->mouse = parse_mouse_event(data, length);
+    }
+    hid_input_event_set_raw(event, data, length);
+    hid_input_publish(bus, event);
+    return 1;
+}
+
+static size_t publish_gamepad(hid_input_interface_t* iface, hid_input_bus_t* bus, uint8_t report_id,
+                              const gamepad_report_t* rpt, bool valid, const uint8_t* data, size_t length,
+                              int64_t timestamp_us) {
+    if (!hid_input_bus_wants(bus, HID_INPUT_EVENT_GAMEPAD)) {
+        return 0;
+    }
+
+    hid_input_event_t* event = hid_input_event_alloc(bus, HID_INPUT_EVENT_GAMEPAD, iface->device_id, report_id,
+                                                     timestamp_us);
+    if (event == NULL) {
+        return 0;
+    }
+    event->gamepad.report = *rpt;
+    event->gamepad.valid  = valid;
+    hid_input_event_set_raw(event, data, length);
+    hid_input_publish(bus, event);
+    return 1;
+}
+
+static size_t decode_gamepad(hid_input_interface_t* iface, hid_input_bus_t* bus, hid_route_t route,
+                             uint8_t report_id, const uint8_t* data, size_t length, int64_t timestamp_us) {
+    bool publish_buttons = hid_input_bus_wants(bus, HID_INPUT_EVENT_GAMEPAD_BUTTON);
+    bool publish_axes    = hid_input_bus_wants(bus, HID_INPUT_EVENT_GAMEPAD_AXIS);
+    if (!publish_buttons && !publish_axes && !hid_input_bus_wants(bus, HID_INPUT_EVENT_GAMEPAD)) {
+        return 0;
+    }
+
+    // Most pads send a full report on every poll whether anything changed or not. Once a
+    // repeated report decoded to no change, further repeats are dropped before decoding.
+    bool repeat = length == iface->gamepad_raw_length && memcmp(data, iface->gamepad_raw, length) == 0;
+    if (repeat && iface->gamepad_settled) {
+        iface->gamepad_unchanged++;
+        return 0;
+    }
+    if (!repeat) {
+        // Reports too long to keep are never taken for repeats
+        iface->gamepad_raw_length = length <= HID_INPUT_RAW_MAX ? length : 0;
+        memcpy(iface->gamepad_raw, data, iface->gamepad_raw_length);
+    }
+
+    gamepad_report_t rpt   = {0};
+    bool             valid = false;
+    if (HID_ROUTE_GAMEPAD == route.kind) {
+        valid = hid_plan_decode_gamepad(&iface->plan, &iface->plan.reports[route.report], data, length, &rpt);
+    }
+    if (!valid && length >= 10) {
+        rpt   = parse_gamepad_report(data, length);
+        valid = true;
+    }
+
+    if (!valid) {
+        // Published once for the raw bytes, the next valid report is published whether it changed or not
+        iface->gamepad_settled = true;
+        iface->gamepad_valid   = false;
+        if (repeat) {
+            iface->gamepad_unchanged++;
+            return 0;
+        }
+        memset(&rpt, 0, sizeof(rpt));
+        return publish_gamepad(iface, bus, report_id, &rpt, false, data, length, timestamp_us);
+    }
+
+    if (iface->gamepad_filter != NULL) {
+        iface->gamepad_filter(&rpt, timestamp_us, iface->gamepad_filter_arg);
+    }
+
+    // Compared after the filter: a smoothed axis keeps moving for a while after the raw report settled
+    gamepad_change_t changes[GAMEPAD_DIFF_MAX_CHANGES];
+    size_t           count = gamepad_report_diff(&iface->gamepad, &rpt, iface->gamepad_axis_threshold, changes);
+    bool             first = !iface->gamepad_valid;
+    iface->gamepad_valid   = true;
+    iface->gamepad_settled = repeat && count == 0;
+    if (count == 0 && !first) {
+        iface->gamepad_unchanged++;
+        return 0;
+    }
+
+    size_t published = 0;
+    for (size_t i = 0; i < count; i++) {
+        hid_input_event_type_t type = changes[i].axis ? HID_INPUT_EVENT_GAMEPAD_AXIS : HID_INPUT_EVENT_GAMEPAD_BUTTON;
+        if (!(changes[i].axis ? publish_axes : publish_buttons)) {
+            continue;
+        }
+
+        hid_input_event_t* event = hid_input_event_alloc(bus, type, iface->device_id, report_id, timestamp_us);
+        if (event != NULL) {
+            event->gamepad_change = changes[i];
+            hid_input_publish(bus, event);
+            published++;
+        }
+    }
+
+    return published + publish_gamepad(iface, bus, report_id, &rpt, true, data, length, timestamp_us);
+}
+
+static size_t decode_consumer(hid_input_interface_t* iface, hid_input_bus_t* bus, hid_route_t route,
+                              uint8_t report_id, const uint8_t* data, size_t length, int64_t timestamp_us) {
+    consumer_keys_t keys;
+    if (!hid_plan_decode_consumer(&iface->plan, &iface->plan.reports[route.report], data, length, &keys)) {
+        return 0;
+    }
+
+    consumer_event_t events[2 * CONSUMER_KEYS_MAX];
+    size_t           count = consumer_keys_diff(&iface->consumer, &keys, events);
+    iface->consumer        = keys;
+
+    size_t published = 0;
+    for (size_t i = 0; i < count; i++) {
+        hid_input_event_t* event =
+            hid_input_event_alloc(bus, HID_INPUT_EVENT_CONSUMER, iface->device_id, report_id, timestamp_us);
+        if (event != NULL) {
+            event->consumer = events[i];
+            hid_input_publish(bus, event);
+            published++;
+        }
+    }
+    return published;
+}
+
+/**
+ * @brief Decodes one raw report and publishes its events
+ *
+ * @param[in] iface         Interface the report came from
+ * @param[in] bus           Bus to publish on
+ * @param[in] data          Raw report, starting with the report ID when the interface uses them
+ * @param[in] length        Length of the raw report
+ * @param[in] timestamp_us  Arrival time of the report
+ * @return Number of events published
+ */
+size_t hid_input_interface_report(hid_input_interface_t* iface, hid_input_bus_t* bus, const uint8_t* data,
+                                  size_t length, int64_t timestamp_us) {
+    hid_route_t route     = hid_route_lookup(&iface->routes, data, length);
+    uint8_t     report_id = iface->routes.uses_report_ids && length > 0 ? data[0] : 0;
+
+    switch (route.kind) {
+        case HID_ROUTE_KEYBOARD_BOOT:
+        case HID_ROUTE_KEYBOARD:
+            return decode_keyboard(iface, bus, route, report_id, data, length, timestamp_us);
+        case HID_ROUTE_MOUSE_BOOT:
+        case HID_ROUTE_MOUSE:
+            return decode_mouse(iface, bus, route, report_id, data, length, timestamp_us);
+        case HID_ROUTE_GENERIC:
+        case HID_ROUTE_GAMEPAD:
+            return decode_gamepad(iface, bus, route, report_id, data, length, timestamp_us);
+        case HID_ROUTE_CONSUMER:
+            return decode_consumer(iface, bus, route, report_id, data, length, timestamp_us);
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+#include "hid_input_bus.h"
+#include "hid_plan.h"
+#include "hid_route.h"
+
+typedef void (*hid_input_gamepad_filter_t)(gamepad_report_t* report, int64_t timestamp_us, void* arg);
+
+/**
+ * @brief Decoding state of one HID interface
+ *
+ * Set up once at connect, then fed with the raw reports of the interface from a single
+ * task. Decoded events are published on a bus. Gamepad reports that did not change are
+ * dropped, so a pad polled at a fixed rate costs next to nothing while it is not touched.
+ */
+typedef struct {
+    uint8_t                    device_id;
+    uint8_t                    sub_class;
+    uint8_t                    protocol;
+    bool                       has_plan;  // Report descriptor compiled into plan
+    hid_plan_t                 plan;
+    bool                       keyboard_boot;  // Keyboard reports use the boot layout, not the plan
+    hid_route_table_t          routes;         // Parser of every report ID
+    key_bitmap_t               keys;           // Keys held down
+    consumer_keys_t            consumer;       // Media keys held down
+    hid_input_gamepad_filter_t gamepad_filter;  // Applied to decoded gamepad reports before publishing, optional
+    void*                      gamepad_filter_arg;
+    uint8_t                    gamepad_axis_threshold;  // Axis moves up to this are not reported, 0 reports all
+    bool                       gamepad_valid;           // gamepad holds the last published state
+    bool                       gamepad_settled;         // Repeats of gamepad_raw are dropped without decoding
+    gamepad_report_t           gamepad;                 // Reference of the gamepad change detection
+    uint8_t                    gamepad_raw_length;
+    uint8_t                    gamepad_raw[HID_INPUT_RAW_MAX];  // Previous gamepad report
+    uint32_t                   gamepad_unchanged;               // Gamepad reports dropped without a change
+} hid_input_interface_t;
+
+void hid_input_interface_init(hid_input_interface_t* iface, uint8_t device_id, uint8_t sub_class, uint8_t protocol,
+                              const uint8_t* desc, size_t desc_length);
+
+void hid_input_interface_init_plan(hid_input_interface_t* iface, uint8_t device_id, uint8_t sub_class,
+                                   uint8_t protocol, const hid_plan_t* plan);
+
+size_t hid_input_interface_report(hid_input_interface_t* iface, hid_input_bus_t* bus, const uint8_t* data,
+                                  size_t length, int64_t timestamp_us);
+
+bool hid_input_publish_key(hid_input_bus_t* bus, uint8_t device_id, const key_event_t* key, int64_t timestamp_us);
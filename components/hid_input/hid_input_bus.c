@@ -0,0 +1,207 @@
+// hid_input_bus.c
+//
+// Input event bus with a shared, reference counted event pool.
+// A decoded event is written once into a pool slot and every matching subscriber gets a
+// pointer to it, so adding a subscriber costs a filter check and a call, not a copy.
+// Only the publishing task allocates, which keeps the pool free of locks: a slot is free
+// again when the last reference, possibly dropped by another task, is gone.
+
+#include "hid_input_bus.h"
+#include <string.h>
+
+#define SUBSCRIBER_FREE   0
+#define SUBSCRIBER_SETUP  1
+#define SUBSCRIBER_ACTIVE 2
+
+/**
+ * @brief Sets up an empty bus
+ *
+ * @param[in] bus               Bus
+ * @param[in] events            Event pool
+ * @param[in] event_count       Number of events in the pool
+ * @param[in] subscribers       Subscriber slots
+ * @param[in] subscriber_count  Number of subscriber slots
+ */
+void hid_input_bus_init(hid_input_bus_t* bus, hid_input_event_t* events, size_t event_count,
+                        hid_input_subscriber_t* subscribers, size_t subscriber_count) {
+    memset(bus, 0, sizeof(*bus));
+    memset(events, 0, event_count * sizeof(*events));
+    memset(subscribers, 0, subscriber_count * sizeof(*subscribers));
+    bus->events           = events;
+    bus->event_count      = event_count;
+    bus->subscribers      = subscribers;
+    bus->subscriber_count = subscriber_count;
+}
+
+/**
+ * @brief Attaches a subscriber, safe to call from any task
+ *
+ * The callback runs in the publishing task and must not block.
+ *
+ * @param[in] bus       Bus
+ * @param[in] filter    Events to deliver, e.g. HID_INPUT_FILTER_ANY
+ * @param[in] callback  Called with every matching event
+ * @param[in] arg       Passed to the callback
+ * @return Handle for hid_input_unsubscribe(), -1 when all subscriber slots are taken
+ */
+int hid_input_subscribe(hid_input_bus_t* bus, const hid_input_filter_t* filter, hid_input_callback_t callback,
+                        void* arg) {
+    for (size_t i = 0; i < bus->subscriber_count; i++) {
+        hid_input_subscriber_t* subscriber = &bus->subscribers[i];
+        int                     expected   = SUBSCRIBER_FREE;
+        if (!atomic_compare_exchange_strong(&subscriber->state, &expected, SUBSCRIBER_SETUP)) {
+            continue;
+        }
+
+        subscriber->filter   = *filter;
+        subscriber->callback = callback;
+        subscriber->arg      = arg;
+        atomic_store(&subscriber->state, SUBSCRIBER_ACTIVE);
+        return i;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Detaches a subscriber
+ *
+ * An event being dispatched by another task at the same time may still reach the callback.
+ *
+ * @param[in] bus     Bus
+ * @param[in] handle  Handle returned by hid_input_subscribe()
+ */
+void hid_input_unsubscribe(hid_input_bus_t* bus, int handle) {
+    if (handle >= 0 && handle < bus->subscriber_count) {
+        atomic_store(&bus->subscribers[handle].state, SUBSCRIBER_FREE);
+    }
+}
+
+static bool filter_matches(const hid_input_filter_t* filter, const hid_input_event_t* event) {
+    if (!(filter->types & HID_INPUT_TYPE_BIT(event->type))) {
+        return false;
+    }
+    if (filter->report_id >= 0 && filter->report_id != event->report_id) {
+        return false;
+    }
+
+    uint16_t key;
+    if (event->type == HID_INPUT_EVENT_KEY) {
+        key = event->key.key_code;
+    } else if (event->type == HID_INPUT_EVENT_CONSUMER) {
+        key = event->consumer.usage;
+    } else if (event->type == HID_INPUT_EVENT_GAMEPAD_BUTTON || event->type == HID_INPUT_EVENT_GAMEPAD_AXIS) {
+        key = event->gamepad_change.index;
+    } else {
+        return true;
+    }
+    return key >= filter->key_min && key <= filter->key_max;
+}
+
+/**
+ * @brief Checks whether any subscriber takes events of a type, so decoding them can be skipped
+ */
+bool hid_input_bus_wants(const hid_input_bus_t* bus, hid_input_event_type_t type) {
+    for (size_t i = 0; i < bus->subscriber_count; i++) {
+        const hid_input_subscriber_t* subscriber = &bus->subscribers[i];
+        if (atomic_load(&subscriber->state) == SUBSCRIBER_ACTIVE &&
+            (subscriber->filter.types & HID_INPUT_TYPE_BIT(type))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Takes a free event from the pool, only called from the publishing task
+ *
+ * @param[in] bus           Bus
+ * @param[in] type          Event type, the payload is filled in by the caller
+ * @param[in] device_id     Slot of the device the event came from
+ * @param[in] report_id     Report ID of the report the event was decoded from
+ * @param[in] timestamp_us  Arrival time of the report
+ * @return Event holding the reference of the publisher, NULL when the pool is exhausted
+ */
+hid_input_event_t* hid_input_event_alloc(hid_input_bus_t* bus, hid_input_event_type_t type, uint8_t device_id,
+                                         uint8_t report_id, int64_t timestamp_us) {
+    for (size_t n = 0; n < bus->event_count; n++) {
+        hid_input_event_t* event = &bus->events[bus->next];
+        bus->next                = (bus->next + 1) % bus->event_count;
+        if (atomic_load(&event->refs) != 0) {
+            continue;
+        }
+
+        atomic_store(&event->refs, 1);
+        event->type         = type;
+        event->device_id    = device_id;
+        event->report_id    = report_id;
+        event->timestamp_us = timestamp_us;
+        event->raw_length   = 0;
+        return event;
+    }
+
+    bus->dropped++;
+    return NULL;
+}
+
+/**
+ * @brief Copies the raw report an event was decoded from into the event
+ */
+void hid_input_event_set_raw(hid_input_event_t* event, const uint8_t* data, size_t length) {
+    if (length > HID_INPUT_RAW_MAX) {
+        length = HID_INPUT_RAW_MAX;
+    }
+    memcpy(event->raw, data, length);
+    event->raw_length = length;
+}
+
+/**
+ * @brief Hands an event to all matching subscribers and drops the reference of the publisher
+ *
+ * @param[in] bus    Bus
+ * @param[in] event  Event from hid_input_event_alloc()
+ * @return Number of subscribers the event was delivered to
+ */
+size_t hid_input_publish(hid_input_bus_t* bus, hid_input_event_t* event) {
+    size_t delivered = 0;
+
+    for (size_t i = 0; i < bus->subscriber_count; i++) {
+        const hid_input_subscriber_t* subscriber = &bus->subscribers[i];
+        if (atomic_load(&subscriber->state) == SUBSCRIBER_ACTIVE && filter_matches(&subscriber->filter, event)) {
+            subscriber->callback(event, subscriber->arg);
+            delivered++;
+        }
+    }
+
+    bus->published++;
+    bus->delivered += delivered;
+    hid_input_event_release(event);
+    return delivered;
+}
+
+/**
+ * @brief Keeps an event alive after the subscriber callback returned
+ */
+void hid_input_event_retain(const hid_input_event_t* event) {
+    atomic_fetch_add(&((hid_input_event_t*)event)->refs, 1);
+}
+
+/**
+ * @brief Drops a reference, the event returns to the pool with the last one; safe from any task
+ */
+void hid_input_event_release(const hid_input_event_t* event) {
+    atomic_fetch_sub(&((hid_input_event_t*)event)->refs, 1);
+}
+
+/**
+ * @brief Counts the events that are still referenced
+ */
+size_t hid_input_bus_in_use(const hid_input_bus_t* bus) {
+    size_t count = 0;
+    for (size_t i = 0; i < bus->event_count; i++) {
+        if (atomic_load(&bus->events[i].refs) != 0) {
+            count++;
+        }
+    }
+    return count;
+}
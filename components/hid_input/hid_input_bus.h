@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+
+#define HID_INPUT_RAW_MAX 64  // Raw report bytes kept in an event, longer reports are truncated
+
+/**
+ * @brief What an event carries, also the device class subscribers filter on
+ */
+typedef enum {
+    HID_INPUT_EVENT_KEY = 0,   // Key press, release or repeat
+    HID_INPUT_EVENT_KEYBOARD,  // Keys held down after a keyboard report
+    HID_INPUT_EVENT_MOUSE,
+    HID_INPUT_EVENT_GAMEPAD,
+    HID_INPUT_EVENT_CONSUMER,        // Media key press or release
+    HID_INPUT_EVENT_GAMEPAD_BUTTON,  // Gamepad button press or release
+    HID_INPUT_EVENT_GAMEPAD_AXIS,    // Gamepad axis moved
+    HID_INPUT_EVENT_TYPES
+} hid_input_event_type_t;
+
+#define HID_INPUT_TYPE_BIT(type) (1u << (type))
+#define HID_INPUT_TYPES_ALL      ((1u << HID_INPUT_EVENT_TYPES) - 1)
+
+/**
+ * @brief Decoded input event
+ *
+ * Events live in the pool of the bus and are handed to every subscriber by reference. A
+ * subscriber that keeps an event after its callback returned (to hand it to another task)
+ * takes a reference with hid_input_event_retain() and drops it with hid_input_event_release().
+ */
+typedef struct {
+    atomic_uint refs;  // Owned by the bus, 0 while the event is free
+    uint8_t     type;  // hid_input_event_type_t
+    uint8_t     device_id;
+    uint8_t     report_id;  // 0 for interfaces without report IDs
+    uint8_t     raw_length;
+    int64_t     timestamp_us;            // Arrival of the report
+    uint8_t     raw[HID_INPUT_RAW_MAX];  // Report the event was decoded from, empty for key repeats
+    union {
+        key_event_t      key;
+        key_bitmap_t     keys;
+        mouse_report_t   mouse;
+        consumer_event_t consumer;
+        gamepad_change_t gamepad_change;
+        struct {
+            gamepad_report_t report;
+            bool             valid;  // false for reports too short to decode
+        } gamepad;
+    };
+} hid_input_event_t;
+
+/**
+ * @brief Events a subscriber wants
+ *
+ * The key range applies to the key code of key events, the usage of consumer events and
+ * the button or axis of gamepad changes, other types pass it.
+ */
+typedef struct {
+    uint32_t types;      // HID_INPUT_TYPE_BIT() mask
+    int16_t  report_id;  // -1 for any
+    uint16_t key_min;
+    uint16_t key_max;
+} hid_input_filter_t;
+
+#define HID_INPUT_FILTER_ANY {.types = HID_INPUT_TYPES_ALL, .report_id = -1, .key_min = 0, .key_max = UINT16_MAX}
+
+typedef void (*hid_input_callback_t)(const hid_input_event_t* event, void* arg);
+
+typedef struct {
+    atomic_int           state;  // Free, being set up or active
+    hid_input_filter_t   filter;
+    hid_input_callback_t callback;
+    void*                arg;
+} hid_input_subscriber_t;
+
+/**
+ * @brief Input event bus
+ *
+ * One task publishes (allocates from the pool and dispatches), subscribers may attach,
+ * detach and release events from any task. Storage is provided by the caller; zero filled
+ * storage is a valid empty bus, so a static bus needs no initialization.
+ */
+typedef struct {
+    hid_input_event_t*      events;
+    size_t                  event_count;
+    size_t                  next;  // Where the next free event is looked for
+    hid_input_subscriber_t* subscribers;
+    size_t                  subscriber_count;
+    uint32_t                published;
+    uint32_t                delivered;
+    uint32_t                dropped;  // Pool exhausted
+} hid_input_bus_t;
+
+void hid_input_bus_init(hid_input_bus_t* bus, hid_input_event_t* events, size_t event_count,
+                        hid_input_subscriber_t* subscribers, size_t subscriber_count);
+
+int hid_input_subscribe(hid_input_bus_t* bus, const hid_input_filter_t* filter, hid_input_callback_t callback,
+                        void* arg);
+
+void hid_input_unsubscribe(hid_input_bus_t* bus, int handle);
+
+bool hid_input_bus_wants(const hid_input_bus_t* bus, hid_input_event_type_t type);
+
+hid_input_event_t* hid_input_event_alloc(hid_input_bus_t* bus, hid_input_event_type_t type, uint8_t device_id,
+                                         uint8_t report_id, int64_t timestamp_us);
+
+void hid_input_event_set_raw(hid_input_event_t* event, const uint8_t* data, size_t length);
+
+size_t hid_input_publish(hid_input_bus_t* bus, hid_input_event_t* event);
+
+void hid_input_event_retain(const hid_input_event_t* event);
+
+void hid_input_event_release(const hid_input_event_t* event);
+
+size_t hid_input_bus_in_use(const hid_input_bus_t* bus);
@@ -0,0 +1,135 @@
+// hid_input_snapshot.c
+//
+// Sequence locked snapshot of the current input state.
+// The writer bumps the sequence to odd, updates the state and bumps it to even again. A
+// reader copies the state between two reads of the sequence and keeps the copy only when
+// both reads saw the same even value. Writes are a few dozen bytes, so a reader retries at
+// most a couple of times even when it polls while a device floods reports.
+
+#include "hid_input_snapshot.h"
+#include <string.h>
+
+static void write_begin(hid_input_snapshot_t* snapshot) {
+    unsigned sequence = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, sequence + 1, memory_order_relaxed);
+    // The odd sequence has to be visible before any of the state changes
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(hid_input_snapshot_t* snapshot) {
+    snapshot->state.updates++;
+    unsigned sequence = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, sequence + 1, memory_order_release);
+}
+
+static void merge_keys(hid_input_snapshot_t* snapshot) {
+    key_bitmap_t* keys = &snapshot->state.keys;
+    memset(keys, 0, sizeof(*keys));
+    for (size_t i = 0; i < HID_INPUT_SNAPSHOT_DEVICES; i++) {
+        for (size_t word = 0; word < KEY_BITMAP_WORDS; word++) {
+            keys->words[word] |= snapshot->device_keys[i].words[word];
+        }
+    }
+}
+
+/**
+ * @brief Input bus subscriber that updates the snapshot
+ *
+ * Subscribe with the keyboard, mouse and gamepad event types.
+ *
+ * @param[in] event  Event to apply
+ * @param[in] arg    Snapshot to update
+ */
+void hid_input_snapshot_event(const hid_input_event_t* event, void* arg) {
+    hid_input_snapshot_t* snapshot = (hid_input_snapshot_t*)arg;
+    if (event->device_id >= HID_INPUT_SNAPSHOT_DEVICES) {
+        return;
+    }
+
+    switch (event->type) {
+        case HID_INPUT_EVENT_KEYBOARD:
+            snapshot->device_keys[event->device_id] = event->keys;
+            write_begin(snapshot);
+            merge_keys(snapshot);
+            write_end(snapshot);
+            break;
+        case HID_INPUT_EVENT_MOUSE:
+            write_begin(snapshot);
+            snapshot->state.pointer.x       += event->mouse.x_displacement;
+            snapshot->state.pointer.y       += event->mouse.y_displacement;
+            snapshot->state.pointer.scroll  += event->mouse.scroll;
+            snapshot->state.pointer.tilt    += event->mouse.tilt;
+            snapshot->state.pointer.buttons  = event->mouse.buttons.val;
+            write_end(snapshot);
+            break;
+        case HID_INPUT_EVENT_GAMEPAD:
+            if (!event->gamepad.valid) {
+                break;
+            }
+            write_begin(snapshot);
+            snapshot->state.pads[event->device_id].report = event->gamepad.report;
+            snapshot->state.pads[event->device_id].valid  = true;
+            write_end(snapshot);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Releases the keys and forgets the pad of a disconnected device, call from the writer task
+ *
+ * @param[in] snapshot   Snapshot
+ * @param[in] device_id  Slot of the device
+ */
+void hid_input_snapshot_clear_device(hid_input_snapshot_t* snapshot, uint8_t device_id) {
+    if (device_id >= HID_INPUT_SNAPSHOT_DEVICES) {
+        return;
+    }
+
+    memset(&snapshot->device_keys[device_id], 0, sizeof(snapshot->device_keys[device_id]));
+    write_begin(snapshot);
+    merge_keys(snapshot);
+    memset(&snapshot->state.pads[device_id], 0, sizeof(snapshot->state.pads[device_id]));
+    write_end(snapshot);
+}
+
+/**
+ * @brief Copies the state once, safe from any task or core
+ *
+ * @param[in]  snapshot  Snapshot
+ * @param[out] out       Copy of the state, only valid when true is returned
+ * @return false when a write overlapped the copy
+ */
+bool hid_input_snapshot_try_read(const hid_input_snapshot_t* snapshot, hid_input_state_t* out) {
+    unsigned before = atomic_load_explicit(&((hid_input_snapshot_t*)snapshot)->sequence, memory_order_acquire);
+    if (before & 1) {
+        return false;
+    }
+
+    memcpy(out, &snapshot->state, sizeof(*out));
+
+    // The copy has to be complete before the sequence is checked again
+    atomic_thread_fence(memory_order_acquire);
+    unsigned after = atomic_load_explicit(&((hid_input_snapshot_t*)snapshot)->sequence, memory_order_relaxed);
+    return before == after;
+}
+
+/**
+ * @brief Copies a consistent state, retrying a few times while the writer is busy
+ *
+ * Safe from any task or core and bounded: after HID_INPUT_SNAPSHOT_READ_TRIES overlapped
+ * copies it gives up, which only happens when the caller keeps the writer from finishing.
+ *
+ * @param[in]  snapshot  Snapshot
+ * @param[out] out       Copy of the state, only valid when true is returned
+ * @return false when every copy overlapped a write, try again after blocking or yielding
+ */
+bool hid_input_snapshot_read(const hid_input_snapshot_t* snapshot, hid_input_state_t* out) {
+    for (int i = 0; i < HID_INPUT_SNAPSHOT_READ_TRIES; i++) {
+        if (hid_input_snapshot_try_read(snapshot, out)) {
+            return true;
+        }
+    }
+    return false;
+}
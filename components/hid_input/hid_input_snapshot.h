@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+#include "hid_input_bus.h"
+
+#define HID_INPUT_SNAPSHOT_DEVICES    16  // Device slots tracked, events of higher slots are ignored
+#define HID_INPUT_SNAPSHOT_READ_TRIES 8   // Copies hid_input_snapshot_read() attempts before it gives up
+
+/**
+ * @brief Current input state of all devices together
+ */
+typedef struct {
+    uint32_t     updates;  // Incremented by every change, tells pollers whether anything happened
+    key_bitmap_t keys;     // Keys held down on any keyboard, modifiers included
+    struct {
+        int32_t x;  // Motion of all mice summed since boot, in mouse counts
+        int32_t y;
+        int32_t scroll;
+        int32_t tilt;
+        uint8_t buttons;  // Buttons of the most recent mouse report
+    } pointer;
+    struct {
+        bool             valid;  // A report was decoded since the pad connected
+        gamepad_report_t report;
+    } pads[HID_INPUT_SNAPSHOT_DEVICES];  // Indexed by device slot
+} hid_input_state_t;
+
+/**
+ * @brief Input state kept up to date from the input bus, readable from any task or core
+ *
+ * Written by the publishing task only, under a sequence lock: readers copy the state and
+ * retry when a write overlapped, so they never block the writer and the writer never waits
+ * for readers. Zero filled storage is a valid empty snapshot.
+ *
+ * A reader that preempts the writer in the middle of a write (same core, higher priority)
+ * sees the write in progress until it lets the writer run again, so reads give up after a
+ * few tries instead of spinning; such a reader has to block or yield and try again later.
+ */
+typedef struct {
+    atomic_uint       sequence;  // Odd while a write is in progress
+    hid_input_state_t state;
+    key_bitmap_t      device_keys[HID_INPUT_SNAPSHOT_DEVICES];  // Keys per keyboard, only touched by the writer
+} hid_input_snapshot_t;
+
+void hid_input_snapshot_event(const hid_input_event_t* event, void* arg);
+
+void hid_input_snapshot_clear_device(hid_input_snapshot_t* snapshot, uint8_t device_id);
+
+bool hid_input_snapshot_try_read(const hid_input_snapshot_t* snapshot, hid_input_state_t* out);
+
+bool hid_input_snapshot_read(const hid_input_snapshot_t* snapshot, hid_input_state_t* out);
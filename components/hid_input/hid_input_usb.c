@@ -0,0 +1,99 @@
+// hid_input_usb.c
+//
+// Glue between the USB HID host driver and the input decoding: the shared event bus and
+// input state snapshot of the firmware, and the interface setup done on connect.
+
+#include "hid_input_usb.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "usb/hid_host.h"
+
+// Constants
+static char const TAG[] = "hid_input";
+
+// Global variables
+static hid_input_event_t      events[CONFIG_HID_INPUT_EVENT_POOL_SIZE];
+static hid_input_subscriber_t subscribers[CONFIG_HID_INPUT_MAX_SUBSCRIBERS];
+
+// Zero filled storage is an empty bus, see hid_input_bus_t
+static hid_input_bus_t bus = {
+    .events           = events,
+    .event_count      = CONFIG_HID_INPUT_EVENT_POOL_SIZE,
+    .subscribers      = subscribers,
+    .subscriber_count = CONFIG_HID_INPUT_MAX_SUBSCRIBERS,
+};
+
+static hid_input_snapshot_t snapshot;
+
+/**
+ * @brief Returns the bus all HID interfaces publish their events on
+ */
+hid_input_bus_t* hid_input_get_bus(void) {
+    return &bus;
+}
+
+/**
+ * @brief Returns the snapshot of the current input state of all devices
+ *
+ * Kept up to date once subscribed to the bus with hid_input_snapshot_event().
+ */
+hid_input_snapshot_t* hid_input_get_snapshot(void) {
+    return &snapshot;
+}
+
+/**
+ * @brief Sets up the decoding of a newly connected interface
+ *
+ * Compiles the report descriptor, builds the report routes and selects the protocol. Call
+ * after hid_host_device_open() and before hid_host_device_start(). The protocol is selected
+ * on every connect, the device forgets it when unplugged.
+ *
+ * @param[in] iface        Interface state to set up
+ * @param[in] device_id    Slot of the interface, carried in its events
+ * @param[in] handle       HID device handle
+ * @param[in] cached_plan  Plan compiled from the same report descriptor before, NULL to compile it
+ * @return ESP_OK, or the error of the failing driver call
+ */
+esp_err_t hid_input_interface_open(hid_input_interface_t* iface, uint8_t device_id, hid_host_device_handle_t handle,
+                                   const hid_plan_t* cached_plan) {
+    hid_host_dev_params_t params;
+    esp_err_t             res = hid_host_device_get_params(handle, &params);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    // Compile the report descriptor once, reports are decoded with the resulting plan
+    size_t         desc_length = 0;
+    const uint8_t* desc        = hid_host_get_report_descriptor(handle, &desc_length);
+    if (cached_plan != NULL) {
+        hid_input_interface_init_plan(iface, device_id, params.sub_class, params.proto, cached_plan);
+    } else {
+        hid_input_interface_init(iface, device_id, params.sub_class, params.proto, desc, desc_length);
+    }
+    iface->gamepad_axis_threshold = CONFIG_HID_INPUT_GAMEPAD_AXIS_THRESHOLD;
+    ESP_LOGI(TAG, "Report descriptor: %u bytes, %u reports, %u fields%s", (unsigned)desc_length,
+             iface->has_plan ? iface->plan.report_count : 0, iface->has_plan ? iface->plan.field_count : 0,
+             cached_plan != NULL ? ", cached plan" : "");
+
+    if (HID_SUBCLASS_BOOT_INTERFACE != params.sub_class) {
+        return ESP_OK;
+    }
+
+    if (HID_PROTOCOL_KEYBOARD != params.proto || iface->keyboard_boot) {
+        res = hid_class_request_set_protocol(handle, HID_REPORT_PROTOCOL_BOOT);
+        if (res != ESP_OK) {
+            return res;
+        }
+    }
+    if (HID_PROTOCOL_KEYBOARD == params.proto) {
+        // Only report changes, key repeat is generated by the firmware
+        res = hid_class_request_set_idle(handle, 0, 0);
+        if (res != ESP_OK) {
+            return res;
+        }
+    }
+    if (HID_PROTOCOL_MOUSE == params.proto) {
+        hid_class_request_set_protocol(handle, HID_REPORT_PROTOCOL_REPORT);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "hid_input.h"
+#include "hid_input_snapshot.h"
+#include "usb/hid_host.h"
+
+hid_input_bus_t* hid_input_get_bus(void);
+
+hid_input_snapshot_t* hid_input_get_snapshot(void);
+
+esp_err_t hid_input_interface_open(hid_input_interface_t* iface, uint8_t device_id, hid_host_device_handle_t handle,
+                                   const hid_plan_t* cached_plan);
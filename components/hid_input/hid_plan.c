@@ -0,0 +1,854 @@
+// hid_plan.c
+//
+// HID report descriptor parser.
+// The descriptor is parsed once on connect into a flat extraction plan (bit offset, size,
+// signedness and target per field, grouped per report ID). Decoding a report then walks the
+// fields of its report ID without looking at the report length.
+
+#include "hid_plan.h"
+#include <string.h>
+#include "hid_input_bus.h"
+#include "usb/hid_usage_keyboard.h"
+
+#define HID_ITEM_TYPE_MAIN   0
+#define HID_ITEM_TYPE_GLOBAL 1
+#define HID_ITEM_TYPE_LOCAL  2
+
+#define HID_MAIN_INPUT          0x8
+#define HID_MAIN_OUTPUT         0x9
+#define HID_MAIN_COLLECTION     0xA
+#define HID_MAIN_FEATURE        0xB
+#define HID_MAIN_END_COLLECTION 0xC
+
+#define HID_GLOBAL_USAGE_PAGE   0x0
+#define HID_GLOBAL_LOGICAL_MIN  0x1
+#define HID_GLOBAL_LOGICAL_MAX  0x2
+#define HID_GLOBAL_REPORT_SIZE  0x7
+#define HID_GLOBAL_REPORT_ID    0x8
+#define HID_GLOBAL_REPORT_COUNT 0x9
+#define HID_GLOBAL_PUSH         0xA
+#define HID_GLOBAL_POP          0xB
+
+#define HID_LOCAL_USAGE     0x0
+#define HID_LOCAL_USAGE_MIN 0x1
+#define HID_LOCAL_USAGE_MAX 0x2
+
+#define HID_INPUT_CONSTANT (1 << 0)
+#define HID_INPUT_VARIABLE (1 << 1)
+
+#define HID_COLLECTION_APPLICATION 0x01
+
+#define HID_PAGE_GENERIC_DESKTOP 0x01
+#define HID_PAGE_SIMULATION      0x02
+#define HID_PAGE_KEYBOARD        0x07
+#define HID_PAGE_BUTTON          0x09
+#define HID_PAGE_CONSUMER        0x0C
+
+#define HID_USAGE(page, id) (((uint32_t)(page) << 16) | (id))
+
+#define HID_PLAN_MAX_USAGES     16
+#define HID_PLAN_MAX_GLOBALS    4
+#define HID_PLAN_MAX_COLLECTION 8
+
+// Longest report payload a plan accepts, a report that ends beyond it can never be decoded
+#define HID_PLAN_MAX_REPORT_BITS (HID_INPUT_RAW_MAX * 8)
+
+typedef struct {
+    uint16_t usage_page;
+    int32_t  logical_min;
+    int32_t  logical_max;
+    uint32_t logical_max_raw;  // Unsigned interpretation of the logical maximum
+    uint8_t  report_size;
+    uint16_t report_count;
+    uint8_t  report_id;
+} hid_plan_globals_t;
+
+typedef struct {
+    uint32_t usages[HID_PLAN_MAX_USAGES];
+    uint8_t  usage_count;
+    uint32_t usage_min;
+    uint32_t usage_max;
+    bool     has_range;
+} hid_plan_locals_t;
+
+// Maps HID button numbers (1 based) of a generic gamepad onto gamepad_report_t buttons
+static const uint8_t gamepad_button_map[] = {
+    GAMEPAD_BUTTON_A,  GAMEPAD_BUTTON_B,  GAMEPAD_BUTTON_X,      GAMEPAD_BUTTON_Y,     GAMEPAD_BUTTON_L1,
+    GAMEPAD_BUTTON_R1, GAMEPAD_BUTTON_L2, GAMEPAD_BUTTON_R2,     GAMEPAD_BUTTON_SELECT, GAMEPAD_BUTTON_START,
+    GAMEPAD_BUTTON_L3, GAMEPAD_BUTTON_R3, GAMEPAD_BUTTON_HOME,   GAMEPAD_BUTTON_L4,     GAMEPAD_BUTTON_R4,
+};
+
+// Hat switch direction (0 = up, clockwise) to d-pad button bits
+static const uint32_t hat_map[8] = {
+    (1 << GAMEPAD_BUTTON_UP),
+    (1 << GAMEPAD_BUTTON_UP) | (1 << GAMEPAD_BUTTON_RIGHT),
+    (1 << GAMEPAD_BUTTON_RIGHT),
+    (1 << GAMEPAD_BUTTON_DOWN) | (1 << GAMEPAD_BUTTON_RIGHT),
+    (1 << GAMEPAD_BUTTON_DOWN),
+    (1 << GAMEPAD_BUTTON_DOWN) | (1 << GAMEPAD_BUTTON_LEFT),
+    (1 << GAMEPAD_BUTTON_LEFT),
+    (1 << GAMEPAD_BUTTON_UP) | (1 << GAMEPAD_BUTTON_LEFT),
+};
+
+static hid_plan_app_t app_from_usage(uint32_t usage) {
+    switch (usage) {
+        case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x02):
+            return HID_PLAN_APP_MOUSE;
+        case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x04):  // Joystick
+        case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x05):  // Gamepad
+            return HID_PLAN_APP_GAMEPAD;
+        case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x06):  // Keyboard
+        case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x07):  // Keypad
+            return HID_PLAN_APP_KEYBOARD;
+        case HID_USAGE(HID_PAGE_CONSUMER, 0x01):
+            return HID_PLAN_APP_CONSUMER;
+        default:
+            return HID_PLAN_APP_NONE;
+    }
+}
+
+/**
+ * @brief Maps a usage inside an application collection to an output value
+ *
+ * @return hid_plan_target_t, or -1 when the usage is not decoded
+ */
+static int target_from_usage(hid_plan_app_t app, uint32_t usage) {
+    if (app == HID_PLAN_APP_MOUSE) {
+        switch (usage) {
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x30):
+                return HID_PLAN_TARGET_MOUSE_X;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x31):
+                return HID_PLAN_TARGET_MOUSE_Y;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x38):
+                return HID_PLAN_TARGET_MOUSE_WHEEL;
+            case HID_USAGE(HID_PAGE_CONSUMER, 0x238):  // AC Pan
+                return HID_PLAN_TARGET_MOUSE_PAN;
+            default:
+                return -1;
+        }
+    }
+
+    if (app == HID_PLAN_APP_GAMEPAD) {
+        switch (usage) {
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x30):  // X
+                return HID_PLAN_TARGET_GAMEPAD_LX;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x31):  // Y
+                return HID_PLAN_TARGET_GAMEPAD_LY;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x32):  // Z
+                return HID_PLAN_TARGET_GAMEPAD_RX;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x35):  // Rz
+                return HID_PLAN_TARGET_GAMEPAD_RY;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x33):  // Rx
+            case HID_USAGE(HID_PAGE_SIMULATION, 0xC5):       // Brake
+                return HID_PLAN_TARGET_GAMEPAD_LT;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x34):  // Ry
+            case HID_USAGE(HID_PAGE_SIMULATION, 0xC4):       // Accelerator
+                return HID_PLAN_TARGET_GAMEPAD_RT;
+            case HID_USAGE(HID_PAGE_GENERIC_DESKTOP, 0x39):
+                return HID_PLAN_TARGET_GAMEPAD_HAT;
+            default:
+                return -1;
+        }
+    }
+
+    return -1;
+}
+
+static hid_plan_report_t* get_report(hid_plan_t* plan, uint8_t report_id, hid_plan_app_t app) {
+    for (uint8_t i = 0; i < plan->report_count; i++) {
+        if (plan->reports[i].report_id == report_id) {
+            if (plan->reports[i].app == HID_PLAN_APP_NONE) {
+                plan->reports[i].app = app;
+            }
+            return &plan->reports[i];
+        }
+    }
+
+    if (plan->report_count == HID_PLAN_MAX_REPORTS) {
+        return NULL;
+    }
+
+    hid_plan_report_t* report = &plan->reports[plan->report_count++];
+    report->report_id         = report_id;
+    report->app               = app;
+    return report;
+}
+
+static void add_field(hid_plan_t* plan, const hid_plan_report_t* report, const hid_plan_globals_t* globals,
+                      uint16_t bit_offset, uint8_t bit_size, uint16_t count, int target, uint16_t first_usage) {
+    if (plan->field_count == HID_PLAN_MAX_FIELDS || bit_size == 0 || bit_size > 32) {
+        return;
+    }
+
+    hid_plan_field_t* field = &plan->fields[plan->field_count++];
+    field->bit_offset       = bit_offset;
+    field->bit_size         = bit_size;
+    field->count            = count;
+    field->target           = target;
+    field->is_signed        = count == 1 && globals->logical_min < 0;
+    field->first_usage      = first_usage;
+    field->report           = report - plan->reports;
+    field->logical_min      = globals->logical_min;
+    field->logical_max      = globals->logical_max;
+}
+
+/**
+ * @brief Resolves the usage of the i-th value of a main item, extended with the usage page
+ *
+ * @return false when the item declares no usage for it
+ */
+static bool usage_at(const hid_plan_globals_t* globals, const hid_plan_locals_t* locals, uint16_t i, uint32_t* out) {
+    uint32_t usage;
+    if (i < locals->usage_count) {
+        usage = locals->usages[i];
+    } else if (locals->has_range) {
+        usage = locals->usage_min + i - locals->usage_count;
+        if (usage > locals->usage_max) {
+            usage = locals->usage_max;
+        }
+    } else if (locals->usage_count > 0) {
+        usage = locals->usages[locals->usage_count - 1];
+    } else {
+        return false;
+    }
+
+    if ((usage >> 16) == 0) {
+        usage |= (uint32_t)globals->usage_page << 16;
+    }
+    *out = usage;
+    return true;
+}
+
+/**
+ * @brief Adds the fields of one Input main item to the plan
+ */
+static void add_input(hid_plan_t* plan, hid_plan_app_t app, const hid_plan_globals_t* globals,
+                      const hid_plan_locals_t* locals, uint32_t flags) {
+    hid_plan_report_t* report = get_report(plan, globals->report_id, app);
+    if (report == NULL) {
+        return;
+    }
+
+    // The descriptor comes from the device, sizes are checked before they go into 16 bit offsets
+    uint32_t bit_offset = report->bit_length;
+    uint32_t bit_end    = bit_offset + (uint32_t)globals->report_size * globals->report_count;
+    if (bit_end > HID_PLAN_MAX_REPORT_BITS) {
+        // Longer than any report that is ever received, so report_fits() rejects the report
+        report->bit_length = HID_PLAN_MAX_REPORT_BITS + 1;
+        return;
+    }
+    report->bit_length = bit_end;
+
+    if ((flags & HID_INPUT_CONSTANT) || globals->report_count == 0) {
+        return;
+    }
+
+    // Keys are either a bitmap with one bit per usage (modifiers, NKRO) or an array of usages
+    if (app == HID_PLAN_APP_KEYBOARD && globals->usage_page == HID_PAGE_KEYBOARD) {
+        uint32_t first = locals->has_range ? locals->usage_min : (locals->usage_count ? locals->usages[0] : 0);
+        first &= 0xFFFF;
+        if (first > 0xFF) {
+            return;
+        }
+        if (!(flags & HID_INPUT_VARIABLE)) {
+            add_field(plan, report, globals, bit_offset, globals->report_size, globals->report_count,
+                      HID_PLAN_TARGET_KEY_ARRAY, first);
+        } else if (globals->report_size == 1) {
+            uint16_t count = globals->report_count > 0x100 - first ? 0x100 - first : globals->report_count;
+            add_field(plan, report, globals, bit_offset, 1, count, HID_PLAN_TARGET_KEY_BITMAP, first);
+        }
+        return;
+    }
+
+    // Media keys are either an array of consumer usages or one bit per usage
+    if (app == HID_PLAN_APP_CONSUMER && globals->usage_page == HID_PAGE_CONSUMER) {
+        if (!(flags & HID_INPUT_VARIABLE)) {
+            uint32_t first = locals->has_range ? locals->usage_min : (locals->usage_count ? locals->usages[0] : 0);
+            add_field(plan, report, globals, bit_offset, globals->report_size, globals->report_count,
+                      HID_PLAN_TARGET_CONSUMER_ARRAY, first & 0xFFFF);
+        } else if (globals->report_size == 1) {
+            for (uint16_t i = 0; i < globals->report_count; i++) {
+                uint32_t usage;
+                if (usage_at(globals, locals, i, &usage) && (usage >> 16) == HID_PAGE_CONSUMER) {
+                    add_field(plan, report, globals, bit_offset + i, 1, 1, HID_PLAN_TARGET_CONSUMER_BIT,
+                              usage & 0xFFFF);
+                }
+            }
+        }
+        return;
+    }
+
+    // Other arrays are skipped
+    if (!(flags & HID_INPUT_VARIABLE)) {
+        return;
+    }
+
+    // Runs of single bit buttons become one field that is read in one go
+    if (globals->usage_page == HID_PAGE_BUTTON && globals->report_size == 1) {
+        uint32_t first  = locals->has_range ? locals->usage_min : (locals->usage_count ? locals->usages[0] : 1);
+        uint8_t  count  = globals->report_count > 32 ? 32 : globals->report_count;
+        int      target = -1;
+        if (app == HID_PLAN_APP_MOUSE) {
+            target = HID_PLAN_TARGET_MOUSE_BUTTONS;
+        } else if (app == HID_PLAN_APP_GAMEPAD) {
+            target = HID_PLAN_TARGET_GAMEPAD_BUTTONS;
+        }
+        first &= 0xFFFF;
+        if (target >= 0 && first > 0) {
+            add_field(plan, report, globals, bit_offset, count, count, target, first);
+        }
+        return;
+    }
+
+    for (uint16_t i = 0; i < globals->report_count; i++) {
+        uint32_t usage;
+        if (!usage_at(globals, locals, i, &usage)) {
+            continue;
+        }
+
+        int target = target_from_usage(app, usage);
+        if (target >= 0) {
+            add_field(plan, report, globals, bit_offset + i * globals->report_size, globals->report_size, 1, target,
+                      0);
+        }
+    }
+}
+
+/**
+ * @brief Groups the fields per report so each report owns a contiguous range
+ */
+static void group_fields(hid_plan_t* plan) {
+    // Stable insertion sort on the report index, the field count is small
+    for (uint8_t i = 1; i < plan->field_count; i++) {
+        hid_plan_field_t field = plan->fields[i];
+        int              j     = i - 1;
+        while (j >= 0 && plan->fields[j].report > field.report) {
+            plan->fields[j + 1] = plan->fields[j];
+            j--;
+        }
+        plan->fields[j + 1] = field;
+    }
+
+    for (uint8_t r = 0; r < plan->report_count; r++) {
+        plan->reports[r].first_field = 0;
+        plan->reports[r].field_count = 0;
+    }
+    for (uint8_t i = plan->field_count; i > 0; i--) {
+        hid_plan_report_t* report = &plan->reports[plan->fields[i - 1].report];
+        report->first_field       = i - 1;
+        report->field_count++;
+    }
+}
+
+/**
+ * @brief Fingerprints a report descriptor (32 bit FNV-1a), tells whether a cached plan still fits
+ *
+ * @param desc Raw report descriptor, may be NULL when length is 0.
+ * @param length Length of the descriptor in bytes.
+ * @return uint32_t Hash of the descriptor.
+ */
+uint32_t hid_plan_descriptor_hash(const uint8_t* desc, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ desc[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Compiles a HID report descriptor into an extraction plan
+ *
+ * Only the input reports of mouse, gamepad/joystick, keyboard and consumer control application
+ * collections produce fields; other reports are tracked for their length only.
+ *
+ * @param desc Raw report descriptor.
+ * @param length Length of the descriptor in bytes.
+ * @param plan Plan to fill.
+ * @return true if the descriptor was well formed and at least one field was found.
+ */
+bool hid_plan_compile(const uint8_t* desc, size_t length, hid_plan_t* plan) {
+    hid_plan_globals_t globals_stack[HID_PLAN_MAX_GLOBALS];
+    uint8_t            globals_depth = 0;
+    hid_plan_globals_t globals       = {0};
+    hid_plan_locals_t  locals        = {0};
+    hid_plan_app_t     apps[HID_PLAN_MAX_COLLECTION];
+    uint8_t            collection_depth = 0;
+    hid_plan_app_t     app              = HID_PLAN_APP_NONE;
+    size_t             pos              = 0;
+
+    memset(plan, 0, sizeof(*plan));
+
+    while (pos < length) {
+        uint8_t prefix = desc[pos++];
+
+        // Long items are not used by any real device, skip them
+        if (prefix == 0xFE) {
+            if (pos + 2 > length) {
+                return false;
+            }
+            pos += 2 + desc[pos];
+            continue;
+        }
+
+        uint8_t size = prefix & 0x03;
+        uint8_t type = (prefix >> 2) & 0x03;
+        uint8_t tag  = prefix >> 4;
+        if (size == 3) {
+            size = 4;
+        }
+        if (pos + size > length) {
+            return false;
+        }
+
+        uint32_t udata = 0;
+        for (uint8_t i = 0; i < size; i++) {
+            udata |= (uint32_t)desc[pos + i] << (8 * i);
+        }
+        int32_t sdata = (int32_t)udata;
+        if (size == 1) {
+            sdata = (int8_t)udata;
+        } else if (size == 2) {
+            sdata = (int16_t)udata;
+        }
+        pos += size;
+
+        switch (type) {
+            case HID_ITEM_TYPE_MAIN:
+                if (tag == HID_MAIN_INPUT) {
+                    add_input(plan, app, &globals, &locals, udata);
+                } else if (tag == HID_MAIN_COLLECTION) {
+                    if (collection_depth < HID_PLAN_MAX_COLLECTION) {
+                        apps[collection_depth] = app;
+                    }
+                    collection_depth++;
+                    if (udata == HID_COLLECTION_APPLICATION && locals.usage_count > 0) {
+                        app = app_from_usage(locals.usages[0]);
+                    }
+                } else if (tag == HID_MAIN_END_COLLECTION && collection_depth > 0) {
+                    collection_depth--;
+                    if (collection_depth < HID_PLAN_MAX_COLLECTION) {
+                        app = apps[collection_depth];
+                    }
+                }
+                memset(&locals, 0, sizeof(locals));
+                break;
+            case HID_ITEM_TYPE_GLOBAL:
+                switch (tag) {
+                    case HID_GLOBAL_USAGE_PAGE:
+                        globals.usage_page = udata;
+                        break;
+                    case HID_GLOBAL_LOGICAL_MIN:
+                        globals.logical_min = sdata;
+                        break;
+                    case HID_GLOBAL_LOGICAL_MAX:
+                        globals.logical_max     = sdata;
+                        globals.logical_max_raw = udata;
+                        break;
+                    case HID_GLOBAL_REPORT_SIZE:
+                        globals.report_size = udata;
+                        break;
+                    case HID_GLOBAL_REPORT_ID:
+                        globals.report_id     = udata;
+                        plan->uses_report_ids = true;
+                        break;
+                    case HID_GLOBAL_REPORT_COUNT:
+                        globals.report_count = udata;
+                        break;
+                    case HID_GLOBAL_PUSH:
+                        if (globals_depth < HID_PLAN_MAX_GLOBALS) {
+                            globals_stack[globals_depth++] = globals;
+                        }
+                        break;
+                    case HID_GLOBAL_POP:
+                        if (globals_depth > 0) {
+                            globals = globals_stack[--globals_depth];
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                // Many descriptors write an unsigned maximum like 0xFF in a single byte
+                if (globals.logical_min >= 0 && globals.logical_max < globals.logical_min) {
+                    globals.logical_max = globals.logical_max_raw;
+                }
+                break;
+            case HID_ITEM_TYPE_LOCAL: {
+                uint32_t usage = size == 4 ? udata : HID_USAGE(globals.usage_page, udata);
+                if (tag == HID_LOCAL_USAGE && locals.usage_count < HID_PLAN_MAX_USAGES) {
+                    locals.usages[locals.usage_count++] = usage;
+                } else if (tag == HID_LOCAL_USAGE_MIN) {
+                    locals.usage_min = usage;
+                    locals.has_range = true;
+                } else if (tag == HID_LOCAL_USAGE_MAX) {
+                    locals.usage_max = usage;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    group_fields(plan);
+    return plan->field_count > 0;
+}
+
+/**
+ * @brief Finds the plan of the report a raw input report belongs to
+ *
+ * @param plan Compiled plan.
+ * @param data Raw report, starting with the report ID when the device uses them.
+ * @param length Length of the raw report.
+ * @return Report plan, or NULL if the report ID is unknown or the report is too short.
+ */
+const hid_plan_report_t* hid_plan_find_report(const hid_plan_t* plan, const uint8_t* data, size_t length) {
+    uint8_t report_id = 0;
+    size_t  header    = 0;
+
+    if (plan->uses_report_ids) {
+        if (length < 1) {
+            return NULL;
+        }
+        report_id = data[0];
+        header    = 1;
+    }
+
+    for (uint8_t i = 0; i < plan->report_count; i++) {
+        const hid_plan_report_t* report = &plan->reports[i];
+        if (report->report_id == report_id) {
+            return (length - header) * 8 >= report->bit_length ? report : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static inline int32_t extract_field(const uint8_t* payload, uint16_t bit_offset, uint8_t bit_size, bool is_signed) {
+    const uint8_t* p     = payload + (bit_offset >> 3);
+    uint8_t        shift = bit_offset & 7;
+    uint8_t        bytes = (shift + bit_size + 7) >> 3;
+    uint64_t       raw   = 0;
+
+    for (uint8_t i = 0; i < bytes; i++) {
+        raw |= (uint64_t)p[i] << (8 * i);
+    }
+
+    uint32_t value = (uint32_t)(raw >> shift);
+    if (bit_size < 32) {
+        value &= (1u << bit_size) - 1;
+        if (is_signed && (value & (1u << (bit_size - 1)))) {
+            value |= ~((1u << bit_size) - 1);
+        }
+    }
+    return (int32_t)value;
+}
+
+static inline int32_t clamp(int32_t value, int32_t min, int32_t max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+// Scales a logical value onto 0..255
+static inline uint8_t scale_u8(const hid_plan_field_t* field, int32_t value) {
+    int32_t range = field->logical_max - field->logical_min;
+    if (range <= 0) {
+        return 0;
+    }
+    value = clamp(value, field->logical_min, field->logical_max);
+    return (uint8_t)(((int64_t)(value - field->logical_min) * 255) / range);
+}
+
+static inline bool report_fits(const hid_plan_t* plan, const hid_plan_report_t* report, size_t length) {
+    size_t header = plan->uses_report_ids ? 1 : 0;
+    return length >= header && (length - header) * 8 >= report->bit_length;
+}
+
+/**
+ * @brief Decodes a mouse report whose plan report is already known
+ *
+ * @param plan Compiled plan.
+ * @param report Report of the plan the raw report belongs to, e.g. from a route table.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param out Decoded report.
+ * @return false if the report is not a mouse report or too short.
+ */
+bool hid_plan_decode_mouse(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data, size_t length,
+                           mouse_report_t* out) {
+    if (report->app != HID_PLAN_APP_MOUSE || !report_fits(plan, report, length)) {
+        return false;
+    }
+
+    const uint8_t*          payload = data + (plan->uses_report_ids ? 1 : 0);
+    const hid_plan_field_t* field   = &plan->fields[report->first_field];
+    const hid_plan_field_t* end     = field + report->field_count;
+
+    memset(out, 0, sizeof(*out));
+    for (; field < end; field++) {
+        int32_t value = extract_field(payload, field->bit_offset, field->bit_size, field->is_signed);
+        switch (field->target) {
+            case HID_PLAN_TARGET_MOUSE_BUTTONS:
+                // Buttons may be split over several runs, runs beyond button 8 have no place in the report
+                if (field->first_usage <= 8) {
+                    out->buttons.val |= (uint8_t)((uint32_t)value << (field->first_usage - 1));
+                }
+                break;
+            case HID_PLAN_TARGET_MOUSE_X:
+                out->x_displacement = clamp(value, INT16_MIN, INT16_MAX);
+                break;
+            case HID_PLAN_TARGET_MOUSE_Y:
+                out->y_displacement = clamp(value, INT16_MIN, INT16_MAX);
+                break;
+            case HID_PLAN_TARGET_MOUSE_WHEEL:
+                out->scroll = clamp(value, INT8_MIN, INT8_MAX);
+                break;
+            case HID_PLAN_TARGET_MOUSE_PAN:
+                out->tilt = clamp(value, INT8_MIN, INT8_MAX);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decodes a mouse report using the compiled plan
+ *
+ * @param plan Compiled plan.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param out Decoded report.
+ * @return false if the report is not a known mouse report, the caller should fall back to parse_mouse_event().
+ */
+bool hid_plan_parse_mouse(const hid_plan_t* plan, const uint8_t* data, size_t length, mouse_report_t* out) {
+    const hid_plan_report_t* report = hid_plan_find_report(plan, data, length);
+    return report != NULL && hid_plan_decode_mouse(plan, report, data, length, out);
+}
+
+/**
+ * @brief Decodes a gamepad or joystick report whose plan report is already known
+ *
+ * Axes are scaled from their logical range onto 0..255, buttons are mapped in HID button
+ * order (A, B, X, Y, L1, R1, L2, R2, Select, Start, L3, R3, Home, L4, R4) and the hat
+ * switch drives the d-pad.
+ *
+ * @param plan Compiled plan.
+ * @param report Report of the plan the raw report belongs to.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param out Decoded report.
+ * @return false if the report is not a gamepad report or too short.
+ */
+bool hid_plan_decode_gamepad(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                             size_t length, gamepad_report_t* out) {
+    if (report->app != HID_PLAN_APP_GAMEPAD || !report_fits(plan, report, length)) {
+        return false;
+    }
+
+    const uint8_t*          payload = data + (plan->uses_report_ids ? 1 : 0);
+    const hid_plan_field_t* field   = &plan->fields[report->first_field];
+    const hid_plan_field_t* end     = field + report->field_count;
+
+    memset(out, 0, sizeof(*out));
+    out->report_id = report->report_id;
+    out->lx = out->ly = out->rx = out->ry = 128;
+
+    for (; field < end; field++) {
+        if (field->target == HID_PLAN_TARGET_GAMEPAD_BUTTONS) {
+            // Button runs are 1 bit per button, read in one go
+            uint32_t bits = (uint32_t)extract_field(payload, field->bit_offset, field->bit_size, false);
+            while (bits) {
+                uint32_t button = __builtin_ctz(bits) + field->first_usage - 1;
+                bits &= bits - 1;
+                if (button < sizeof(gamepad_button_map)) {
+                    out->buttons.val |= 1u << gamepad_button_map[button];
+                }
+            }
+            continue;
+        }
+
+        int32_t value = extract_field(payload, field->bit_offset, field->bit_size, field->is_signed);
+        switch (field->target) {
+            case HID_PLAN_TARGET_GAMEPAD_LX:
+                out->lx = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_LY:
+                out->ly = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_RX:
+                out->rx = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_RY:
+                out->ry = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_LT:
+                out->lt = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_RT:
+                out->rt = scale_u8(field, value);
+                break;
+            case HID_PLAN_TARGET_GAMEPAD_HAT: {
+                // Values outside the logical range are the hat's null (centered) state
+                uint32_t direction = (uint32_t)(value - field->logical_min);
+                if (direction < 8) {
+                    out->buttons.val |= hat_map[direction];
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decodes a gamepad or joystick report using the compiled plan
+ *
+ * @param plan Compiled plan.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param out Decoded report.
+ * @return false if the report is not a known gamepad report, the caller should fall back to parse_gamepad_report().
+ */
+bool hid_plan_parse_gamepad(const hid_plan_t* plan, const uint8_t* data, size_t length, gamepad_report_t* out) {
+    const hid_plan_report_t* report = hid_plan_find_report(plan, data, length);
+    return report != NULL && hid_plan_decode_gamepad(plan, report, data, length, out);
+}
+
+/**
+ * @brief Decodes a keyboard report whose plan report is already known
+ *
+ * Handles key bitmaps of any width (NKRO keyboards) as well as boot style key arrays.
+ *
+ * @param plan Compiled plan.
+ * @param report Report of the plan the raw report belongs to.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param keys Currently pressed keys, replaced by the keys of the report.
+ * @return false if the report is not a keyboard report or too short, keys is left untouched.
+ */
+bool hid_plan_decode_keyboard(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                              size_t length, key_bitmap_t* keys) {
+    if (report->app != HID_PLAN_APP_KEYBOARD || !report_fits(plan, report, length)) {
+        return false;
+    }
+
+    const uint8_t*          payload  = data + (plan->uses_report_ids ? 1 : 0);
+    const hid_plan_field_t* field    = &plan->fields[report->first_field];
+    const hid_plan_field_t* end      = field + report->field_count;
+    key_bitmap_t            next     = {0};
+    bool                    rollover = false;
+
+    for (; field < end; field++) {
+        if (field->target == HID_PLAN_TARGET_KEY_BITMAP) {
+            // Read 32 keys at a time, only the pressed ones are visited
+            for (uint16_t i = 0; i < field->count; i += 32) {
+                uint8_t  size = field->count - i < 32 ? field->count - i : 32;
+                uint32_t bits = (uint32_t)extract_field(payload, field->bit_offset + i, size, false);
+                while (bits) {
+                    key_bitmap_set(&next, field->first_usage + i + __builtin_ctz(bits));
+                    bits &= bits - 1;
+                }
+            }
+        } else if (field->target == HID_PLAN_TARGET_KEY_ARRAY) {
+            for (uint16_t i = 0; i < field->count; i++) {
+                int32_t value = extract_field(payload, field->bit_offset + i * field->bit_size, field->bit_size, false);
+                if (value < field->logical_min || value > field->logical_max) {
+                    continue;
+                }
+                uint32_t usage = field->first_usage + (value - field->logical_min);
+                if (usage == HID_KEY_ROLLOVER) {
+                    rollover = true;
+                } else if (usage > HID_KEY_ERROR_UNDEFINED && usage <= 0xFF) {
+                    key_bitmap_set(&next, usage);
+                }
+            }
+        }
+    }
+
+    if (rollover) {
+        key_bitmap_keep_on_rollover(&next, keys);
+    }
+    *keys = next;
+    return true;
+}
+
+/**
+ * @brief Decodes a keyboard report using the compiled plan
+ *
+ * @param plan Compiled plan.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param keys Currently pressed keys, replaced by the keys of the report.
+ * @return false if the report is not a known keyboard report, keys is left untouched.
+ */
+bool hid_plan_parse_keyboard(const hid_plan_t* plan, const uint8_t* data, size_t length, key_bitmap_t* keys) {
+    const hid_plan_report_t* report = hid_plan_find_report(plan, data, length);
+    return report != NULL && hid_plan_decode_keyboard(plan, report, data, length, keys);
+}
+
+/**
+ * @brief Decodes a consumer control report (media keys) whose plan report is already known
+ *
+ * @param plan Compiled plan.
+ * @param report Report of the plan the raw report belongs to.
+ * @param data Raw report.
+ * @param length Length of the raw report.
+ * @param keys Consumer usages held down according to the report.
+ * @return false if the report is not a consumer control report or too short.
+ */
+bool hid_plan_decode_consumer(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                              size_t length, consumer_keys_t* keys) {
+    if (report->app != HID_PLAN_APP_CONSUMER || !report_fits(plan, report, length)) {
+        return false;
+    }
+
+    const uint8_t*          payload = data + (plan->uses_report_ids ? 1 : 0);
+    const hid_plan_field_t* field   = &plan->fields[report->first_field];
+    const hid_plan_field_t* end     = field + report->field_count;
+
+    memset(keys, 0, sizeof(*keys));
+    for (; field < end; field++) {
+        if (field->target == HID_PLAN_TARGET_CONSUMER_BIT) {
+            if (extract_field(payload, field->bit_offset, 1, false)) {
+                consumer_keys_add(keys, field->first_usage);
+            }
+        } else if (field->target == HID_PLAN_TARGET_CONSUMER_ARRAY) {
+            for (uint16_t i = 0; i < field->count; i++) {
+                int32_t value = extract_field(payload, field->bit_offset + i * field->bit_size, field->bit_size, false);
+                if (value >= field->logical_min && value <= field->logical_max) {
+                    consumer_keys_add(keys, field->first_usage + (value - field->logical_min));
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Checks whether a raw report is a keyboard report of the plan
+ */
+bool hid_plan_is_keyboard_report(const hid_plan_t* plan, const uint8_t* data, size_t length) {
+    const hid_plan_report_t* report = hid_plan_find_report(plan, data, length);
+    return report != NULL && report->app == HID_PLAN_APP_KEYBOARD;
+}
+
+/**
+ * @brief Checks whether a keyboard reports its keys as a bitmap beyond the modifiers
+ *
+ * Such keyboards only send all of their keys in report protocol and must not be switched to
+ * boot protocol.
+ */
+bool hid_plan_is_nkro_keyboard(const hid_plan_t* plan) {
+    for (uint8_t i = 0; i < plan->field_count; i++) {
+        const hid_plan_field_t* field = &plan->fields[i];
+        if (field->target == HID_PLAN_TARGET_KEY_BITMAP && field->first_usage < KEY_BITMAP_MODIFIERS) {
+            return true;
+        }
+    }
+    return false;
+}
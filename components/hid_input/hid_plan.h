@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+
+#define HID_PLAN_MAX_REPORTS 8
+#define HID_PLAN_MAX_FIELDS  48
+
+/**
+ * @brief Top level application collection a report belongs to
+ */
+typedef enum {
+    HID_PLAN_APP_NONE = 0,
+    HID_PLAN_APP_MOUSE,
+    HID_PLAN_APP_GAMEPAD,
+    HID_PLAN_APP_KEYBOARD,
+    HID_PLAN_APP_CONSUMER
+} hid_plan_app_t;
+
+/**
+ * @brief Output value a field is extracted into
+ */
+typedef enum {
+    HID_PLAN_TARGET_MOUSE_BUTTONS = 0,
+    HID_PLAN_TARGET_MOUSE_X,
+    HID_PLAN_TARGET_MOUSE_Y,
+    HID_PLAN_TARGET_MOUSE_WHEEL,
+    HID_PLAN_TARGET_MOUSE_PAN,
+    HID_PLAN_TARGET_GAMEPAD_BUTTONS,
+    HID_PLAN_TARGET_GAMEPAD_LX,
+    HID_PLAN_TARGET_GAMEPAD_LY,
+    HID_PLAN_TARGET_GAMEPAD_RX,
+    HID_PLAN_TARGET_GAMEPAD_RY,
+    HID_PLAN_TARGET_GAMEPAD_LT,
+    HID_PLAN_TARGET_GAMEPAD_RT,
+    HID_PLAN_TARGET_GAMEPAD_HAT,
+    HID_PLAN_TARGET_KEY_BITMAP,      // One bit per key usage (modifiers, NKRO keyboards)
+    HID_PLAN_TARGET_KEY_ARRAY,       // Slots holding the usages of pressed keys (boot style keyboards)
+    HID_PLAN_TARGET_CONSUMER_ARRAY,  // Slots holding consumer usages (media keys)
+    HID_PLAN_TARGET_CONSUMER_BIT     // One consumer usage as a single bit
+} hid_plan_target_t;
+
+/**
+ * @brief One value (or run of single bit buttons) inside an input report
+ */
+typedef struct {
+    uint16_t bit_offset;  // Relative to the first byte after the report ID
+    uint16_t count;       // Buttons in a button run, bits in a key bitmap, slots in a key array, 1 otherwise
+    uint8_t  bit_size;    // Size of one key array slot
+    uint8_t  target;      // hid_plan_target_t
+    uint8_t  is_signed;
+    uint16_t first_usage;  // Button number of the first bit of a button run (1 based), key usage for keys
+    uint8_t  report;       // Index into hid_plan_t.reports
+    int32_t  logical_min;
+    int32_t  logical_max;
+} hid_plan_field_t;
+
+typedef struct {
+    uint8_t  report_id;
+    uint8_t  app;  // hid_plan_app_t
+    uint8_t  first_field;
+    uint8_t  field_count;
+    uint16_t bit_length;  // Payload length, excluding the report ID
+} hid_plan_report_t;
+
+/**
+ * @brief Field extraction plan compiled from a HID report descriptor
+ *
+ * Fields of one report are stored contiguously so a report is decoded with a single pass
+ * over its fields.
+ */
+typedef struct {
+    bool              uses_report_ids;
+    uint8_t           report_count;
+    uint8_t           field_count;
+    hid_plan_report_t reports[HID_PLAN_MAX_REPORTS];
+    hid_plan_field_t  fields[HID_PLAN_MAX_FIELDS];
+} hid_plan_t;
+
+uint32_t hid_plan_descriptor_hash(const uint8_t* desc, size_t length);
+
+bool hid_plan_compile(const uint8_t* desc, size_t length, hid_plan_t* plan);
+
+const hid_plan_report_t* hid_plan_find_report(const hid_plan_t* plan, const uint8_t* data, size_t length);
+
+bool hid_plan_decode_mouse(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data, size_t length,
+                           mouse_report_t* out);
+
+bool hid_plan_decode_gamepad(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                             size_t length, gamepad_report_t* out);
+
+bool hid_plan_decode_keyboard(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                              size_t length, key_bitmap_t* keys);
+
+bool hid_plan_decode_consumer(const hid_plan_t* plan, const hid_plan_report_t* report, const uint8_t* data,
+                              size_t length, consumer_keys_t* keys);
+
+bool hid_plan_parse_mouse(const hid_plan_t* plan, const uint8_t* data, size_t length, mouse_report_t* out);
+
+bool hid_plan_parse_gamepad(const hid_plan_t* plan, const uint8_t* data, size_t length, gamepad_report_t* out);
+
+bool hid_plan_parse_keyboard(const hid_plan_t* plan, const uint8_t* data, size_t length, key_bitmap_t* keys);
+
+bool hid_plan_is_keyboard_report(const hid_plan_t* plan, const uint8_t* data, size_t length);
+
+bool hid_plan_is_nkro_keyboard(const hid_plan_t* plan);
@@ -0,0 +1,62 @@
+// hid_route.c
+//
+// Report routing table, see hid_route.h.
+
+#include "hid_route.h"
+#include "usb/hid.h"
+
+static hid_route_kind_t kind_from_app(hid_plan_app_t app, hid_route_kind_t fallback) {
+    switch (app) {
+        case HID_PLAN_APP_KEYBOARD:
+            return HID_ROUTE_KEYBOARD;
+        case HID_PLAN_APP_MOUSE:
+            return HID_ROUTE_MOUSE;
+        case HID_PLAN_APP_GAMEPAD:
+            return HID_ROUTE_GAMEPAD;
+        case HID_PLAN_APP_CONSUMER:
+            return HID_ROUTE_CONSUMER;
+        default:
+            return fallback;
+    }
+}
+
+/**
+ * @brief Builds the routes of an interface
+ *
+ * Reports described by the plan go to the parser of their application collection. Other
+ * reports keep the decoding the interface protocol implies: the boot layout on boot mouse
+ * interfaces, the fixed gamepad layout on other interfaces and nothing on keyboards.
+ *
+ * @param[in] table          Table to fill
+ * @param[in] plan           Compiled report descriptor, NULL when there is none
+ * @param[in] sub_class      Interface subclass
+ * @param[in] protocol       Interface protocol
+ * @param[in] keyboard_boot  The keyboard was switched to boot protocol, its reports have no ID
+ */
+void hid_route_build(hid_route_table_t* table, const hid_plan_t* plan, uint8_t sub_class, uint8_t protocol,
+                     bool keyboard_boot) {
+    hid_route_kind_t fallback = HID_ROUTE_GENERIC;
+    if (HID_SUBCLASS_BOOT_INTERFACE == sub_class) {
+        fallback = HID_PROTOCOL_MOUSE == protocol ? HID_ROUTE_MOUSE_BOOT : HID_ROUTE_DROP;
+        if (HID_PROTOCOL_KEYBOARD == protocol && keyboard_boot) {
+            fallback = HID_ROUTE_KEYBOARD_BOOT;
+            plan     = NULL;
+        }
+    }
+
+    table->uses_report_ids = plan != NULL && plan->uses_report_ids;
+    for (size_t i = 0; i < HID_ROUTE_REPORT_IDS; i++) {
+        table->routes[i] = (hid_route_t){.kind = fallback};
+    }
+    if (plan == NULL) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < plan->report_count; i++) {
+        const hid_plan_report_t* report = &plan->reports[i];
+        // Reports without decoded fields keep the fallback
+        if (report->field_count > 0) {
+            table->routes[report->report_id] = (hid_route_t){.kind = kind_from_app(report->app, fallback), .report = i};
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hid_plan.h"
+
+#define HID_ROUTE_REPORT_IDS 256
+
+/**
+ * @brief Parser and consumer of a report
+ */
+typedef enum {
+    HID_ROUTE_DROP = 0,       // Not decoded
+    HID_ROUTE_KEYBOARD_BOOT,  // Boot protocol keyboard layout
+    HID_ROUTE_MOUSE_BOOT,     // Boot protocol mouse layout, parse_mouse_event()
+    HID_ROUTE_GENERIC,        // Fixed gamepad layout, parse_gamepad_report()
+    HID_ROUTE_KEYBOARD,       // Keyboard report of the plan
+    HID_ROUTE_MOUSE,          // Mouse report of the plan, boot layout when too short
+    HID_ROUTE_GAMEPAD,        // Gamepad report of the plan, fixed layout when too short
+    HID_ROUTE_CONSUMER        // Consumer control report of the plan
+} hid_route_kind_t;
+
+typedef struct {
+    uint8_t kind;    // hid_route_kind_t
+    uint8_t report;  // Index into hid_plan_t.reports, for the routes decoded with the plan
+} hid_route_t;
+
+/**
+ * @brief Routes of the reports of one interface, indexed by report ID
+ *
+ * Built once at connect from the interface protocol and the compiled report descriptor, so
+ * a composite interface (keyboard, mouse and media keys behind report IDs) has each report
+ * decoded by the right parser, and dispatching a report is a single lookup. Interfaces
+ * without report IDs only use the route of ID 0.
+ */
+typedef struct {
+    bool        uses_report_ids;
+    hid_route_t routes[HID_ROUTE_REPORT_IDS];
+} hid_route_table_t;
+
+void hid_route_build(hid_route_table_t* table, const hid_plan_t* plan, uint8_t sub_class, uint8_t protocol,
+                     bool keyboard_boot);
+
+static inline hid_route_t hid_route_lookup(const hid_route_table_t* table, const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return (hid_route_t){.kind = HID_ROUTE_DROP};
+    }
+    return table->routes[table->uses_report_ids ? data[0] : 0];
+}
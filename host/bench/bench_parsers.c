@@ -0,0 +1,136 @@
+// bench_parsers.c
+//
+// Microbenchmark for the report parsers, prints ns/report and reports/s per report format.
+//
+// Usage: bench_parsers [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "badge_hid_host.h"
+#include "hid_plan.h"
+
+#define DEFAULT_ITERATIONS 10000000
+
+typedef enum {
+    BENCH_MOUSE_LEGACY = 0,
+    BENCH_GAMEPAD_LEGACY,
+    BENCH_MOUSE_PLAN,
+    BENCH_GAMEPAD_PLAN
+} bench_parser_t;
+
+typedef struct {
+    const char*    name;
+    bench_parser_t parser;
+    uint8_t        length;
+    uint8_t        data[16];
+} bench_case_t;
+
+// Same descriptors as the unit tests
+static const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x10,
+    0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+    0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01,
+    0x09, 0x38, 0x81, 0x06, 0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+static const uint8_t gamepad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x09, 0x30,
+    0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x75, 0x04, 0x95, 0x01,
+    0x09, 0x39, 0x81, 0x42, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x15,
+    0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0C, 0x81, 0x02, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0xC0,
+};
+
+static const bench_case_t cases[] = {
+    {"mouse boot (3 bytes)", BENCH_MOUSE_LEGACY, 3, {0x01, 0x05, 0xFB}},
+    {"mouse boot + wheel (4 bytes)", BENCH_MOUSE_LEGACY, 4, {0x01, 0x05, 0xFB, 0x01}},
+    {"mouse wheel + tilt (5 bytes)", BENCH_MOUSE_LEGACY, 5, {0x01, 0x05, 0xFB, 0x01, 0xFF}},
+    {"mouse 12-bit (8 bytes)", BENCH_MOUSE_LEGACY, 8, {0x02, 0x01, 0x00, 0xFE, 0x3F, 0x12, 0xFF, 0x01}},
+    {"mouse 16-bit (9 bytes)", BENCH_MOUSE_LEGACY, 9, {0x01, 0x01, 0x00, 0x00, 0x80, 0xE8, 0x03, 0x02, 0xFE}},
+    {"gamepad DS4 layout (10 bytes)", BENCH_GAMEPAD_LEGACY, 10, {0x01, 0x02, 0x80, 0x40, 0x00, 0xFF, 0x10, 0x20}},
+    {"mouse plan, report ID (8 bytes)", BENCH_MOUSE_PLAN, 8, {0x02, 0x05, 0x00, 0xFF, 0x2F, 0x00, 0xFF, 0x01}},
+    {"gamepad plan (7 bytes)", BENCH_GAMEPAD_PLAN, 7, {0x00, 0xFF, 0x80, 0x40, 0x02, 0x05, 0x08}},
+};
+
+static volatile uint32_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Parses the report of a case iterations times
+ *
+ * The first data byte is varied per iteration so the compiler cannot hoist the parser out of the loop.
+ *
+ * @return Elapsed time in nanoseconds
+ */
+static uint64_t run_case(const bench_case_t* bench, const hid_plan_t* mouse_plan, const hid_plan_t* gamepad_plan,
+                         long iterations) {
+    uint8_t data[sizeof(bench->data)];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = bench->data[i];
+    }
+
+    uint32_t acc   = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        data[1] ^= (uint8_t)i;
+        switch (bench->parser) {
+            case BENCH_MOUSE_LEGACY: {
+                mouse_report_t rpt = parse_mouse_event(data, bench->length);
+                acc += rpt.x_displacement + rpt.buttons.val;
+                break;
+            }
+            case BENCH_GAMEPAD_LEGACY: {
+                gamepad_report_t rpt = parse_gamepad_report(data, bench->length);
+                acc += rpt.buttons.val + rpt.lx;
+                break;
+            }
+            case BENCH_MOUSE_PLAN: {
+                mouse_report_t rpt;
+                if (hid_plan_parse_mouse(mouse_plan, data, bench->length, &rpt)) {
+                    acc += rpt.x_displacement + rpt.buttons.val;
+                }
+                break;
+            }
+            case BENCH_GAMEPAD_PLAN: {
+                gamepad_report_t rpt;
+                if (hid_plan_parse_gamepad(gamepad_plan, data, bench->length, &rpt)) {
+                    acc += rpt.buttons.val + rpt.lx;
+                }
+                break;
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    sink = acc;
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    hid_plan_t mouse_plan, gamepad_plan;
+    if (!hid_plan_compile(mouse_desc, sizeof(mouse_desc), &mouse_plan) ||
+        !hid_plan_compile(gamepad_desc, sizeof(gamepad_desc), &gamepad_plan)) {
+        fprintf(stderr, "Failed to compile report descriptors\n");
+        return 1;
+    }
+
+    printf("%-34s %12s %16s\n", "format", "ns/report", "reports/s");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint64_t elapsed = run_case(&cases[i], &mouse_plan, &gamepad_plan, iterations);
+        double   ns      = (double)elapsed / iterations;
+        printf("%-34s %12.2f %16.0f\n", cases[i].name, ns, ns > 0 ? 1e9 / ns : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+// esp_log.h
+//
+// Host build stand-in for the ESP-IDF logging macros.
+// Messages are compiled, so their formats are still checked, but not printed.
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOG_HOST(tag, format, ...)                      \
+    do {                                                    \
+        if (0) {                                            \
+            printf("%s: " format "\n", tag, ##__VA_ARGS__); \
+        }                                                   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
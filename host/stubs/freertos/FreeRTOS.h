@@ -0,0 +1,13 @@
+// FreeRTOS.h
+//
+// Host build stand-in for the FreeRTOS critical sections used by hid_device.c.
+// The host build is single threaded, a spinlock only counts how deep it is held.
+
+#pragma once
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED 0
+
+#define taskENTER_CRITICAL(mux) ((*(mux))++)
+#define taskEXIT_CRITICAL(mux)  ((*(mux))--)
@@ -0,0 +1,23 @@
+// sdkconfig.h
+//
+// Host build stand-in for the generated ESP-IDF configuration, Kconfig defaults of the
+// options used by the sources in the host build.
+
+#pragma once
+
+#define CONFIG_HID_MAX_DEVICES       4
+#define CONFIG_HID_REPORT_RING_DEPTH 64
+#define CONFIG_HID_DEVICE_ARENA_SIZE 8192
+
+#define CONFIG_HID_KEY_REPEAT          1
+#define CONFIG_HID_KEY_REPEAT_DELAY_MS 500
+#define CONFIG_HID_KEY_REPEAT_RATE_HZ  20
+
+#define CONFIG_HID_GAMEPAD_CONDITIONING          1
+#define CONFIG_HID_GAMEPAD_AXIAL_DEADZONE        3
+#define CONFIG_HID_GAMEPAD_RADIAL_INNER          8
+#define CONFIG_HID_GAMEPAD_RADIAL_OUTER          95
+#define CONFIG_HID_GAMEPAD_TRIGGER_DEADZONE      4
+#define CONFIG_HID_GAMEPAD_FILTER_MIN_CUTOFF_MHZ 1000
+#define CONFIG_HID_GAMEPAD_FILTER_BETA           30000
+#define CONFIG_HID_GAMEPAD_FILTER_DCUTOFF_MHZ    1000
@@ -0,0 +1,18 @@
+// hid.h
+//
+// Host build stand-in for the esp-usb header of the same name.
+// Only the types used by the parsers are provided, with the same values as the original.
+
+#pragma once
+
+typedef enum {
+    HID_SUBCLASS_NO_SUBCLASS    = 0x00,
+    HID_SUBCLASS_BOOT_INTERFACE = 0x01
+} hid_subclass_t;
+
+typedef enum {
+    HID_PROTOCOL_NONE     = 0x00,
+    HID_PROTOCOL_KEYBOARD = 0x01,
+    HID_PROTOCOL_MOUSE    = 0x02,
+    HID_PROTOCOL_MAX
+} hid_protocol_t;
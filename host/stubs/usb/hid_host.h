@@ -0,0 +1,18 @@
+// hid_host.h
+//
+// Host build stand-in for the esp-usb header of the same name.
+// Only the types used by hid_device.c are provided, with the same layout as the original.
+
+#pragma once
+
+#include <stdint.h>
+#include "usb/hid.h"
+
+typedef struct hid_interface* hid_host_device_handle_t;
+
+typedef struct {
+    uint8_t addr;
+    uint8_t iface_num;
+    uint8_t sub_class;
+    uint8_t proto;
+} hid_host_dev_params_t;
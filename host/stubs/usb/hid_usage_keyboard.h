@@ -0,0 +1,70 @@
+// hid_usage_keyboard.h
+//
+// Host build stand-in for the esp-usb header of the same name.
+// Only the types used by the parsers are provided, with the same layout as the original.
+
+#pragma once
+
+#include <stdint.h>
+
+#define HID_LEFT_CONTROL  (1 << 0)
+#define HID_LEFT_SHIFT    (1 << 1)
+#define HID_LEFT_ALT      (1 << 2)
+#define HID_LEFT_GUI      (1 << 3)
+#define HID_RIGHT_CONTROL (1 << 4)
+#define HID_RIGHT_SHIFT   (1 << 5)
+#define HID_RIGHT_ALT     (1 << 6)
+#define HID_RIGHT_GUI     (1 << 7)
+
+#define HID_KEYBOARD_KEY_MAX 6
+
+enum {
+    HID_KEY_NO_PRESS        = 0x00,
+    HID_KEY_ROLLOVER        = 0x01,
+    HID_KEY_POST_FAIL       = 0x02,
+    HID_KEY_ERROR_UNDEFINED = 0x03,
+    HID_KEY_A               = 0x04,
+    HID_KEY_Z               = 0x1D,
+    HID_KEY_1               = 0x1E,
+    HID_KEY_0               = 0x27,
+    HID_KEY_ENTER           = 0x28,
+    HID_KEY_ESC             = 0x29,
+    HID_KEY_DEL             = 0x2A,
+    HID_KEY_TAB             = 0x2B,
+    HID_KEY_SPACE           = 0x2C,
+    HID_KEY_SLASH           = 0x38,
+    HID_KEY_CAPS_LOCK       = 0x39,
+    HID_KEY_F1              = 0x3A,
+    HID_KEY_F11             = 0x44,
+    HID_KEY_F12             = 0x45,
+    HID_KEY_RIGHT           = 0x4F,
+    HID_KEY_LEFT            = 0x50,
+    HID_KEY_DOWN            = 0x51,
+    HID_KEY_UP              = 0x52,
+    HID_KEY_LEFT_CONTROL    = 0xE0,
+    HID_KEY_LEFT_SHIFT      = 0xE1,
+    HID_KEY_LEFT_ALT        = 0xE2,
+    HID_KEY_LEFT_GUI        = 0xE3,
+    HID_KEY_RIGHT_CONTROL   = 0xE4,
+    HID_KEY_RIGHT_SHIFT     = 0xE5,
+    HID_KEY_RIGHT_ALT       = 0xE6,
+    HID_KEY_RIGHT_GUI       = 0xE7,
+};
+
+typedef struct {
+    union {
+        struct {
+            uint8_t left_ctr    : 1;
+            uint8_t left_shift  : 1;
+            uint8_t left_alt    : 1;
+            uint8_t left_gui    : 1;
+            uint8_t rigth_ctr   : 1;
+            uint8_t right_shift : 1;
+            uint8_t right_alt   : 1;
+            uint8_t right_gui   : 1;
+        };
+        uint8_t val;
+    } modifier;
+    uint8_t reserved;
+    uint8_t key[HID_KEYBOARD_KEY_MAX];
+} __attribute__((packed)) hid_keyboard_input_report_boot_t;
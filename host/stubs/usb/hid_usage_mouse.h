@@ -0,0 +1,22 @@
+// hid_usage_mouse.h
+//
+// Host build stand-in for the esp-usb header of the same name.
+// Only the types used by the parsers are provided, with the same layout as the original.
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    union {
+        struct {
+            uint8_t button1  : 1;
+            uint8_t button2  : 1;
+            uint8_t button3  : 1;
+            uint8_t reserved : 5;
+        };
+        uint8_t val;
+    } buttons;
+    int8_t x_displacement;
+    int8_t y_displacement;
+} __attribute__((packed)) hid_mouse_input_report_boot_t;
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Generates sample.hidcap, the capture used by the replay golden test.
+# Layout follows main/capture_format.h.
+
+import struct
+
+REPORT, DEVICE, DESCRIPTOR, GAP = 0, 1, 2, 3
+
+MOUSE_DESC = bytes([
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x10,
+    0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+    0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01,
+    0x09, 0x38, 0x81, 0x06, 0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+])
+
+GAMEPAD_DESC = bytes([
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x09, 0x30,
+    0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x75, 0x04, 0x95, 0x01,
+    0x09, 0x39, 0x81, 0x42, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x15,
+    0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0C, 0x81, 0x02, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0xC0,
+])
+
+NKRO_DESC = bytes([
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25,
+    0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02, 0xC0,
+])
+
+
+def record(kind, device, timestamp, payload, report_id=0):
+    return struct.pack('<HBBBBq', len(payload), kind, device, report_id, 0, timestamp) + payload
+
+
+def device(dev, timestamp, vid, pid, interface, sub_class, protocol):
+    return record(DEVICE, dev, timestamp, struct.pack('<HHBBBB', vid, pid, interface, sub_class, protocol, 0))
+
+
+out = b'HIDCAP' + struct.pack('<H', 1)
+
+# Boot keyboard: press a, shift+b, release a, release all
+out += device(0, 1000, 0x046D, 0xC31C, 0, 1, 1)
+for t, report in ((2000, [0, 0, 0x04, 0, 0, 0, 0, 0]), (3000, [0x02, 0, 0x04, 0x05, 0, 0, 0, 0]),
+                  (4000, [0x02, 0, 0x05, 0, 0, 0, 0, 0]), (5000, [0, 0, 0, 0, 0, 0, 0, 0])):
+    out += record(REPORT, 0, t, bytes(report))
+
+# Boot mouse without descriptor: 3, 4, 5 byte and 16-bit reports
+out += device(1, 1100, 0x1BCF, 0x0005, 0, 1, 2)
+for t, report in ((2100, [0x01, 0x05, 0xFB]), (2200, [0x00, 0x01, 0x01, 0xFF]), (2300, [0x02, 0x10, 0xF0, 0x01, 0x01]),
+                  (2400, [0x01, 0x01, 0x00, 0x00, 0x80, 0xE8, 0x03, 0x02, 0xFE])):
+    out += record(REPORT, 1, t, bytes(report))
+
+# Report ID mouse with 12-bit axes, decoded through its descriptor
+out += device(2, 1200, 0x046D, 0xC52B, 1, 1, 2)
+out += record(DESCRIPTOR, 2, 1200, MOUSE_DESC)
+out += record(REPORT, 2, 2500, bytes([0x02, 0x05, 0x00, 0xFF, 0x2F, 0x00, 0xFF, 0x01]), report_id=2)
+out += record(GAP, 2, 2600, struct.pack('<I', 3))
+out += record(REPORT, 2, 2700, bytes([0x02, 0x00, 0x00, 0x10, 0x00, 0xFF, 0x00, 0x00]), report_id=2)
+
+# Generic gamepad with descriptor, and a DS4 layout pad without one
+out += device(3, 1300, 0x0079, 0x0006, 0, 0, 0)
+out += record(DESCRIPTOR, 3, 1300, GAMEPAD_DESC)
+out += record(REPORT, 3, 2800, bytes([0x00, 0xFF, 0x80, 0x40, 0x02, 0x05, 0x08]))
+out += device(4, 1400, 0x054C, 0x05C4, 0, 0, 0)
+out += record(REPORT, 4, 2900, bytes([0x01, 0x08, 0x80, 0x40, 0x00, 0xFF, 0x10, 0x20, 0x30, 0x40]))
+out += record(REPORT, 4, 3100, bytes([0x01, 0x02]))
+
+# NKRO keyboard on a boot interface, kept in report protocol: ctrl and 8 keys, then release all
+out += device(5, 1500, 0x3434, 0x0121, 0, 1, 1)
+out += record(DESCRIPTOR, 5, 1500, NKRO_DESC)
+out += record(REPORT, 5, 3200, bytes([0x01, 0x01, 0xF0, 0x0F] + [0] * 13), report_id=1)
+out += record(REPORT, 5, 3300, bytes([0x01] + [0] * 16), report_id=1)
+
+with open('sample.hidcap', 'wb') as f:
+    f.write(out)
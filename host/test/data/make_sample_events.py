@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+# Generates sample.evstream, the console output used by the event stream golden test.
+# Frame layout follows main/event_format.h; the console's "\n" to "\r\n" translation is applied.
+
+import struct
+
+KEY, MOUSE, GAMEPAD, LOST = 1, 2, 3, 4
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def cobs(data):
+    out, block = bytearray(), bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(byte)
+    return bytes(out + bytes([len(block) + 1]) + block)
+
+
+def frame(kind, device, timestamp, payload):
+    record = struct.pack('<BBI', kind, device, timestamp) + payload
+    return cobs(record + bytes([crc8(record)])) + b'\0'
+
+
+# Every batch written by the firmware starts with a delimiter
+out = b'I (1234) main: Hello HID!\n'
+out += b'\0' + frame(KEY, 0, 2000, struct.pack('<BBB', 0, 0x02, 0x0A))  # Key code 0x0A, CRLF translated
+out += frame(KEY, 0, 2100, struct.pack('<BBB', 2, 0x02, 0x0A))
+out += frame(MOUSE, 1, 2200, struct.pack('<BhhbB', 0x01, -5, 10, -1, 0))
+out += b'W (2300) event_stream: a log line between batches\n'
+out += b'\0' + frame(GAMEPAD, 2, 2400, struct.pack('<IBBBBBB', 0x10001, 0, 255, 128, 128, 0x0D, 0x0A))
+out += frame(LOST, 0, 2500, struct.pack('<I', 7))
+out += frame(KEY, 0, 2600, struct.pack('<BBB', 1, 0, 0x0A))[:-3] + b'\x55\0'  # Corrupted
+out += frame(KEY, 0, 2700, struct.pack('<BBB', 1, 0, 0x0A))
+
+with open('sample.evstream', 'wb') as f:
+    f.write(out.replace(b'\n', b'\r\n'))
@@ -0,0 +1,14 @@
+# Runs hid_replay on a capture (or hid_events on an event stream) and compares the event stream
+# with the golden output.
+#
+#   cmake -DREPLAY=<tool> -DCAPTURE=<input> -DEXPECTED=<golden> -DOUTPUT=<output> -P replay_golden.cmake
+
+execute_process(COMMAND ${REPLAY} ${CAPTURE} OUTPUT_FILE ${OUTPUT} RESULT_VARIABLE result)
+if(result)
+	message(FATAL_ERROR "${REPLAY} failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED} RESULT_VARIABLE result)
+if(result)
+	message(FATAL_ERROR "Event stream ${OUTPUT} differs from ${EXPECTED}")
+endif()
@@ -0,0 +1,278 @@
+// test_hotplug_soak.c
+//
+// Soak test of the device slots and their connection lifetime storage in hid_device.c.
+// Simulates hot-plug cycles of a mix of keyboards, mice, gamepads and devices with oversized
+// descriptors the way the connect handler and the input task in main.c drive hid_device.c:
+// every connect claims a slot with hid_device_alloc(), which takes an arena from the fixed
+// pool and carves the report ring from it, keeps the descriptor, sets up the decoder and
+// publishes the slot; a few reports go through the ring, and hid_device_free() releases the
+// slot with its arena. Checks that no slot or block leaks, that a claimed slot stays hidden
+// until it is published, that every device type always takes the same arena footprint, that
+// a released block always fits the largest device again and that the heap is not used.
+//
+// Usage: test_hotplug_soak [cycles]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hid_device.h"
+#include "usb/hid.h"
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#define DEFAULT_CYCLES 100000
+#define SOAK_DEVICES   CONFIG_HID_MAX_DEVICES
+
+typedef struct {
+    const char*    name;
+    uint8_t        sub_class;
+    uint8_t        protocol;
+    const uint8_t* desc;
+    size_t         desc_length;
+    uint8_t        report_length;
+    uint8_t        report[16];
+} soak_type_t;
+
+// Same descriptors as the benchmark
+static const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x10,
+    0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+    0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01,
+    0x09, 0x38, 0x81, 0x06, 0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+static const uint8_t gamepad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x09, 0x30,
+    0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x75, 0x04, 0x95, 0x01,
+    0x09, 0x39, 0x81, 0x42, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x15,
+    0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0C, 0x81, 0x02, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0xC0,
+};
+
+// Vendor descriptors of a couple of kilobytes are not unusual, filled with main items at run time
+static uint8_t vendor_desc[2048];
+
+static const soak_type_t types[] = {
+    {"boot keyboard", HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD, NULL, 0, 8, {0x00, 0x00, 0x04}},
+    {"boot mouse", HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE, NULL, 0, 4, {0x01, 0x05, 0xFB, 0x01}},
+    {"mouse", HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, mouse_desc, sizeof(mouse_desc), 8,
+     {0x02, 0x05, 0x00, 0xFF, 0x2F, 0x00, 0xFF, 0x01}},
+    {"gamepad", HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, gamepad_desc, sizeof(gamepad_desc), 7,
+     {0x00, 0xFF, 0x80, 0x40, 0x02, 0x05, 0x08}},
+    {"generic pad", HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, NULL, 0, 10,
+     {0x01, 0x08, 0x00, 0x40, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00}},
+    {"vendor", HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, vendor_desc, sizeof(vendor_desc), 4,
+     {0x00, 0x01, 0x02, 0x03}},
+};
+
+#define SOAK_TYPES  (sizeof(types) / sizeof(types[0]))
+#define SOAK_VENDOR (SOAK_TYPES - 1)  // Largest footprint
+
+static hid_device_t*          connected[SOAK_DEVICES];  // Indexed by slot
+static const soak_type_t*     connected_type[SOAK_DEVICES];
+static size_t                 arena_used[SOAK_TYPES];  // Arena use of each device type, must not vary
+static hid_input_event_t      events[4];
+static hid_input_subscriber_t subscribers[1];
+static hid_input_bus_t        bus;
+static int                    failures = 0;
+
+static uint32_t random_state = 0x12345678;
+
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void fail(const char* what, unsigned long cycle) {
+    if (failures++ < 10) {
+        printf("cycle %lu: %s\n", cycle, what);
+    }
+}
+
+static void count_event(const hid_input_event_t* event, void* arg) {
+    (*(unsigned long*)arg)++;
+}
+
+static size_t slots_visible(void) {
+    size_t count = 0;
+    for (size_t i = 0; i < SOAK_DEVICES; i++) {
+        if (hid_device_get(i) != NULL) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Sets up a device like the connect handler in main.c
+ */
+static hid_device_t* connect_device(size_t type_index, unsigned long cycle) {
+    const soak_type_t*          type   = &types[type_index];
+    const hid_host_dev_params_t params = {.sub_class = type->sub_class, .proto = type->protocol};
+
+    hid_device_t* device = hid_device_alloc(NULL, &params);
+    if (device == NULL) {
+        return NULL;
+    }
+    if (hid_device_get(device->id) != NULL) {
+        fail("claimed slot visible before it is published", cycle);
+    }
+    if (!hid_device_keep_descriptor(device, type->desc, type->desc_length)) {
+        fail("descriptor does not fit the arena", cycle);
+    }
+    // What hid_input_interface_open() does with the report descriptor
+    hid_input_interface_init(&device->input, device->id, type->sub_class, type->protocol, device->descriptor,
+                             device->descriptor_length);
+    hid_device_publish(device);
+    if (hid_device_get(device->id) != device) {
+        fail("published slot not visible", cycle);
+    }
+
+    if (arena_used[type_index] == 0) {
+        arena_used[type_index] = device->arena.used;
+    } else if (arena_used[type_index] != device->arena.used) {
+        fail("arena use of a device type changed", cycle);
+    }
+    return device;
+}
+
+/**
+ * @brief Queues a few reports like the interface callback and drains them like the input task
+ */
+static void feed_device(hid_device_t* device, const soak_type_t* type, int64_t timestamp_us) {
+    size_t reports = 1 + next_random() % 8;
+    for (size_t i = 0; i < reports; i++) {
+        report_ring_entry_t* entry = report_ring_reserve(&device->ring);
+        if (entry == NULL) {
+            break;
+        }
+        entry->timestamp_us = timestamp_us;
+        entry->length       = type->report_length;
+        memcpy(entry->data, type->report, entry->length);
+        // Vary the report so change detection does not swallow everything
+        entry->data[entry->length - 1] ^= i & 1;
+        report_ring_commit(&device->ring);
+    }
+
+    const report_ring_entry_t* entry;
+    while ((entry = report_ring_front(&device->ring)) != NULL) {
+        hid_input_interface_report(&device->input, &bus, entry->data, entry->length, entry->timestamp_us);
+        report_ring_pop(&device->ring);
+    }
+}
+
+static size_t heap_in_use(void) {
+#if defined(__GLIBC__)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+    unsigned long cycles      = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_CYCLES;
+    unsigned long events_seen = 0;
+
+    for (size_t i = 0; i < sizeof(vendor_desc); i += 2) {
+        vendor_desc[i]     = 0x81;  // Input (Data, Array) of the current global state
+        vendor_desc[i + 1] = 0x02;
+    }
+
+    hid_input_bus_init(&bus, events, 4, subscribers, 1);
+    hid_input_filter_t filter = HID_INPUT_FILTER_ANY;
+    hid_input_subscribe(&bus, &filter, count_event, &events_seen);
+
+    // stdio allocates its buffer on first use, so print before taking the baseline
+    printf("hot-plug soak: %lu cycles, %u devices, %u byte arenas\n", cycles, SOAK_DEVICES,
+           CONFIG_HID_DEVICE_ARENA_SIZE);
+    fflush(stdout);
+    size_t        heap_before  = heap_in_use();
+    unsigned long connects     = 0;
+    size_t        connections  = 0;
+    int64_t       timestamp_us = 0;
+
+    for (unsigned long cycle = 0; cycle < cycles; cycle++) {
+        size_t slot = next_random() % SOAK_DEVICES;
+
+        timestamp_us += 1000;
+        if (connected[slot] == NULL) {
+            // Slots are handed out lowest first, connect whenever a slot is free
+            size_t        type   = next_random() % SOAK_TYPES;
+            hid_device_t* device = connect_device(type, cycle);
+            if (device == NULL) {
+                fail("no slot although one is free", cycle);
+            } else {
+                connected[device->id]      = device;
+                connected_type[device->id] = &types[type];
+                connects++;
+                connections++;
+            }
+        } else if (next_random() % 4 == 0) {
+            hid_device_free(connected[slot]);
+            connected[slot] = NULL;
+            connections--;
+        } else {
+            feed_device(connected[slot], connected_type[slot], timestamp_us);
+        }
+
+        const device_arena_pool_t* pool = hid_device_arena_pool();
+        if (device_arena_pool_free(pool) != SOAK_DEVICES - connections || slots_visible() != connections) {
+            fail("slots or pool blocks leaked", cycle);
+        }
+    }
+
+    for (size_t i = 0; i < SOAK_DEVICES; i++) {
+        if (connected[i] != NULL) {
+            hid_device_free(connected[i]);
+            connected[i] = NULL;
+        }
+    }
+
+    // The largest footprint of a released arena is the footprint of the largest type seen
+    const device_arena_pool_t* pool    = hid_device_arena_pool();
+    size_t                     largest = 0;
+    for (size_t i = 0; i < SOAK_TYPES; i++) {
+        largest = arena_used[i] > largest ? arena_used[i] : largest;
+    }
+    if (pool->peak_used != largest) {
+        fail("arena high watermark differs from the largest device type", cycles);
+    }
+    if (pool->exhausted != 0) {
+        fail("pool ran out of blocks", cycles);
+    }
+
+    // Every block is whole again: each one still takes the largest device, and no more slots exist
+    hid_device_t* largest_devices[SOAK_DEVICES] = {0};
+    for (size_t i = 0; i < SOAK_DEVICES; i++) {
+        largest_devices[i] = connect_device(SOAK_VENDOR, cycles);
+        if (largest_devices[i] == NULL) {
+            fail("released slot does not take the largest device", cycles);
+        }
+    }
+    const hid_host_dev_params_t extra_params = {0};
+    if (hid_device_alloc(NULL, &extra_params) != NULL) {
+        fail("more slots handed out than exist", cycles);
+    }
+    for (size_t i = 0; i < SOAK_DEVICES; i++) {
+        if (largest_devices[i] != NULL) {
+            hid_device_free(largest_devices[i]);
+        }
+    }
+    if (device_arena_pool_free(pool) != SOAK_DEVICES || slots_visible() != 0) {
+        fail("slots not free at the end", cycles);
+    }
+
+    if (heap_in_use() != heap_before) {
+        fail("heap use changed", cycles);
+    }
+
+    printf("%lu connects, %lu events, peak %u blocks, peak arena use %u bytes\n", connects, events_seen,
+           (unsigned)pool->peak_blocks, (unsigned)pool->peak_used);
+    for (size_t i = 0; i < SOAK_TYPES; i++) {
+        printf("  %-14s %5u arena bytes\n", types[i].name, (unsigned)arena_used[i]);
+    }
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}
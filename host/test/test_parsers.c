@@ -0,0 +1,1187 @@
+// test_parsers.c
+//
+// Unit tests for the report parsers in badge_hid_host.c and hid_plan.c, and the platform
+// independent helpers they feed (report ring, latency histograms, rate meter, key repeat,
+// event stream frames, e-paper refresh schedule, draw list, report routes, input event bus,
+// input state snapshot, gamepad change detection, cached plans, oversized descriptors).
+
+#include <stdio.h>
+#include <string.h>
+#include "badge_hid_host.h"
+#include "draw_list.h"
+#include "epaper_schedule.h"
+#include "event_frame.h"
+#include "gamepad_condition.h"
+#include "hid_input.h"
+#include "hid_input_snapshot.h"
+#include "hid_plan.h"
+#include "hid_route.h"
+#include "key_repeat.h"
+#include "latency.h"
+#include "mouse_motion.h"
+#include "rate_meter.h"
+#include "report_ring.h"
+#include "sdkconfig.h"
+#include "text_cache.h"
+#include "usb/hid.h"
+#include "usb/hid_usage_keyboard.h"
+
+static int failures = 0;
+static int checks   = 0;
+
+#define CHECK_EQ(actual, expected)                                                                          \
+    do {                                                                                                    \
+        long long _a = (long long)(actual);                                                                 \
+        long long _e = (long long)(expected);                                                               \
+        checks++;                                                                                           \
+        if (_a != _e) {                                                                                     \
+            failures++;                                                                                     \
+            printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, _a, _e);              \
+        }                                                                                                   \
+    } while (0)
+
+// Mouse with report ID 2, 16 buttons, 12-bit X/Y, wheel and AC pan
+static const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x10,
+    0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+    0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01,
+    0x09, 0x38, 0x81, 0x06, 0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+// Gamepad without report IDs: X, Y, Z, Rz as 8-bit axes, 4-bit hat, 12 buttons
+static const uint8_t gamepad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x09, 0x30,
+    0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x75, 0x04, 0x95, 0x01,
+    0x09, 0x39, 0x81, 0x42, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x15,
+    0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0C, 0x81, 0x02, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03, 0xC0,
+};
+
+static void test_sign_extend_12bit(void) {
+    CHECK_EQ(sign_extend_12bit(0x000), 0);
+    CHECK_EQ(sign_extend_12bit(0x7FF), 2047);
+    CHECK_EQ(sign_extend_12bit(0x800), -2048);
+    CHECK_EQ(sign_extend_12bit(0xFFF), -1);
+    CHECK_EQ(sign_extend_12bit(0xF001), 1);  // Bits above the 12-bit value are ignored
+}
+
+static void test_mouse_boot(void) {
+    const uint8_t  data3[] = {0x05, 0xFE, 0x03};
+    mouse_report_t rpt     = parse_mouse_event(data3, sizeof(data3));
+    CHECK_EQ(rpt.buttons.val, 0x05);
+    CHECK_EQ(rpt.x_displacement, -2);
+    CHECK_EQ(rpt.y_displacement, 3);
+    CHECK_EQ(rpt.scroll, 0);
+    CHECK_EQ(rpt.tilt, 0);
+
+    const uint8_t data4[] = {0x01, 0x10, 0xF0, 0xFF};
+    rpt                   = parse_mouse_event(data4, sizeof(data4));
+    CHECK_EQ(rpt.buttons.val, 0x01);
+    CHECK_EQ(rpt.x_displacement, 16);
+    CHECK_EQ(rpt.y_displacement, -16);
+    CHECK_EQ(rpt.scroll, -1);
+    CHECK_EQ(rpt.tilt, 0);
+}
+
+static void test_mouse_5_bytes(void) {
+    const uint8_t  data[] = {0x02, 0x7F, 0x80, 0x01, 0xFF};
+    mouse_report_t rpt    = parse_mouse_event(data, sizeof(data));
+    CHECK_EQ(rpt.buttons.val, 0x02);
+    CHECK_EQ(rpt.x_displacement, 127);
+    CHECK_EQ(rpt.y_displacement, -128);
+    CHECK_EQ(rpt.scroll, 1);
+    CHECK_EQ(rpt.tilt, -1);
+}
+
+static void test_mouse_12bit(void) {
+    // Report ID, buttons, padding, then X = -2 (0xFFE) and Y = 0x123 packed in three bytes
+    const uint8_t data[] = {0x02, 0x04, 0x00, 0xFE, 0x3F, 0x12, 0xFF, 0x01};
+
+    mouse_report_t rpt = parse_mouse_event(data, 6);
+    CHECK_EQ(rpt.buttons.val, 0x04);
+    CHECK_EQ(rpt.x_displacement, -2);
+    CHECK_EQ(rpt.y_displacement, 0x123);
+    CHECK_EQ(rpt.scroll, 0);
+    CHECK_EQ(rpt.tilt, 0);
+
+    rpt = parse_mouse_event(data, 7);
+    CHECK_EQ(rpt.x_displacement, -2);
+    CHECK_EQ(rpt.y_displacement, 0x123);
+    CHECK_EQ(rpt.scroll, -1);
+    CHECK_EQ(rpt.tilt, 0);
+
+    rpt = parse_mouse_event(data, 8);
+    CHECK_EQ(rpt.scroll, -1);
+    CHECK_EQ(rpt.tilt, 1);
+
+    // Negative Y
+    const uint8_t neg[] = {0x02, 0x00, 0x00, 0x01, 0xF0, 0xFF};
+    rpt                 = parse_mouse_event(neg, sizeof(neg));
+    CHECK_EQ(rpt.x_displacement, 1);
+    CHECK_EQ(rpt.y_displacement, -1);
+}
+
+static void test_mouse_16bit(void) {
+    const uint8_t  data[] = {0x01, 0x03, 0x00, 0x00, 0x80, 0xE8, 0x03, 0x02, 0xFE, 0x00};
+    mouse_report_t rpt    = parse_mouse_event(data, 9);
+    CHECK_EQ(rpt.buttons.val, 0x03);
+    CHECK_EQ(rpt.x_displacement, -32768);
+    CHECK_EQ(rpt.y_displacement, 1000);
+    CHECK_EQ(rpt.scroll, 2);
+    CHECK_EQ(rpt.tilt, -2);
+
+    rpt = parse_mouse_event(data, sizeof(data));
+    CHECK_EQ(rpt.x_displacement, -32768);
+    CHECK_EQ(rpt.tilt, -2);
+}
+
+static void test_gamepad_hat(void) {
+    // Expected up, right, down, left per hat value, 8 and above is centered
+    static const uint8_t expected[][4] = {
+        {1, 0, 0, 0}, {1, 1, 0, 0}, {0, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 1, 0},
+        {0, 0, 1, 1}, {0, 0, 0, 1}, {1, 0, 0, 1}, {0, 0, 0, 0}, {0, 0, 0, 0},
+    };
+
+    for (uint8_t hat = 0; hat < sizeof(expected) / sizeof(expected[0]); hat++) {
+        const uint8_t    data[] = {0x01, hat, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00};
+        gamepad_report_t rpt    = parse_gamepad_report(data, sizeof(data));
+        CHECK_EQ(rpt.buttons.up, expected[hat][0]);
+        CHECK_EQ(rpt.buttons.right, expected[hat][1]);
+        CHECK_EQ(rpt.buttons.down, expected[hat][2]);
+        CHECK_EQ(rpt.buttons.left, expected[hat][3]);
+    }
+}
+
+static void test_gamepad_fields(void) {
+    const uint8_t    data[] = {0x01, 0x08, 0x80, 0x40, 0x00, 0xFF, 0x10, 0x20, 0x30, 0x40};
+    gamepad_report_t rpt    = parse_gamepad_report(data, sizeof(data));
+    CHECK_EQ(rpt.report_id, 0x01);
+    CHECK_EQ(rpt.buttons.val, 1u << GAMEPAD_BUTTON_R1 | 1u << GAMEPAD_BUTTON_A);
+    CHECK_EQ(rpt.lx, 0x00);
+    CHECK_EQ(rpt.ly, 0xFF);
+    CHECK_EQ(rpt.rx, 0x10);
+    CHECK_EQ(rpt.ry, 0x20);
+    CHECK_EQ(rpt.lt, 0x30);
+    CHECK_EQ(rpt.rt, 0x40);
+
+    rpt = parse_gamepad_report(data, 9);
+    CHECK_EQ(rpt.report_id, 0);
+    CHECK_EQ(rpt.buttons.val, 0);
+
+    char text[64];
+    rpt = parse_gamepad_report(data, sizeof(data));
+    gamepad_format_buttons(&rpt, text, sizeof(text));
+    CHECK_EQ(strcmp(text, "Buttons: A R1"), 0);
+}
+
+static void test_keyboard_diff(void) {
+    key_bitmap_t prev = {0};
+    key_bitmap_t keys = {0};
+    key_event_t  events[KEYBOARD_DIFF_MAX_EVENTS];
+
+    const uint8_t press_a[] = {0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00};
+    CHECK_EQ(keyboard_boot_to_bitmap(press_a, sizeof(press_a), &keys), true);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 1);
+    CHECK_EQ(events[0].state, KEY_STATE_PRESSED);
+    CHECK_EQ(events[0].key_code, 0x04);
+
+    // a held, shift+b pressed in the second slot: shift is a key of its own
+    const uint8_t press_b[] = {0x02, 0x00, 0x04, 0x05, 0x00, 0x00, 0x00, 0x00};
+    CHECK_EQ(keyboard_boot_to_bitmap(press_b, sizeof(press_b), &keys), true);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 2);
+    CHECK_EQ(events[0].key_code, 0x05);
+    CHECK_EQ(events[0].modifier, 0x02);
+    CHECK_EQ(events[1].key_code, HID_KEY_LEFT_SHIFT);
+    CHECK_EQ(events[1].state, KEY_STATE_PRESSED);
+
+    // b moves to the first slot when a is released: release a, shift still held
+    const uint8_t release_a[] = {0x02, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+    CHECK_EQ(keyboard_boot_to_bitmap(release_a, sizeof(release_a), &keys), true);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 1);
+    CHECK_EQ(events[0].state, KEY_STATE_RELEASED);
+    CHECK_EQ(events[0].key_code, 0x04);
+    CHECK_EQ(events[0].modifier, 0x02);
+
+    // Rollover error reports keep the keys, only the modifiers are taken over
+    const uint8_t rollover[] = {0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+    CHECK_EQ(keyboard_boot_to_bitmap(rollover, sizeof(rollover), &keys), true);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 1);
+    CHECK_EQ(events[0].state, KEY_STATE_RELEASED);
+    CHECK_EQ(events[0].key_code, HID_KEY_LEFT_SHIFT);
+    CHECK_EQ(key_bitmap_test(&keys, 0x05), true);
+
+    CHECK_EQ(keyboard_boot_to_bitmap(rollover, 7, &keys), false);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 0);
+}
+
+// Keyboard with report ID 1: modifier bitmap and a 120 key NKRO bitmap
+static const uint8_t nkro_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25,
+    0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02, 0xC0,
+};
+
+// Boot compatible keyboard: modifiers, reserved byte, six key slots
+static const uint8_t boot_keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01,
+    0x95, 0x08, 0x81, 0x02, 0x95, 0x01, 0x75, 0x08, 0x81, 0x01, 0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65,
+    0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00, 0xC0,
+};
+
+static void test_plan_keyboard(void) {
+    hid_plan_t   plan;
+    key_bitmap_t prev = {0};
+    key_bitmap_t keys = {0};
+    key_event_t  events[KEYBOARD_DIFF_MAX_EVENTS];
+
+    CHECK_EQ(hid_plan_compile(nkro_desc, sizeof(nkro_desc), &plan), true);
+    CHECK_EQ(hid_plan_is_nkro_keyboard(&plan), true);
+    CHECK_EQ(plan.reports[0].bit_length, 128);
+
+    // Left control and 20 keys (0x04..0x17) at once, more than one diff call holds
+    uint8_t data[17] = {0x01, 0x01, 0xF0, 0xFF, 0xFF};
+    CHECK_EQ(hid_plan_is_keyboard_report(&plan, data, sizeof(data)), true);
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, sizeof(data), &keys), true);
+    CHECK_EQ(key_bitmap_modifiers(&keys), 0x01);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), KEYBOARD_DIFF_MAX_EVENTS);
+    CHECK_EQ(events[0].key_code, 0x04);
+    CHECK_EQ(events[15].key_code, 0x13);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 5);
+    CHECK_EQ(events[3].key_code, 0x17);
+    CHECK_EQ(events[4].key_code, HID_KEY_LEFT_CONTROL);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 0);
+
+    // The last key of the bitmap, everything else released
+    memset(data + 1, 0, sizeof(data) - 1);
+    data[16] = 0x80;
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, sizeof(data), &keys), true);
+    CHECK_EQ(key_bitmap_test(&keys, 0x77), true);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), KEYBOARD_DIFF_MAX_EVENTS);
+    CHECK_EQ(key_bitmap_diff(&prev, &keys, events, KEYBOARD_DIFF_MAX_EVENTS), 6);
+    CHECK_EQ(events[4].key_code, HID_KEY_LEFT_CONTROL);
+    CHECK_EQ(events[5].state, KEY_STATE_PRESSED);
+    CHECK_EQ(events[5].key_code, 0x77);
+
+    // Too short for the report
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, 16, &keys), false);
+
+    // Boot style key arrays decode through the plan too, and stay in boot protocol
+    CHECK_EQ(hid_plan_compile(boot_keyboard_desc, sizeof(boot_keyboard_desc), &plan), true);
+    CHECK_EQ(hid_plan_is_nkro_keyboard(&plan), false);
+    const uint8_t boot[] = {0x04, 0x00, 0x04, 0x00, 0x65, 0x66, 0x00, 0x00};
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, boot, sizeof(boot), &keys), true);
+    CHECK_EQ(key_bitmap_modifiers(&keys), 0x04);
+    CHECK_EQ(key_bitmap_test(&keys, 0x04), true);
+    CHECK_EQ(key_bitmap_test(&keys, 0x65), true);
+    CHECK_EQ(key_bitmap_test(&keys, 0x66), false);  // Outside the logical range
+    CHECK_EQ(key_bitmap_test(&keys, 0x77), false);
+}
+
+// Keyboard with modifiers and a key array, Report Size and the 16 bit Report Count are patched
+static uint8_t sized_keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75,
+    0x01, 0x95, 0x08, 0x81, 0x02, 0x75, 0x08, 0x96, 0x06, 0x00, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x19, 0x00,
+    0x29, 0xFF, 0x81, 0x00, 0xC0,
+};
+
+static bool compile_sized_keyboard(uint8_t report_size, uint16_t report_count, hid_plan_t* plan) {
+    sized_keyboard_desc[23] = report_size;
+    sized_keyboard_desc[25] = report_count & 0xFF;
+    sized_keyboard_desc[26] = report_count >> 8;
+    return hid_plan_compile(sized_keyboard_desc, sizeof(sized_keyboard_desc), plan);
+}
+
+static void test_plan_oversized(void) {
+    hid_plan_t   plan;
+    key_bitmap_t keys;
+    uint8_t      data[HID_INPUT_RAW_MAX] = {0x02};
+
+    // 63 key slots fill the longest report exactly
+    data[HID_INPUT_RAW_MAX - 1] = 0x04;
+    CHECK_EQ(compile_sized_keyboard(8, 63, &plan), true);
+    CHECK_EQ(plan.reports[0].bit_length, HID_INPUT_RAW_MAX * 8);
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, sizeof(data), &keys), true);
+    CHECK_EQ(key_bitmap_test(&keys, 0x04), true);
+
+    // One slot more can never be received, the report is rejected instead of read past its end
+    CHECK_EQ(compile_sized_keyboard(8, 64, &plan), true);
+    CHECK_EQ(hid_plan_is_keyboard_report(&plan, data, sizeof(data)), false);
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, sizeof(data), &keys), false);
+
+    CHECK_EQ(compile_sized_keyboard(8, 0xFFFF, &plan), true);
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, sizeof(data), &keys), false);
+
+    // 32 * 2048 bits wrap a 16 bit length to 0, which would make every report fit
+    CHECK_EQ(compile_sized_keyboard(32, 0x0800, &plan), true);
+    CHECK_EQ(plan.reports[0].bit_length > HID_INPUT_RAW_MAX * 8, true);
+    CHECK_EQ(hid_plan_parse_keyboard(&plan, data, 2, &keys), false);
+    for (uint8_t i = 0; i < plan.field_count; i++) {
+        CHECK_EQ(plan.fields[i].target != HID_PLAN_TARGET_KEY_ARRAY, true);
+    }
+}
+
+// Composite interface: keyboard (ID 1), mouse (ID 2), media keys as a usage array (ID 3) and
+// as single bits for volume up/down (ID 4)
+static const uint8_t combo_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01,
+    0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x19, 0x00, 0x29, 0x65,
+    0x81, 0x00, 0xC0, 0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19,
+    0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01, 0x75, 0x05, 0x81,
+    0x01, 0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06, 0xC0,
+    0xC0, 0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x03, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF,
+    0x03, 0x75, 0x10, 0x95, 0x02, 0x81, 0x00, 0xC0, 0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x04, 0x15, 0x00,
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x02, 0x09, 0xE9, 0x09, 0xEA, 0x81, 0x02, 0x95, 0x06, 0x81, 0x01, 0xC0,
+};
+
+static void test_plan_routes(void) {
+    hid_plan_t        plan;
+    hid_route_table_t table;
+    CHECK_EQ(hid_plan_compile(combo_desc, sizeof(combo_desc), &plan), true);
+    CHECK_EQ(plan.uses_report_ids, true);
+
+    // Report protocol interface: every report ID goes to its own parser
+    hid_route_build(&table, &plan, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, false);
+    const uint8_t keyboard[] = {0x01, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t mouse[]    = {0x02, 0x01, 0xFE, 0x03};
+    const uint8_t unknown[]  = {0x09, 0x00};
+    CHECK_EQ(hid_route_lookup(&table, keyboard, sizeof(keyboard)).kind, HID_ROUTE_KEYBOARD);
+    CHECK_EQ(hid_route_lookup(&table, mouse, sizeof(mouse)).kind, HID_ROUTE_MOUSE);
+    CHECK_EQ(hid_route_lookup(&table, unknown, sizeof(unknown)).kind, HID_ROUTE_GENERIC);
+    CHECK_EQ(hid_route_lookup(&table, keyboard, 0).kind, HID_ROUTE_DROP);
+
+    hid_route_t  route = hid_route_lookup(&table, keyboard, sizeof(keyboard));
+    key_bitmap_t keys  = {0};
+    CHECK_EQ(hid_plan_decode_keyboard(&plan, &plan.reports[route.report], keyboard, sizeof(keyboard), &keys), true);
+    CHECK_EQ(key_bitmap_modifiers(&keys), 0x02);
+    CHECK_EQ(key_bitmap_test(&keys, 0x04), true);
+    CHECK_EQ(hid_plan_decode_keyboard(&plan, &plan.reports[route.report], keyboard, 7, &keys), false);
+
+    route = hid_route_lookup(&table, mouse, sizeof(mouse));
+    mouse_report_t rpt;
+    CHECK_EQ(hid_plan_decode_mouse(&plan, &plan.reports[route.report], mouse, sizeof(mouse), &rpt), true);
+    CHECK_EQ(rpt.buttons.button1, 1);
+    CHECK_EQ(rpt.x_displacement, -2);
+    CHECK_EQ(rpt.y_displacement, 3);
+    CHECK_EQ(hid_plan_decode_keyboard(&plan, &plan.reports[route.report], mouse, sizeof(mouse), &keys), false);
+
+    // Media keys, array and bit style
+    const uint8_t   media[]  = {0x03, 0xCD, 0x00, 0xE2, 0x00};  // Play/Pause and Mute
+    const uint8_t   volume[] = {0x04, 0x02};                    // Volume Down
+    consumer_keys_t prev     = {0};
+    consumer_keys_t next;
+    route = hid_route_lookup(&table, media, sizeof(media));
+    CHECK_EQ(route.kind, HID_ROUTE_CONSUMER);
+    CHECK_EQ(hid_plan_decode_consumer(&plan, &plan.reports[route.report], media, sizeof(media), &next), true);
+    CHECK_EQ(next.count, 2);
+
+    consumer_event_t events[2 * CONSUMER_KEYS_MAX];
+    CHECK_EQ(consumer_keys_diff(&prev, &next, events), 2);
+    CHECK_EQ(events[0].state, KEY_STATE_PRESSED);
+    CHECK_EQ(events[0].usage, 0xCD);
+    CHECK_EQ(events[1].usage, 0xE2);
+    prev = next;
+
+    route = hid_route_lookup(&table, volume, sizeof(volume));
+    CHECK_EQ(route.kind, HID_ROUTE_CONSUMER);
+    CHECK_EQ(hid_plan_decode_consumer(&plan, &plan.reports[route.report], volume, sizeof(volume), &next), true);
+    CHECK_EQ(consumer_keys_diff(&prev, &next, events), 3);
+    CHECK_EQ(events[0].state, KEY_STATE_RELEASED);
+    CHECK_EQ(events[2].state, KEY_STATE_PRESSED);
+    CHECK_EQ(events[2].usage, 0xEA);
+
+    // Boot keyboard interface: reports have no ID and the plan does not apply
+    hid_route_build(&table, &plan, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD, true);
+    CHECK_EQ(hid_route_lookup(&table, mouse, sizeof(mouse)).kind, HID_ROUTE_KEYBOARD_BOOT);
+
+    // Boot mouse without a plan
+    hid_route_build(&table, NULL, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE, true);
+    CHECK_EQ(hid_route_lookup(&table, mouse, sizeof(mouse)).kind, HID_ROUTE_MOUSE_BOOT);
+}
+
+typedef struct {
+    int                      calls;
+    const hid_input_event_t* last;
+    bool                     keep;  // Retain the event like a subscriber handing it to another task
+} bus_probe_t;
+
+static void bus_probe(const hid_input_event_t* event, void* arg) {
+    bus_probe_t* probe = (bus_probe_t*)arg;
+    probe->calls++;
+    probe->last = event;
+    if (probe->keep) {
+        hid_input_event_retain(event);
+    }
+}
+
+static void test_input_bus(void) {
+    hid_input_event_t      events[2];
+    hid_input_subscriber_t subscribers[3];
+    hid_input_bus_t        bus;
+    hid_input_bus_init(&bus, events, 2, subscribers, 3);
+
+    bus_probe_t        all = {0}, media = {0}, keys = {0};
+    hid_input_filter_t filter = HID_INPUT_FILTER_ANY;
+    CHECK_EQ(hid_input_bus_wants(&bus, HID_INPUT_EVENT_MOUSE), false);
+    CHECK_EQ(hid_input_subscribe(&bus, &filter, bus_probe, &all), 0);
+    filter.types     = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_CONSUMER);
+    filter.report_id = 3;
+    CHECK_EQ(hid_input_subscribe(&bus, &filter, bus_probe, &media), 1);
+    filter.types     = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEY);
+    filter.report_id = -1;
+    filter.key_min   = HID_KEY_F11;
+    filter.key_max   = HID_KEY_F12;
+    CHECK_EQ(hid_input_subscribe(&bus, &filter, bus_probe, &keys), 2);
+    CHECK_EQ(hid_input_subscribe(&bus, &filter, bus_probe, &keys), -1);
+    CHECK_EQ(hid_input_bus_wants(&bus, HID_INPUT_EVENT_MOUSE), true);
+
+    // Decoded once, delivered by reference to every matching subscriber
+    hid_input_interface_t iface;
+    hid_input_interface_init(&iface, 1, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, combo_desc, sizeof(combo_desc));
+    const uint8_t media_report[] = {0x03, 0xCD, 0x00, 0x00, 0x00};
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, media_report, sizeof(media_report), 100), 1);
+    CHECK_EQ(all.calls, 1);
+    CHECK_EQ(media.calls, 1);
+    CHECK_EQ(all.last == media.last, true);
+    CHECK_EQ(media.last->device_id, 1);
+    CHECK_EQ(media.last->report_id, 3);
+    CHECK_EQ(media.last->consumer.usage, 0xCD);
+    CHECK_EQ(hid_input_bus_in_use(&bus), 0);
+
+    // Key events pass the key range, the keyboard state event carries the raw report
+    const uint8_t keyboard_report[] = {0x01, 0x00, HID_KEY_A, HID_KEY_F12, 0x00, 0x00, 0x00, 0x00};
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, keyboard_report, sizeof(keyboard_report), 200), 3);
+    CHECK_EQ(all.calls, 4);
+    CHECK_EQ(keys.calls, 1);
+    CHECK_EQ(keys.last->key.key_code, HID_KEY_F12);
+    CHECK_EQ(all.last->type, HID_INPUT_EVENT_KEYBOARD);
+    CHECK_EQ(all.last->raw_length, sizeof(keyboard_report));
+    CHECK_EQ(key_bitmap_test(&all.last->keys, HID_KEY_A), true);
+
+    // Retained events stay out of the pool until released, an exhausted pool drops events
+    all.keep = true;
+    const uint8_t mouse_report[] = {0x02, 0x00, 0x01, 0x01};
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, mouse_report, sizeof(mouse_report), 300), 1);
+    const hid_input_event_t* kept = all.last;
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, mouse_report, sizeof(mouse_report), 400), 1);
+    CHECK_EQ(hid_input_bus_in_use(&bus), 2);
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, mouse_report, sizeof(mouse_report), 500), 0);
+    CHECK_EQ(bus.dropped, 1);
+    CHECK_EQ(kept->timestamp_us, 300);
+    hid_input_event_release(kept);
+    hid_input_event_release(all.last);
+    CHECK_EQ(hid_input_bus_in_use(&bus), 0);
+
+    hid_input_unsubscribe(&bus, 0);
+    CHECK_EQ(hid_input_bus_wants(&bus, HID_INPUT_EVENT_MOUSE), false);
+    CHECK_EQ(hid_input_interface_report(&iface, &bus, mouse_report, sizeof(mouse_report), 600), 0);
+    CHECK_EQ(all.calls, 6);
+}
+
+static void test_input_snapshot(void) {
+    hid_input_event_t      events[2];
+    hid_input_subscriber_t subscribers[1];
+    hid_input_bus_t        bus;
+    hid_input_snapshot_t   snapshot = {0};
+    hid_input_state_t      state;
+    hid_input_bus_init(&bus, events, 2, subscribers, 1);
+
+    hid_input_filter_t filter = HID_INPUT_FILTER_ANY;
+    filter.types              = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEYBOARD) |
+                   HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_MOUSE) | HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_GAMEPAD);
+    CHECK_EQ(hid_input_subscribe(&bus, &filter, hid_input_snapshot_event, &snapshot), 0);
+    CHECK_EQ(hid_input_snapshot_try_read(&snapshot, &state), true);
+    CHECK_EQ(state.updates, 0);
+
+    // Keys held on two keyboards are merged, releasing one keeps the other
+    hid_input_interface_t combo, boot;
+    hid_input_interface_init(&combo, 1, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, combo_desc, sizeof(combo_desc));
+    hid_input_interface_init(&boot, 2, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD, NULL, 0);
+    const uint8_t combo_keys[] = {0x01, 0x00, HID_KEY_A, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t boot_keys[]  = {0x00, 0x00, HID_KEY_Z, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t no_keys[]    = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    hid_input_interface_report(&combo, &bus, combo_keys, sizeof(combo_keys), 100);
+    hid_input_interface_report(&boot, &bus, boot_keys, sizeof(boot_keys), 200);
+    CHECK_EQ(hid_input_snapshot_read(&snapshot, &state), true);
+    CHECK_EQ(state.updates, 2);
+    CHECK_EQ(key_bitmap_test(&state.keys, HID_KEY_A), true);
+    CHECK_EQ(key_bitmap_test(&state.keys, HID_KEY_Z), true);
+    hid_input_interface_report(&boot, &bus, no_keys, sizeof(no_keys), 300);
+    CHECK_EQ(hid_input_snapshot_read(&snapshot, &state), true);
+    CHECK_EQ(key_bitmap_test(&state.keys, HID_KEY_A), true);
+    CHECK_EQ(key_bitmap_test(&state.keys, HID_KEY_Z), false);
+
+    // Pointer motion accumulates across reports
+    const uint8_t mouse_report[] = {0x02, 0x01, 0x03, 0xFE};
+    hid_input_interface_report(&combo, &bus, mouse_report, sizeof(mouse_report), 400);
+    hid_input_interface_report(&combo, &bus, mouse_report, sizeof(mouse_report), 500);
+    CHECK_EQ(hid_input_snapshot_read(&snapshot, &state), true);
+    CHECK_EQ(state.pointer.x, 6);
+    CHECK_EQ(state.pointer.y, -4);
+    CHECK_EQ(state.pointer.buttons, 1);
+
+    // A disconnect releases the keys of the device
+    hid_input_snapshot_clear_device(&snapshot, 1);
+    CHECK_EQ(hid_input_snapshot_read(&snapshot, &state), true);
+    CHECK_EQ(key_bitmap_test(&state.keys, HID_KEY_A), false);
+    CHECK_EQ(state.updates, 6);
+    CHECK_EQ(state.pointer.x, 6);
+
+    // A copy taken while a write is in progress is rejected
+    atomic_fetch_add(&snapshot.sequence, 1);
+    CHECK_EQ(hid_input_snapshot_try_read(&snapshot, &state), false);
+    // A reader that keeps the writer from finishing gives up instead of spinning
+    CHECK_EQ(hid_input_snapshot_read(&snapshot, &state), false);
+    atomic_fetch_add(&snapshot.sequence, 1);
+    CHECK_EQ(hid_input_snapshot_try_read(&snapshot, &state), true);
+}
+
+static void test_gamepad_changes(void) {
+    gamepad_change_t changes[GAMEPAD_DIFF_MAX_CHANGES];
+    gamepad_report_t prev = {.lx = 128, .ly = 128};
+    gamepad_report_t next = {.lx = 130, .ly = 120};
+    next.buttons.val      = 1u << GAMEPAD_BUTTON_START;
+
+    // Axis moves up to the threshold are ignored and do not move the reference
+    CHECK_EQ(gamepad_report_diff(&prev, &next, 2, changes), 2);
+    CHECK_EQ(changes[0].axis, false);
+    CHECK_EQ(changes[0].index, GAMEPAD_BUTTON_START);
+    CHECK_EQ(changes[0].value, 1);
+    CHECK_EQ(changes[1].axis, true);
+    CHECK_EQ(changes[1].index, GAMEPAD_AXIS_LY);
+    CHECK_EQ(changes[1].value, 120);
+    CHECK_EQ(prev.lx, 128);
+    next.lx = 131;
+    CHECK_EQ(gamepad_report_diff(&prev, &next, 2, changes), 1);
+    CHECK_EQ(changes[0].index, GAMEPAD_AXIS_LX);
+    CHECK_EQ(gamepad_report_diff(&prev, &next, 0, changes), 0);
+
+    hid_input_event_t      events[4];
+    hid_input_subscriber_t subscribers[2];
+    hid_input_bus_t        bus;
+    hid_input_bus_init(&bus, events, 4, subscribers, 2);
+
+    bus_probe_t        all = {0}, buttons = {0};
+    hid_input_filter_t filter = HID_INPUT_FILTER_ANY;
+    hid_input_subscribe(&bus, &filter, bus_probe, &all);
+    filter.types = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_GAMEPAD_BUTTON);
+    hid_input_subscribe(&bus, &filter, bus_probe, &buttons);
+
+    hid_input_interface_t pad;
+    hid_input_interface_init(&pad, 3, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, NULL, 0);
+    pad.gamepad_axis_threshold = 2;
+
+    // The first report is published in full, repeats are dropped
+    uint8_t report[] = {0x01, 0x08, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00};
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 100), 5);
+    CHECK_EQ(all.last->type, HID_INPUT_EVENT_GAMEPAD);
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 200), 0);
+    CHECK_EQ(pad.gamepad_settled, true);
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 300), 0);
+    CHECK_EQ(pad.gamepad_unchanged, 2);
+    CHECK_EQ(all.calls, 5);
+
+    // Button edges and axis moves beyond the threshold are published with the report
+    report[3] = 0x40;
+    report[4] = 0x82;
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 400), 2);
+    CHECK_EQ(buttons.calls, 1);
+    CHECK_EQ(buttons.last->gamepad_change.index, GAMEPAD_BUTTON_A);
+    CHECK_EQ(buttons.last->gamepad_change.value, 1);
+    CHECK_EQ(buttons.last->device_id, 3);
+    report[4] = 0x83;
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 500), 2);
+    CHECK_EQ(all.calls, 9);
+    CHECK_EQ(all.last->gamepad.report.lx, 0x83);
+
+    // A short report is published once, the next valid report in full even without changes
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, 5, 600), 1);
+    CHECK_EQ(all.last->gamepad.valid, false);
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, 5, 700), 0);
+    CHECK_EQ(hid_input_interface_report(&pad, &bus, report, sizeof(report), 800), 1);
+    CHECK_EQ(all.last->gamepad.valid, true);
+    CHECK_EQ(hid_input_bus_in_use(&bus), 0);
+}
+
+static void test_cached_plan(void) {
+    // The descriptor hash tells a changed descriptor apart from the cached one
+    uint8_t changed[sizeof(combo_desc)];
+    memcpy(changed, combo_desc, sizeof(changed));
+    changed[sizeof(changed) - 2] ^= 1;
+    uint32_t hash = hid_plan_descriptor_hash(combo_desc, sizeof(combo_desc));
+    CHECK_EQ(hid_plan_descriptor_hash(combo_desc, sizeof(combo_desc)), hash);
+    CHECK_EQ(hid_plan_descriptor_hash(changed, sizeof(changed)) != hash, true);
+    CHECK_EQ(hid_plan_descriptor_hash(combo_desc, 4) != hid_plan_descriptor_hash(combo_desc, 5), true);
+
+    // An interface set up from a cached plan decodes like one that compiled the descriptor
+    hid_input_interface_t compiled, cached;
+    hid_input_interface_init(&compiled, 1, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, combo_desc, sizeof(combo_desc));
+    hid_input_interface_init_plan(&cached, 1, HID_SUBCLASS_NO_SUBCLASS, HID_PROTOCOL_NONE, &compiled.plan);
+    CHECK_EQ(cached.has_plan, true);
+    CHECK_EQ(cached.keyboard_boot, compiled.keyboard_boot);
+    CHECK_EQ(memcmp(&cached.routes, &compiled.routes, sizeof(cached.routes)), 0);
+
+    // Without a plan the boot layout is used, as for a descriptor that did not compile
+    hid_input_interface_init_plan(&cached, 2, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD, NULL);
+    CHECK_EQ(cached.has_plan, false);
+    CHECK_EQ(cached.keyboard_boot, true);
+    CHECK_EQ(cached.routes.routes[0].kind, HID_ROUTE_KEYBOARD_BOOT);
+}
+
+static void test_key_repeat(void) {
+    key_repeat_t repeat;
+    key_event_t  event;
+    key_repeat_init(&repeat, 500, 20);
+
+    const key_event_t press_a   = {.state = KEY_STATE_PRESSED, .modifier = 0x00, .key_code = 0x04};
+    const key_event_t press_b   = {.state = KEY_STATE_PRESSED, .modifier = 0x02, .key_code = 0x05};
+    const key_event_t press_mod = {.state = KEY_STATE_PRESSED, .modifier = 0x02, .key_code = HID_KEY_LEFT_SHIFT};
+    const key_event_t release_a = {.state = KEY_STATE_RELEASED, .modifier = 0x02, .key_code = 0x04};
+    const key_event_t release_b = {.state = KEY_STATE_RELEASED, .modifier = 0x02, .key_code = 0x05};
+
+    key_repeat_update(&repeat, &press_a, 0);
+    CHECK_EQ(key_repeat_poll(&repeat, 499999, &event), false);
+    CHECK_EQ(key_repeat_poll(&repeat, 500000, &event), true);
+    CHECK_EQ(event.state, KEY_STATE_REPEAT);
+    CHECK_EQ(event.key_code, 0x04);
+    CHECK_EQ(key_repeat_poll(&repeat, 500000, &event), false);
+    CHECK_EQ(repeat.due_us, 550000);
+
+    // Modifiers do not repeat but show up in the repeats
+    key_repeat_update(&repeat, &press_mod, 520000);
+    CHECK_EQ(key_repeat_poll(&repeat, 550000, &event), true);
+    CHECK_EQ(event.key_code, 0x04);
+    CHECK_EQ(event.modifier, 0x02);
+
+    // The newest key takes over, releasing an older key does not stop it
+    key_repeat_update(&repeat, &press_b, 560000);
+    key_repeat_update(&repeat, &release_a, 570000);
+    CHECK_EQ(key_repeat_poll(&repeat, 1059999, &event), false);
+    CHECK_EQ(key_repeat_poll(&repeat, 1060000, &event), true);
+    CHECK_EQ(event.key_code, 0x05);
+
+    // A late poll produces one repeat and restarts the schedule
+    CHECK_EQ(key_repeat_poll(&repeat, 2000000, &event), true);
+    CHECK_EQ(key_repeat_poll(&repeat, 2000000, &event), false);
+    CHECK_EQ(repeat.due_us, 2050000);
+
+    key_repeat_update(&repeat, &release_b, 2010000);
+    CHECK_EQ(key_repeat_active(&repeat), false);
+    CHECK_EQ(key_repeat_poll(&repeat, 3000000, &event), false);
+}
+
+static void test_event_frame(void) {
+    const uint8_t zeros[] = {0x00, 0x11, 0x00, 0x00, 0x22};
+    uint8_t       encoded[16];
+    uint8_t       decoded[16];
+
+    CHECK_EQ(cobs_encode(zeros, sizeof(zeros), encoded), sizeof(zeros) + 1);
+    CHECK_EQ(memchr(encoded, 0, sizeof(zeros) + 1) == NULL, true);
+    CHECK_EQ(cobs_decode(encoded, sizeof(zeros) + 1, decoded, sizeof(decoded)), sizeof(zeros));
+    CHECK_EQ(memcmp(decoded, zeros, sizeof(zeros)), 0);
+    CHECK_EQ(cobs_decode(encoded, sizeof(zeros) + 1, decoded, 3), 0);  // Does not fit
+
+    const event_record_header_t header = {.type = EVENT_RECORD_MOUSE, .device_id = 2, .timestamp_us = 0x100};
+    const event_mouse_t         mouse  = {.buttons = 1, .x_displacement = -1, .y_displacement = 0x100};
+    uint8_t                     frame[EVENT_FRAME_MAX];
+    size_t                      length = event_frame_encode(&header, &mouse, sizeof(mouse), frame);
+    CHECK_EQ(length, sizeof(header) + sizeof(mouse) + 3);
+    CHECK_EQ(frame[length - 1], 0);
+    CHECK_EQ(memchr(frame, 0, length - 1) == NULL, true);
+
+    event_record_header_t out_header;
+    uint8_t               payload[EVENT_RECORD_MAX];
+    size_t                payload_length = 0;
+    CHECK_EQ(event_frame_decode(frame, length - 1, &out_header, payload, &payload_length), true);
+    CHECK_EQ(out_header.type, EVENT_RECORD_MOUSE);
+    CHECK_EQ(out_header.device_id, 2);
+    CHECK_EQ(out_header.timestamp_us, 0x100);
+    CHECK_EQ(payload_length, sizeof(mouse));
+    CHECK_EQ(memcmp(payload, &mouse, sizeof(mouse)), 0);
+
+    // A flipped bit fails the CRC
+    frame[3] ^= 0x04;
+    CHECK_EQ(event_frame_decode(frame, length - 1, &out_header, payload, &payload_length), false);
+}
+
+static void test_plan_mouse(void) {
+    hid_plan_t plan;
+    CHECK_EQ(hid_plan_compile(mouse_desc, sizeof(mouse_desc), &plan), true);
+    CHECK_EQ(plan.uses_report_ids, true);
+    CHECK_EQ(plan.report_count, 1);
+    CHECK_EQ(plan.reports[0].bit_length, 56);
+
+    const uint8_t  data[] = {0x02, 0x05, 0x00, 0xFF, 0x2F, 0x00, 0xFF, 0x01};
+    mouse_report_t rpt;
+    CHECK_EQ(hid_plan_parse_mouse(&plan, data, sizeof(data), &rpt), true);
+    CHECK_EQ(rpt.buttons.val, 0x05);
+    CHECK_EQ(rpt.x_displacement, -1);
+    CHECK_EQ(rpt.y_displacement, 2);
+    CHECK_EQ(rpt.scroll, -1);
+    CHECK_EQ(rpt.tilt, 1);
+
+    // Unknown report ID and truncated reports fall back to the legacy parser
+    const uint8_t other[] = {0x03, 0x05, 0x00, 0xFF, 0x2F, 0x00, 0xFF, 0x01};
+    CHECK_EQ(hid_plan_parse_mouse(&plan, other, sizeof(other), &rpt), false);
+    CHECK_EQ(hid_plan_parse_mouse(&plan, data, 4, &rpt), false);
+}
+
+// Mouse with buttons 1-3 and 4-5 in separate Input items and a run of buttons 9-16, no report IDs
+static const uint8_t split_buttons_mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15,
+    0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0x19, 0x04, 0x29, 0x05, 0x95, 0x02, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01, 0x19, 0x09, 0x29, 0x10, 0x95, 0x08, 0x75, 0x01, 0x81, 0x02, 0x05,
+    0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06, 0xC0, 0xC0,
+};
+
+static void test_plan_mouse_split_buttons(void) {
+    hid_plan_t     plan;
+    mouse_report_t rpt;
+
+    CHECK_EQ(hid_plan_compile(split_buttons_mouse_desc, sizeof(split_buttons_mouse_desc), &plan), true);
+    CHECK_EQ(plan.reports[0].bit_length, 32);
+
+    // Buttons 1, 4 and 5 come from both runs, buttons 9-16 are all pressed but do not fit
+    const uint8_t data[] = {0x19, 0xFF, 0x01, 0xFF};
+    CHECK_EQ(hid_plan_parse_mouse(&plan, data, sizeof(data), &rpt), true);
+    CHECK_EQ(rpt.buttons.val, 0x19);
+    CHECK_EQ(rpt.x_displacement, 1);
+    CHECK_EQ(rpt.y_displacement, -1);
+}
+
+static void test_plan_gamepad(void) {
+    hid_plan_t plan;
+    CHECK_EQ(hid_plan_compile(gamepad_desc, sizeof(gamepad_desc), &plan), true);
+    CHECK_EQ(plan.uses_report_ids, false);
+
+    const uint8_t    data[] = {0x00, 0xFF, 0x80, 0x40, 0x02, 0x05, 0x08};
+    gamepad_report_t rpt;
+    CHECK_EQ(hid_plan_parse_gamepad(&plan, data, sizeof(data), &rpt), true);
+    CHECK_EQ(rpt.lx, 0x00);
+    CHECK_EQ(rpt.ly, 0xFF);
+    CHECK_EQ(rpt.rx, 0x80);
+    CHECK_EQ(rpt.ry, 0x40);
+    CHECK_EQ(rpt.buttons.right, 1);
+    CHECK_EQ(rpt.buttons.up, 0);
+    CHECK_EQ(rpt.buttons.a, 1);
+
+    // Hat null state (outside the logical range) is centered
+    const uint8_t centered[] = {0x80, 0x80, 0x80, 0x80, 0x0F, 0x00, 0x00};
+    CHECK_EQ(hid_plan_parse_gamepad(&plan, centered, sizeof(centered), &rpt), true);
+    CHECK_EQ(rpt.buttons.val, 0);
+}
+
+static gamepad_report_t gamepad_axes(uint8_t lx, uint8_t ly, uint8_t lt) {
+    gamepad_report_t rpt = {.lx = lx, .ly = ly, .rx = 128, .ry = 128, .lt = lt, .rt = 0};
+    return rpt;
+}
+
+static void test_gamepad_condition(void) {
+    CHECK_EQ(gamepad_isqrt(0), 0);
+    CHECK_EQ(gamepad_isqrt(15), 3);
+    CHECK_EQ(gamepad_isqrt(16), 4);
+    CHECK_EQ(gamepad_isqrt(2u * 32767 * 32767), 46339);
+
+    gamepad_condition_config_t config = {
+        .axial_deadzone   = 983,    // 3 %
+        .radial_inner     = 2621,   // 8 %
+        .radial_outer     = 31128,  // 95 %
+        .trigger_deadzone = 1310,   // 4 %
+        .min_cutoff_mhz   = 0,
+    };
+    gamepad_condition_t cond;
+    gamepad_condition_init(&cond, &config);
+
+    gamepad_report_t rpt = gamepad_axes(128, 128, 0);
+    gamepad_condition_apply(&cond, &rpt, 0);
+    CHECK_EQ(rpt.lx, 128);
+    CHECK_EQ(rpt.ly, 128);
+    CHECK_EQ(rpt.rx, 128);
+
+    // Small deflections fall in the deadzones, full deflection reaches the ends
+    rpt = gamepad_axes(136, 121, 8);
+    gamepad_condition_apply(&cond, &rpt, 1000);
+    CHECK_EQ(rpt.lx, 128);
+    CHECK_EQ(rpt.ly, 128);
+    CHECK_EQ(rpt.lt, 0);
+    rpt = gamepad_axes(255, 128, 255);
+    gamepad_condition_apply(&cond, &rpt, 2000);
+    CHECK_EQ(rpt.lx, 255);
+    CHECK_EQ(rpt.ly, 128);
+    CHECK_EQ(rpt.lt, 255);
+    rpt = gamepad_axes(0, 128, 0);
+    gamepad_condition_apply(&cond, &rpt, 3000);
+    CHECK_EQ(rpt.lx, 0);
+
+    // The corner of the square range maps onto the circle
+    rpt = gamepad_axes(255, 255, 0);
+    gamepad_condition_apply(&cond, &rpt, 4000);
+    CHECK_EQ(rpt.lx, 218);
+    CHECK_EQ(rpt.ly, 218);
+
+    // Calibration: rest first, then the range; the triggers are not moved and keep their range
+    gamepad_calibration_t calibration;
+    gamepad_calibration_begin(&cond);
+    rpt = gamepad_axes(140, 120, 0);
+    gamepad_condition_apply(&cond, &rpt, 5000);
+    rpt = gamepad_axes(30, 20, 0);
+    gamepad_condition_apply(&cond, &rpt, 6000);
+    rpt = gamepad_axes(230, 220, 0);
+    gamepad_condition_apply(&cond, &rpt, 7000);
+    CHECK_EQ(gamepad_calibration_end(&cond, &calibration), true);
+    CHECK_EQ(calibration.center[GAMEPAD_AXIS_LX], 140);
+    CHECK_EQ(calibration.min[GAMEPAD_AXIS_LY], 20);
+    CHECK_EQ(calibration.max[GAMEPAD_AXIS_LT], 255);
+    CHECK_EQ(calibration.min[GAMEPAD_AXIS_RX], 0);  // Not moved
+    CHECK_EQ(gamepad_calibration_end(&cond, &calibration), false);
+
+    rpt = gamepad_axes(140, 120, 0);
+    gamepad_condition_apply(&cond, &rpt, 8000);
+    CHECK_EQ(rpt.lx, 128);
+    CHECK_EQ(rpt.ly, 128);
+    rpt = gamepad_axes(230, 120, 0);
+    gamepad_condition_apply(&cond, &rpt, 9000);
+    CHECK_EQ(rpt.lx, 255);
+    rpt = gamepad_axes(30, 120, 0);
+    gamepad_condition_apply(&cond, &rpt, 10000);
+    CHECK_EQ(rpt.lx, 0);
+
+    // Smoothing: jitter at rest is removed, a fast move is followed faster with a higher beta
+    config.axial_deadzone = 0;
+    config.radial_inner   = 0;
+    config.radial_outer   = 32767;
+    config.min_cutoff_mhz = 1000;
+    config.d_cutoff_mhz   = 1000;
+    config.beta           = 0;
+    gamepad_condition_t slow;
+    gamepad_condition_init(&slow, &config);
+    config.beta = 3000;
+    gamepad_condition_t fast;
+    gamepad_condition_init(&fast, &config);
+
+    for (int i = 0; i < 100; i++) {
+        rpt = gamepad_axes(200 + (i & 1), 128, 0);
+        gamepad_condition_apply(&slow, &rpt, i * 1000);
+        CHECK_EQ(rpt.lx, 200);
+        rpt = gamepad_axes(200, 128, 0);
+        gamepad_condition_apply(&fast, &rpt, i * 1000);
+    }
+
+    gamepad_report_t slow_rpt;
+    gamepad_report_t fast_rpt;
+    for (int i = 0; i < 20; i++) {
+        slow_rpt = gamepad_axes(255, 128, 0);
+        fast_rpt = gamepad_axes(255, 128, 0);
+        gamepad_condition_apply(&slow, &slow_rpt, 100000 + i * 1000);
+        gamepad_condition_apply(&fast, &fast_rpt, 100000 + i * 1000);
+    }
+    CHECK_EQ(slow_rpt.lx < fast_rpt.lx, true);
+    CHECK_EQ(fast_rpt.lx > 250, true);
+
+    // A pause restarts the filter, the first report after it passes unfiltered
+    slow_rpt = gamepad_axes(0, 128, 0);
+    gamepad_condition_apply(&slow, &slow_rpt, 5000000);
+    CHECK_EQ(slow_rpt.lx, 0);
+}
+
+static void test_mouse_motion(void) {
+    const mouse_accel_t flat = {.sensitivity_q8 = 128, .accel_q8 = 0, .threshold_q8 = 0, .max_gain_q8 = 128};
+    mouse_motion_t      motion;
+    mouse_motion_init(&motion, &flat, 100, 50);
+    CHECK_EQ(motion.x, 49);
+    CHECK_EQ(motion.y, 24);
+
+    // Half a pixel per count: single counts are carried over, not lost
+    CHECK_EQ(mouse_motion_apply(&motion, 1, 0, 16000), false);
+    CHECK_EQ(mouse_motion_apply(&motion, 1, 0, 16000), true);
+    CHECK_EQ(motion.x, 50);
+    mouse_motion_apply(&motion, -3, -1, 16000);
+    CHECK_EQ(motion.x, 48);
+    CHECK_EQ(motion.y, 23);
+    CHECK_EQ(motion.carry_x, 128);
+
+    // Clamped to the bounds, pushing against an edge drops the remainder
+    mouse_motion_apply(&motion, 1001, -1000, 16000);
+    CHECK_EQ(motion.x, 99);
+    CHECK_EQ(motion.y, 0);
+    CHECK_EQ(motion.carry_x, 0);
+    mouse_motion_apply(&motion, -2, 0, 16000);
+    CHECK_EQ(motion.x, 98);
+
+    // Gain rises with the speed above the threshold and is capped
+    const mouse_accel_t accel = {.sensitivity_q8 = 256, .accel_q8 = 26, .threshold_q8 = 2 * 256, .max_gain_q8 = 768};
+    CHECK_EQ(mouse_motion_gain(&accel, 16, 0, 16000), 256);          // 1 count/ms
+    CHECK_EQ(mouse_motion_gain(&accel, 0, -160, 16000), 256 + 208);  // 10 counts/ms
+    CHECK_EQ(mouse_motion_gain(&accel, 5000, 5000, 16000), 768);
+    CHECK_EQ(mouse_motion_gain(&accel, 3, 0, 0), 256 + 26);  // Short intervals count as 1 ms
+}
+
+static int fake_surfaces;
+
+static void* fake_render(void* ctx, const void* font, uint16_t size, const char* text, int* width, int* height,
+                         size_t* bytes) {
+    *width  = 8 * strlen(text);
+    *height = size;
+    *bytes  = 100 * strlen(text);
+    fake_surfaces++;
+    return &fake_surfaces;
+}
+
+static void fake_destroy(void* ctx, void* surface) {
+    fake_surfaces--;
+}
+
+static void test_text_cache(void) {
+    static const int       font_a = 0, font_b = 0;
+    const text_cache_ops_t ops    = {.render = fake_render, .destroy = fake_destroy};
+    text_cache_entry_t     entries[3];
+    text_cache_t           cache;
+    text_cache_init(&cache, entries, 3, 500, &ops);
+
+    const text_cache_entry_t* a = text_cache_get(&cache, &font_a, 16, "a");
+    CHECK_EQ(a != NULL, true);
+    CHECK_EQ(a->width, 8);
+    CHECK_EQ(text_cache_get(&cache, &font_a, 16, "a") == a, true);
+    CHECK_EQ(cache.hits, 1);
+    CHECK_EQ(cache.misses, 1);
+
+    // Font and size are part of the key
+    CHECK_EQ(text_cache_get(&cache, &font_b, 16, "a") != a, true);
+    CHECK_EQ(text_cache_get(&cache, &font_a, 12, "a") != a, true);
+    CHECK_EQ(cache.misses, 3);
+    CHECK_EQ(fake_surfaces, 3);
+
+    // Out of entries: the least recently used one goes
+    text_cache_get(&cache, &font_a, 16, "a");
+    text_cache_get(&cache, &font_a, 16, "b");
+    CHECK_EQ(cache.evictions, 1);
+    CHECK_EQ(text_cache_get(&cache, &font_a, 16, "a") != NULL, true);
+    CHECK_EQ(cache.hits, 3);
+
+    // Out of budget: evicts until the new surface fits
+    CHECK_EQ(text_cache_get(&cache, &font_a, 16, "cccc") != NULL, true);
+    CHECK_EQ(cache.bytes <= 500, true);
+    CHECK_EQ(cache.bytes, 500);
+    CHECK_EQ(fake_surfaces, 2);
+
+    // Larger than the whole budget or too long: not cached
+    CHECK_EQ(text_cache_get(&cache, &font_a, 16, "dddddd") == NULL, true);
+    CHECK_EQ(text_cache_get(&cache, &font_a, 16, "0123456789abcdef0123456789abcdef0123456789abcdef") == NULL, true);
+    CHECK_EQ(fake_surfaces, 2);
+
+    text_cache_clear(&cache);
+    CHECK_EQ(fake_surfaces, 0);
+    CHECK_EQ(cache.bytes, 0);
+}
+
+static void test_epaper_schedule(void) {
+    const epaper_schedule_config_t config = {
+        .batch_us         = 100,
+        .min_interval_us  = 1000,
+        .partial_max_area = 50,
+        .full_every       = 2,
+        .full_interval_us = 10000,
+    };
+    epaper_schedule_t schedule;
+    epaper_schedule_init(&schedule, &config, 0);
+    CHECK_EQ(epaper_schedule_due(&schedule, 5000), false);
+
+    // Changes are batched, the first one starts the window
+    epaper_schedule_changed(&schedule, 5000);
+    epaper_schedule_changed(&schedule, 5050);
+    CHECK_EQ(epaper_schedule_due(&schedule, 5099), false);
+    CHECK_EQ(epaper_schedule_due(&schedule, 5100), true);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 5100, 10), EPAPER_REFRESH_PARTIAL);
+    CHECK_EQ(epaper_schedule_due(&schedule, 5200), false);
+
+    // Rate limited
+    epaper_schedule_changed(&schedule, 5200);
+    CHECK_EQ(epaper_schedule_due(&schedule, 6099), false);
+    CHECK_EQ(epaper_schedule_due(&schedule, 6100), true);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 6100, 10), EPAPER_REFRESH_PARTIAL);
+
+    // Forced full refresh after full_every partial ones, and for large changes
+    epaper_schedule_changed(&schedule, 7100);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 7200, 10), EPAPER_REFRESH_FULL);
+    epaper_schedule_changed(&schedule, 8200);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 8300, 51), EPAPER_REFRESH_FULL);
+
+    // Ghosting cleanup without new input, only when partial refreshes are on the panel
+    CHECK_EQ(epaper_schedule_due(&schedule, 30000), false);
+    epaper_schedule_changed(&schedule, 9300);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 9400, 10), EPAPER_REFRESH_PARTIAL);
+    CHECK_EQ(epaper_schedule_due(&schedule, 18299), false);
+    CHECK_EQ(epaper_schedule_due(&schedule, 18300), true);
+    CHECK_EQ(epaper_schedule_refresh(&schedule, 18300, 0), EPAPER_REFRESH_FULL);
+    CHECK_EQ(epaper_schedule_due(&schedule, 60000), false);
+}
+
+static void test_draw_list(void) {
+    draw_op_t   ops[4];
+    char        text[8];
+    draw_list_t list;
+    draw_list_init(&list, ops, 4, text, sizeof(text), 0);
+
+    // Background over nothing is not recorded
+    draw_list_rect(&list, 0, 0, 0, 10, 10);
+    CHECK_EQ(list.count, 0);
+
+    draw_list_text(&list, 1, 10, 20, 16, 8, "ab");
+    draw_list_circle(&list, 2, 50, 50, 5);
+    CHECK_EQ(list.count, 2);
+    CHECK_EQ(list.ops[1].x, 45);
+    CHECK_EQ(list.ops[1].h, 10);
+    CHECK_EQ(strcmp(draw_list_op_text(&list, &list.ops[0]), "ab"), 0);
+    CHECK_EQ(draw_op_in_rows(&list.ops[0], 0, 20), false);
+    CHECK_EQ(draw_op_in_rows(&list.ops[0], 27, 40), true);
+
+    // Erasing part of the text keeps it and records the erase, erasing all of it drops both
+    draw_list_rect(&list, 0, 18, 20, 8, 8);
+    CHECK_EQ(list.count, 3);
+    draw_list_rect(&list, 0, 10, 20, 16, 8);
+    CHECK_EQ(list.count, 1);
+    CHECK_EQ(list.ops[0].kind, DRAW_OP_CIRCLE);
+
+    // A colored rectangle replaces what it covers
+    draw_list_rect(&list, 3, 40, 40, 20, 20);
+    CHECK_EQ(list.count, 1);
+    CHECK_EQ(list.ops[0].kind, DRAW_OP_RECT);
+
+    // Full list or text pool
+    draw_list_text(&list, 1, 0, 0, 8, 8, "abcdefgh");
+    CHECK_EQ(list.overflow, true);
+    draw_list_reset(&list);
+    for (int i = 0; i < 5; i++) {
+        draw_list_circle(&list, 1, i * 10, 0, 2);
+    }
+    CHECK_EQ(list.count, 4);
+    CHECK_EQ(list.overflow, true);
+    CHECK_EQ(list.peak, 4);
+}
+
+static void test_report_ring(void) {
+    report_ring_entry_t entries[4];
+    report_ring_t       ring;
+    CHECK_EQ(report_ring_init(&ring, entries, 3), false);
+    CHECK_EQ(report_ring_init(&ring, entries, 4), true);
+
+    for (int i = 0; i < 5; i++) {
+        report_ring_entry_t* entry = report_ring_reserve(&ring);
+        if (entry != NULL) {
+            entry->length = i;
+            report_ring_commit(&ring);
+        }
+    }
+    CHECK_EQ(report_ring_count(&ring), 4);
+    CHECK_EQ(report_ring_dropped(&ring), 1);
+    CHECK_EQ(report_ring_high_watermark(&ring), 4);
+
+    for (int i = 0; i < 4; i++) {
+        const report_ring_entry_t* entry = report_ring_front(&ring);
+        CHECK_EQ(entry != NULL, true);
+        CHECK_EQ(entry->length, i);
+        report_ring_pop(&ring);
+    }
+    CHECK_EQ(report_ring_front(&ring) == NULL, true);
+}
+
+static void test_latency_hist(void) {
+    latency_hist_t hist = {0};
+    CHECK_EQ(latency_hist_percentile(&hist, 500), 0);
+
+    // Exact below 8 us
+    latency_hist_add(&hist, 5);
+    CHECK_EQ(latency_hist_percentile(&hist, 500), 5);
+    CHECK_EQ(hist.max_us, 5);
+
+    // 1..1000 us: percentiles land within the 25% bucket width
+    hist = (latency_hist_t){0};
+    for (uint32_t i = 1; i <= 1000; i++) {
+        latency_hist_add(&hist, i);
+    }
+    uint32_t p50 = latency_hist_percentile(&hist, 500);
+    uint32_t p99 = latency_hist_percentile(&hist, 990);
+    CHECK_EQ(p50 >= 500 && p50 <= 625, true);
+    CHECK_EQ(p99 >= 990 && p99 <= 1000, true);  // Capped at the maximum
+    CHECK_EQ(latency_hist_percentile(&hist, 1000), 1000);
+
+    // Huge values end up in the last bucket without overflowing
+    latency_hist_add(&hist, UINT32_MAX);
+    CHECK_EQ(hist.buckets[LATENCY_BUCKETS - 1], 1);
+    CHECK_EQ(latency_hist_percentile(&hist, 1000), UINT32_MAX);
+
+    // Stage split
+    latency_reset_device(1);
+    latency_record(1, 1000, 1100, 1500, 3000);
+    CHECK_EQ(latency_get(1, LATENCY_STAGE_PARSE)->max_us, 100);
+    CHECK_EQ(latency_get(1, LATENCY_STAGE_DRAW)->max_us, 400);
+    CHECK_EQ(latency_get(1, LATENCY_STAGE_BLIT)->max_us, 1500);
+    CHECK_EQ(latency_get(1, LATENCY_STAGE_TOTAL)->max_us, 2000);
+    CHECK_EQ(latency_get(CONFIG_HID_MAX_DEVICES, LATENCY_STAGE_TOTAL) == NULL, true);
+}
+
+static void test_rate_meter(void) {
+    CHECK_EQ(rate_meter_snap_interval(130), 125);
+    CHECK_EQ(rate_meter_snap_interval(480), 500);
+    CHECK_EQ(rate_meter_snap_interval(1040), 1000);
+    CHECK_EQ(rate_meter_snap_interval(7900), 8000);
+
+    // 1000 Hz with +-20 us jitter for one window establishes the poll interval
+    rate_meter_t meter;
+    rate_meter_init(&meter);
+    int64_t t         = 0;
+    bool    published = false;
+    for (int i = 0; i <= 1000; i++) {
+        published = rate_meter_add(&meter, t);
+        t += i % 2 ? 1020 : 980;
+    }
+    CHECK_EQ(published, true);
+    CHECK_EQ(meter.stats.rate_hz, 1000);
+    CHECK_EQ(meter.stats.poll_interval_us, 1000);
+    CHECK_EQ(meter.stats.jitter_us, 20);
+    CHECK_EQ(meter.stats.missed, 0);
+
+    // Two missed polls (a 2980 us gap), then a 50 ms pause (idle, not missed) in the next window
+    t += 2000;
+    rate_meter_add(&meter, t);
+    t += 50000;
+    rate_meter_add(&meter, t);
+    while (!rate_meter_add(&meter, t)) {
+        t += 1000;
+    }
+    CHECK_EQ(meter.stats.missed, 2);
+    CHECK_EQ(meter.stats.missed_total, 2);
+    CHECK_EQ(meter.stats.max_gap_us, 2980);
+    CHECK_EQ(meter.stats.poll_interval_us, 1000);
+}
+
+int main(void) {
+    test_sign_extend_12bit();
+    test_mouse_boot();
+    test_mouse_5_bytes();
+    test_mouse_12bit();
+    test_mouse_16bit();
+    test_gamepad_hat();
+    test_gamepad_fields();
+    test_keyboard_diff();
+    test_plan_keyboard();
+    test_plan_oversized();
+    test_plan_routes();
+    test_input_bus();
+    test_input_snapshot();
+    test_gamepad_changes();
+    test_cached_plan();
+    test_key_repeat();
+    test_event_frame();
+    test_plan_mouse();
+    test_plan_mouse_split_buttons();
+    test_plan_gamepad();
+    test_gamepad_condition();
+    test_mouse_motion();
+    test_text_cache();
+    test_epaper_schedule();
+    test_draw_list();
+    test_report_ring();
+    test_latency_hist();
+    test_rate_meter();
+
+    printf("%d checks, %d failures\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// hid_events.c
+//
+// Decodes the binary event stream of the firmware (see event_format.h) into text or CSV.
+// Reads a console log, from a file or stdin, and skips everything that is not a valid frame,
+// such as log lines printed between frames.
+//
+// The console translates every "\n" to "\r\n" by default (CONFIG_LIBC_STDOUT_LINE_ENDING_CRLF);
+// the decoder removes one '\r' before every '\n' to undo that.
+//
+// Usage: hid_events [-c] [-n] [stream.bin]
+//   -c  CSV output
+//   -n  No line ending translation, for consoles configured for LF line endings
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "badge_hid_host.h"
+#include "event_frame.h"
+
+typedef struct {
+    uint64_t frames;
+    uint64_t invalid;  // Frames failing the COBS, CRC or length checks, and log text
+    uint64_t lost;     // Events the firmware reported as dropped
+} events_stats_t;
+
+static bool csv = false;
+
+static const char* key_state_name(uint8_t state) {
+    switch (state) {
+        case KEY_STATE_PRESSED:
+            return "press";
+        case KEY_STATE_RELEASED:
+            return "release";
+        case KEY_STATE_REPEAT:
+            return "repeat";
+        default:
+            return "?";
+    }
+}
+
+/**
+ * @brief Prints one decoded record
+ *
+ * @return false when the payload length does not match the record type
+ */
+static bool print_record(const event_record_header_t* header, const uint8_t* payload, size_t length,
+                         events_stats_t* stats) {
+    switch (header->type) {
+        case EVENT_RECORD_KEY: {
+            event_key_t key;
+            if (length != sizeof(key)) {
+                return false;
+            }
+            memcpy(&key, payload, sizeof(key));
+            printf(csv ? "%u,%u,key,%s,0x%02X,0x%02X,,,,,,,,,,,,\n" : "%u %u key %s 0x%02X mod 0x%02X\n",
+                   header->timestamp_us, header->device_id, key_state_name(key.state), key.key_code, key.modifier);
+            return true;
+        }
+        case EVENT_RECORD_MOUSE: {
+            event_mouse_t mouse;
+            if (length != sizeof(mouse)) {
+                return false;
+            }
+            memcpy(&mouse, payload, sizeof(mouse));
+            printf(csv ? "%u,%u,mouse,,,,0x%02X,%d,%d,%d,%d,,,,,,,\n"
+                       : "%u %u mouse buttons 0x%02X dx %d dy %d scroll %d tilt %d\n",
+                   header->timestamp_us, header->device_id, mouse.buttons, mouse.x_displacement, mouse.y_displacement,
+                   mouse.scroll, mouse.tilt);
+            return true;
+        }
+        case EVENT_RECORD_GAMEPAD: {
+            event_gamepad_t pad;
+            if (length != sizeof(pad)) {
+                return false;
+            }
+            memcpy(&pad, payload, sizeof(pad));
+            printf(csv ? "%u,%u,gamepad,,,,0x%05X,,,,,%u,%u,%u,%u,%u,%u,\n"
+                       : "%u %u gamepad buttons 0x%05X lx %u ly %u rx %u ry %u lt %u rt %u\n",
+                   header->timestamp_us, header->device_id, pad.buttons, pad.lx, pad.ly, pad.rx, pad.ry, pad.lt,
+                   pad.rt);
+            return true;
+        }
+        case EVENT_RECORD_CONSUMER: {
+            event_consumer_t consumer;
+            if (length != sizeof(consumer)) {
+                return false;
+            }
+            memcpy(&consumer, payload, sizeof(consumer));
+            printf(csv ? "%u,%u,consumer,%s,0x%04X,,,,,,,,,,,,,\n" : "%u %u consumer %s 0x%04X\n", header->timestamp_us,
+                   header->device_id, key_state_name(consumer.state), consumer.usage);
+            return true;
+        }
+        case EVENT_RECORD_LOST: {
+            uint32_t lost;
+            if (length != sizeof(lost)) {
+                return false;
+            }
+            memcpy(&lost, payload, sizeof(lost));
+            stats->lost += lost;
+            printf(csv ? "%u,%u,lost,,,,,,,,,,,,,,,%u\n" : "%u %u lost %u\n", header->timestamp_us, header->device_id,
+                   lost);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static void handle_frame(const uint8_t* frame, size_t length, events_stats_t* stats) {
+    event_record_header_t header;
+    uint8_t               payload[EVENT_RECORD_MAX];
+    size_t                payload_length;
+
+    if (length == 0) {
+        return;
+    }
+
+    if (event_frame_decode(frame, length, &header, payload, &payload_length) &&
+        print_record(&header, payload, payload_length, stats)) {
+        stats->frames++;
+    } else {
+        stats->invalid++;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool translate = true;
+    int  opt;
+
+    while ((opt = getopt(argc, argv, "cn")) != -1) {
+        switch (opt) {
+            case 'c':
+                csv = true;
+                break;
+            case 'n':
+                translate = false;
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+
+    if (optind < argc - 1 || optind > argc) {
+        fprintf(stderr, "Usage: %s [-c] [-n] [stream.bin]\n", argv[0]);
+        return 2;
+    }
+
+    FILE* in = optind == argc - 1 ? fopen(argv[optind], "rb") : stdin;
+    if (in == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (csv) {
+        printf("timestamp_us,device,event,state,key_code,modifier,buttons,dx,dy,scroll,tilt,lx,ly,rx,ry,lt,rt,lost\n");
+    }
+
+    events_stats_t stats = {0};
+    uint8_t        frame[EVENT_FRAME_MAX];
+    size_t         frame_length = 0;
+    bool           overflow     = false;  // Frame too long to be valid, skip until the next delimiter
+    bool           cr           = false;  // '\r' held back until the next byte is known
+    int            c;
+
+    while ((c = fgetc(in)) != EOF) {
+        if (translate && cr) {
+            cr = false;
+            if (c != '\n') {
+                // Not part of a translated line ending, the held back byte is data
+                if (frame_length < sizeof(frame)) {
+                    frame[frame_length++] = '\r';
+                } else {
+                    overflow = true;
+                }
+            }
+        }
+        if (translate && c == '\r') {
+            cr = true;
+            continue;
+        }
+
+        if (c == 0) {
+            if (overflow) {
+                stats.invalid++;
+            } else {
+                handle_frame(frame, frame_length, &stats);
+            }
+            frame_length = 0;
+            overflow     = false;
+        } else if (frame_length < sizeof(frame)) {
+            frame[frame_length++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    fprintf(stderr, "%llu events, %llu invalid frames, %llu lost\n", (unsigned long long)stats.frames,
+            (unsigned long long)stats.invalid, (unsigned long long)stats.lost);
+    return 0;
+}
@@ -0,0 +1,312 @@
+// hid_replay.c
+//
+// Replays a raw HID report capture (see capture_format.h) through the firmware parsers and
+// prints the decoded event stream, one event per line, so runs can be diffed against golden
+// output. Reports are decoded by the same hid_input component as on the badge.
+//
+// Usage: hid_replay [-r] [-q] [-n repeat] capture.bin
+//   -r         Real-time: honour the capture timestamps
+//   -q         Quiet: decode without printing events
+//   -n repeat  Replay the capture repeat times (flat-out throughput measurement)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "badge_hid_host.h"
+#include "capture_format.h"
+#include "hid_input.h"
+
+#define REPLAY_MAX_DEVICES 256
+#define REPLAY_EVENT_POOL  4
+
+typedef struct {
+    capture_device_info_t info;
+    hid_input_interface_t input;
+    int                   x_pos, y_pos;
+    int                   x_scroll, y_scroll;
+} replay_device_t;
+
+typedef struct {
+    uint64_t records;
+    uint64_t reports;
+    uint64_t events;
+    uint64_t lost;
+} replay_stats_t;
+
+static replay_device_t        devices[REPLAY_MAX_DEVICES];
+static hid_input_event_t      events[REPLAY_EVENT_POOL];
+static hid_input_subscriber_t subscribers[1];
+static hid_input_bus_t        bus;
+static bool                   quiet = false;
+static FILE*                  out   = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Reads a whole file into memory, so file I/O does not count towards throughput
+ */
+static uint8_t* load_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = size > 0 ? malloc(size) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "%s: failed to read\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *length = size;
+    return data;
+}
+
+static void print_key(const hid_input_event_t* event) {
+    fprintf(out, "%lld %u key %s 0x%02X mod 0x%02X\n", (long long)event->timestamp_us, event->device_id,
+            event->key.state == KEY_STATE_PRESSED ? "press" : "release", event->key.key_code, event->key.modifier);
+}
+
+static void print_mouse(const hid_input_event_t* event) {
+    replay_device_t*      device = &devices[event->device_id];
+    const mouse_report_t* rpt    = &event->mouse;
+
+    device->x_pos    += rpt->x_displacement;
+    device->y_pos    += rpt->y_displacement;
+    device->x_scroll += rpt->scroll;
+    device->y_scroll += rpt->tilt;
+
+    if (!quiet) {
+        fprintf(out, "%lld %u mouse buttons 0x%02X dx %d dy %d scroll %d tilt %d pos %d %d\n",
+                (long long)event->timestamp_us, event->device_id, rpt->buttons.val, rpt->x_displacement,
+                rpt->y_displacement, rpt->scroll, rpt->tilt, device->x_pos, device->y_pos);
+    }
+}
+
+static void print_gamepad(const hid_input_event_t* event) {
+    const gamepad_report_t* rpt = &event->gamepad.report;
+
+    if (event->gamepad.valid) {
+        fprintf(out, "%lld %u gamepad buttons 0x%05X lx %u ly %u rx %u ry %u lt %u rt %u\n",
+                (long long)event->timestamp_us, event->device_id, (unsigned)rpt->buttons.val, rpt->lx, rpt->ly,
+                rpt->rx, rpt->ry, rpt->lt, rpt->rt);
+    } else {
+        fprintf(out, "%lld %u short %u\n", (long long)event->timestamp_us, event->device_id, event->raw_length);
+    }
+}
+
+static void print_consumer(const hid_input_event_t* event) {
+    fprintf(out, "%lld %u consumer %s 0x%04X\n", (long long)event->timestamp_us, event->device_id,
+            event->consumer.state == KEY_STATE_PRESSED ? "press" : "release", event->consumer.usage);
+}
+
+/**
+ * @brief Input bus subscriber, prints the events decoded by the firmware code
+ */
+static void replay_event(const hid_input_event_t* event, void* arg) {
+    replay_stats_t* stats = (replay_stats_t*)arg;
+
+    stats->events++;
+    if (event->type == HID_INPUT_EVENT_MOUSE) {
+        // Positions are tracked even when quiet
+        print_mouse(event);
+        return;
+    }
+    if (quiet) {
+        return;
+    }
+
+    switch (event->type) {
+        case HID_INPUT_EVENT_KEY:
+            print_key(event);
+            break;
+        case HID_INPUT_EVENT_GAMEPAD:
+            print_gamepad(event);
+            break;
+        case HID_INPUT_EVENT_CONSUMER:
+            print_consumer(event);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Handles one capture record
+ */
+static void replay_record(const capture_record_header_t* header, const uint8_t* payload, replay_stats_t* stats) {
+    replay_device_t* device = &devices[header->device_id];
+
+    stats->records++;
+
+    switch (header->type) {
+        case CAPTURE_RECORD_DEVICE:
+            // Slots are reused after a disconnect, a device record starts a new device
+            memset(device, 0, sizeof(*device));
+            if (header->length >= sizeof(capture_device_info_t)) {
+                memcpy(&device->info, payload, sizeof(capture_device_info_t));
+            }
+            hid_input_interface_init(&device->input, header->device_id, device->info.sub_class, device->info.protocol,
+                                     NULL, 0);
+            if (!quiet) {
+                fprintf(out, "%lld %u connect %04X:%04X interface %u subclass %u protocol %u\n",
+                        (long long)header->timestamp_us, header->device_id, device->info.vid, device->info.pid,
+                        device->info.interface, device->info.sub_class, device->info.protocol);
+            }
+            break;
+        case CAPTURE_RECORD_DESCRIPTOR:
+            hid_input_interface_init(&device->input, header->device_id, device->info.sub_class, device->info.protocol,
+                                     payload, header->length);
+            break;
+        case CAPTURE_RECORD_GAP: {
+            uint32_t lost = 0;
+            memcpy(&lost, payload, header->length < sizeof(lost) ? header->length : sizeof(lost));
+            stats->lost += lost;
+            if (!quiet) {
+                fprintf(out, "%lld %u gap %u\n", (long long)header->timestamp_us, header->device_id, lost);
+            }
+            break;
+        }
+        case CAPTURE_RECORD_REPORT:
+            stats->reports++;
+            hid_input_interface_report(&device->input, &bus, payload, header->length, header->timestamp_us);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Replays all records of a capture once
+ *
+ * Device state is not reset, every device starts with a device record that clears it.
+ *
+ * @return true on success, false when the capture is malformed
+ */
+static bool replay(const uint8_t* data, size_t length, bool realtime, replay_stats_t* stats) {
+    size_t   offset   = sizeof(capture_file_header_t);
+    int64_t  first_us = -1;
+    uint64_t start_ns = now_ns();
+
+    while (offset < length) {
+        capture_record_header_t header;
+        if (length - offset < sizeof(header)) {
+            fprintf(stderr, "Truncated record header at offset %zu\n", offset);
+            return false;
+        }
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (length - offset < header.length) {
+            fprintf(stderr, "Truncated record payload at offset %zu\n", offset);
+            return false;
+        }
+
+        if (realtime) {
+            if (first_us < 0) {
+                first_us = header.timestamp_us;
+            }
+            uint64_t due_ns = start_ns + (uint64_t)(header.timestamp_us - first_us) * 1000;
+            uint64_t now    = now_ns();
+            if (due_ns > now) {
+                struct timespec delay = {.tv_sec = (due_ns - now) / 1000000000, .tv_nsec = (due_ns - now) % 1000000000};
+                nanosleep(&delay, NULL);
+            }
+        }
+
+        replay_record(&header, data + offset, stats);
+        offset += header.length;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool realtime = false;
+    long repeat   = 1;
+    int  opt;
+
+    while ((opt = getopt(argc, argv, "rqn:")) != -1) {
+        switch (opt) {
+            case 'r':
+                realtime = true;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'n':
+                repeat = strtol(optarg, NULL, 0);
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+
+    if (optind != argc - 1 || repeat <= 0) {
+        fprintf(stderr, "Usage: %s [-r] [-q] [-n repeat] capture.bin\n", argv[0]);
+        return 2;
+    }
+
+    size_t   length;
+    uint8_t* data = load_file(argv[optind], &length);
+    if (data == NULL) {
+        return 1;
+    }
+
+    capture_file_header_t file_header;
+    if (length < sizeof(file_header) || memcmp(data, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", argv[optind]);
+        free(data);
+        return 1;
+    }
+    memcpy(&file_header, data, sizeof(file_header));
+    if (file_header.version != CAPTURE_VERSION) {
+        fprintf(stderr, "%s: unsupported capture version %u\n", argv[optind], file_header.version);
+        free(data);
+        return 1;
+    }
+
+    out = stdout;
+
+    replay_stats_t stats = {0};
+
+    // Keyboard state events and gamepad changes carry nothing the key events and gamepad reports do not
+    hid_input_filter_t filter = HID_INPUT_FILTER_ANY;
+    filter.types              = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEY) | HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_MOUSE) |
+                   HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_GAMEPAD) | HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_CONSUMER);
+    hid_input_bus_init(&bus, events, REPLAY_EVENT_POOL, subscribers, 1);
+    hid_input_subscribe(&bus, &filter, replay_event, &stats);
+
+    uint64_t start = now_ns();
+    bool     ok    = true;
+    for (long i = 0; i < repeat && ok; i++) {
+        ok = replay(data, length, realtime, &stats);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    free(data);
+
+    double ns_per_report = stats.reports > 0 ? (double)elapsed / stats.reports : 0.0;
+    fprintf(stderr, "%llu records, %llu reports, %llu events, %llu lost in %.3f ms: %.1f ns/report, %.0f reports/s\n",
+            (unsigned long long)stats.records, (unsigned long long)stats.reports, (unsigned long long)stats.events,
+            (unsigned long long)stats.lost, elapsed / 1e6, ns_per_report,
+            ns_per_report > 0 ? 1e9 / ns_per_report : 0.0);
+
+    return ok ? 0 : 1;
+}
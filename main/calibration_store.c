@@ -0,0 +1,72 @@
+// calibration_store.c
+//
+// Persists gamepad calibrations in NVS, one blob per USB VID/PID.
+
+#include "calibration_store.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+// Constants
+static char const TAG[]       = "calibration";
+static char const NAMESPACE[] = "gamepad_cal";
+
+static void make_key(uint16_t vid, uint16_t pid, char* key, size_t size) {
+    snprintf(key, size, "%04x%04x", vid, pid);
+}
+
+/**
+ * @brief Loads the stored calibration of a gamepad model
+ *
+ * @param[in]  vid          USB vendor ID
+ * @param[in]  pid          USB product ID
+ * @param[out] calibration  Stored calibration
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND when the model was never calibrated, or another NVS error
+ */
+esp_err_t gamepad_calibration_load(uint16_t vid, uint16_t pid, gamepad_calibration_t* calibration) {
+    nvs_handle_t handle;
+    char         key[9];
+    size_t       size = sizeof(*calibration);
+
+    esp_err_t res = nvs_open(NAMESPACE, NVS_READONLY, &handle);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    make_key(vid, pid, key, sizeof(key));
+    res = nvs_get_blob(handle, key, calibration, &size);
+    if (res == ESP_OK && size != sizeof(*calibration)) {
+        ESP_LOGW(TAG, "Ignoring calibration %s with unexpected size %u", key, (unsigned)size);
+        res = ESP_ERR_INVALID_SIZE;
+    }
+    nvs_close(handle);
+
+    return res;
+}
+
+/**
+ * @brief Stores the calibration of a gamepad model
+ *
+ * @param[in] vid          USB vendor ID
+ * @param[in] pid          USB product ID
+ * @param[in] calibration  Calibration to store
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t gamepad_calibration_save(uint16_t vid, uint16_t pid, const gamepad_calibration_t* calibration) {
+    nvs_handle_t handle;
+    char         key[9];
+
+    esp_err_t res = nvs_open(NAMESPACE, NVS_READWRITE, &handle);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    make_key(vid, pid, key, sizeof(key));
+    res = nvs_set_blob(handle, key, calibration, sizeof(*calibration));
+    if (res == ESP_OK) {
+        res = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return res;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "gamepad_condition.h"
+
+esp_err_t gamepad_calibration_load(uint16_t vid, uint16_t pid, gamepad_calibration_t* calibration);
+
+esp_err_t gamepad_calibration_save(uint16_t vid, uint16_t pid, const gamepad_calibration_t* calibration);
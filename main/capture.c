@@ -0,0 +1,285 @@
+// capture.c
+//
+// Capture of raw HID reports to a file on the internal FAT partition.
+// Records are appended to the active one of two RAM buffers under a spinlock; a low priority
+// writer task swaps the buffers and writes the filled one to flash, so no file I/O ever
+// happens on the USB callback path. When both buffers are busy records are dropped and a
+// gap record with the number of lost records is written once space is available again.
+
+#include "capture.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#define CAPTURE_MAX_FILES 1000
+
+// Constants
+static char const TAG[] = "capture";
+
+// Global variables
+static portMUX_TYPE buffer_lock        = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t*     buffers[2]         = {NULL, NULL};
+static size_t       fill[2]            = {0, 0};
+static int          active             = 0;
+static int          pending            = -1;  // Buffer handed to the writer task, -1 when none
+static uint32_t     lost               = 0;   // Records dropped since the last gap record
+static uint32_t     lost_total         = 0;
+static TaskHandle_t writer_task_handle = NULL;
+static FILE*        capture_file       = NULL;
+
+/**
+ * @brief Hands the active buffer to the writer task, must be called with buffer_lock held
+ *
+ * @return true  The active buffer was swapped
+ * @return false The writer task is still busy with the other buffer
+ */
+static bool swap_buffers_locked(void) {
+    if (pending >= 0) {
+        return false;
+    }
+
+    pending       = active;
+    active       ^= 1;
+    fill[active]  = 0;
+    return true;
+}
+
+/**
+ * @brief Copies a record header and payload into the active buffer, must be called with buffer_lock held
+ */
+static void append_locked(const capture_record_header_t* header, const uint8_t* payload) {
+    uint8_t* dst = buffers[active] + fill[active];
+    memcpy(dst, header, sizeof(*header));
+    memcpy(dst + sizeof(*header), payload, header->length);
+    fill[active] += sizeof(*header) + header->length;
+}
+
+/**
+ * @brief Appends a record, dropping it when both buffers are full
+ *
+ * @param[in] header   Record header, header->length bytes of payload follow
+ * @param[in] payload  Record payload
+ */
+static void capture_append(const capture_record_header_t* header, const uint8_t* payload) {
+    if (writer_task_handle == NULL) {
+        return;
+    }
+
+    size_t needed = sizeof(*header) + header->length;
+    if (lost > 0) {
+        needed += sizeof(capture_record_header_t) + sizeof(uint32_t);
+    }
+
+    bool notify = false;
+
+    taskENTER_CRITICAL(&buffer_lock);
+    if (fill[active] + needed > CONFIG_HID_CAPTURE_BUFFER_SIZE) {
+        notify = swap_buffers_locked();
+    }
+
+    if (fill[active] + needed > CONFIG_HID_CAPTURE_BUFFER_SIZE) {
+        lost++;
+        lost_total++;
+    } else {
+        if (lost > 0) {
+            const capture_record_header_t gap = {
+                .length       = sizeof(uint32_t),
+                .type         = CAPTURE_RECORD_GAP,
+                .timestamp_us = header->timestamp_us,
+            };
+            append_locked(&gap, (const uint8_t*)&lost);
+            lost = 0;
+        }
+        append_locked(header, payload);
+    }
+    taskEXIT_CRITICAL(&buffer_lock);
+
+    if (notify) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+/**
+ * @brief Records a raw input report
+ *
+ * Called from the HID interface callback, only copies the report into RAM.
+ *
+ * @param[in] device_id     Slot of the device in the device table
+ * @param[in] report_id     Report ID, 0 for devices without report IDs
+ * @param[in] timestamp_us  Arrival time of the report
+ * @param[in] data          Raw report data
+ * @param[in] length        Length of the report in bytes
+ */
+void capture_report(uint8_t device_id, uint8_t report_id, int64_t timestamp_us, const uint8_t* data, size_t length) {
+    const capture_record_header_t header = {
+        .length       = length,
+        .type         = CAPTURE_RECORD_REPORT,
+        .device_id    = device_id,
+        .report_id    = report_id,
+        .timestamp_us = timestamp_us,
+    };
+    capture_append(&header, data);
+}
+
+/**
+ * @brief Records a newly connected device and its report descriptor
+ *
+ * @param[in] device_id    Slot of the device in the device table
+ * @param[in] info         Device identification
+ * @param[in] desc         Report descriptor, may be NULL
+ * @param[in] desc_length  Length of the report descriptor in bytes
+ */
+void capture_device(uint8_t device_id, const capture_device_info_t* info, const uint8_t* desc, size_t desc_length) {
+    int64_t now = esp_timer_get_time();
+
+    const capture_record_header_t header = {
+        .length       = sizeof(*info),
+        .type         = CAPTURE_RECORD_DEVICE,
+        .device_id    = device_id,
+        .timestamp_us = now,
+    };
+    capture_append(&header, (const uint8_t*)info);
+
+    if (desc != NULL && desc_length > 0 && desc_length <= CAPTURE_PAYLOAD_MAX) {
+        const capture_record_header_t desc_header = {
+            .length       = desc_length,
+            .type         = CAPTURE_RECORD_DESCRIPTOR,
+            .device_id    = device_id,
+            .timestamp_us = now,
+        };
+        capture_append(&desc_header, desc);
+    }
+}
+
+/**
+ * @brief Writer task
+ *
+ * Writes a buffer as soon as it is full, and the partially filled active buffer every
+ * CONFIG_HID_CAPTURE_FLUSH_INTERVAL_MS so little is lost when the badge is unplugged.
+ *
+ * @param[in] arg  Not used
+ */
+static void capture_writer_task(void* arg) {
+    uint32_t lost_logged = 0;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_HID_CAPTURE_FLUSH_INTERVAL_MS));
+
+        bool flush = false;
+
+        taskENTER_CRITICAL(&buffer_lock);
+        if (pending < 0 && fill[active] > 0) {
+            swap_buffers_locked();
+            flush = true;
+        }
+        int    index  = pending;
+        size_t length = index >= 0 ? fill[index] : 0;
+        taskEXIT_CRITICAL(&buffer_lock);
+
+        if (index < 0) {
+            continue;
+        }
+
+        if (fwrite(buffers[index], 1, length, capture_file) != length) {
+            ESP_LOGE(TAG, "Failed to write %u bytes", (unsigned)length);
+        }
+
+        taskENTER_CRITICAL(&buffer_lock);
+        pending = -1;
+        taskEXIT_CRITICAL(&buffer_lock);
+
+        if (flush) {
+            fsync(fileno(capture_file));
+        }
+
+        if (lost_total != lost_logged) {
+            ESP_LOGW(TAG, "%u records lost, buffers full", (unsigned)(lost_total - lost_logged));
+            lost_logged = lost_total;
+        }
+    }
+}
+
+/**
+ * @brief Opens the first unused capture file name on the mounted partition
+ *
+ * @return Opened file, or NULL when no file could be created
+ */
+static FILE* capture_open_file(void) {
+    char        path[64];
+    struct stat st;
+
+    for (int i = 0; i < CAPTURE_MAX_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/hidcap%03d.bin", CONFIG_HID_CAPTURE_MOUNT_POINT, i);
+        if (stat(path, &st) == 0) {
+            continue;
+        }
+
+        FILE* file = fopen(path, "wb");
+        if (file != NULL) {
+            ESP_LOGI(TAG, "Capturing to %s", path);
+        }
+        return file;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Mounts the FAT partition, creates the capture file and starts the writer task
+ *
+ * @return ESP_OK on success, an error when the partition cannot be mounted or the file cannot be created
+ */
+esp_err_t capture_init(void) {
+    const esp_vfs_fat_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files              = 2,
+        .allocation_unit_size   = CONFIG_WL_SECTOR_SIZE,
+    };
+    wl_handle_t wl_handle = WL_INVALID_HANDLE;
+
+    esp_err_t res = esp_vfs_fat_spiflash_mount_rw_wl(CONFIG_HID_CAPTURE_MOUNT_POINT, CONFIG_HID_CAPTURE_PARTITION,
+                                                     &mount_config, &wl_handle);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount partition '%s': %s", CONFIG_HID_CAPTURE_PARTITION, esp_err_to_name(res));
+        return res;
+    }
+
+    buffers[0] = heap_caps_malloc(CONFIG_HID_CAPTURE_BUFFER_SIZE, MALLOC_CAP_DEFAULT);
+    buffers[1] = heap_caps_malloc(CONFIG_HID_CAPTURE_BUFFER_SIZE, MALLOC_CAP_DEFAULT);
+    if (buffers[0] == NULL || buffers[1] == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate 2x %u byte capture buffers", CONFIG_HID_CAPTURE_BUFFER_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    capture_file = capture_open_file();
+    if (capture_file == NULL) {
+        ESP_LOGE(TAG, "Failed to create capture file");
+        return ESP_FAIL;
+    }
+
+    // Buffers are written in one go, stdio buffering would only add a copy
+    setvbuf(capture_file, NULL, _IONBF, 0);
+
+    const capture_file_header_t file_header = {
+        .magic   = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+    };
+    fwrite(&file_header, sizeof(file_header), 1, capture_file);
+
+    BaseType_t task_created =
+        xTaskCreatePinnedToCore(capture_writer_task, "capture", CONFIG_HID_CAPTURE_TASK_STACK_SIZE, NULL,
+                                CONFIG_HID_CAPTURE_TASK_PRIORITY, &writer_task_handle, tskNO_AFFINITY);
+    if (task_created != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
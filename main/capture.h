@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "capture_format.h"
+#include "esp_err.h"
+
+esp_err_t capture_init(void);
+
+void capture_report(uint8_t device_id, uint8_t report_id, int64_t timestamp_us, const uint8_t* data, size_t length);
+
+void capture_device(uint8_t device_id, const capture_device_info_t* info, const uint8_t* desc, size_t desc_length);
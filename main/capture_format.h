@@ -0,0 +1,46 @@
+#pragma once
+
+// On-disk format of raw HID report captures, shared between the firmware and the host tools.
+//
+// A capture file starts with a capture_file_header_t followed by records. Every record is a
+// capture_record_header_t followed by length bytes of payload. All fields are little endian.
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC        "HIDCAP"
+#define CAPTURE_MAGIC_LENGTH 6
+#define CAPTURE_VERSION      1
+#define CAPTURE_PAYLOAD_MAX  1024  // Largest payload a record may carry (report descriptors)
+
+/**
+ * @brief Record types
+ */
+typedef enum {
+    CAPTURE_RECORD_REPORT     = 0,  // Payload: raw input report, as returned by the HID driver
+    CAPTURE_RECORD_DEVICE     = 1,  // Payload: capture_device_info_t, written on connect
+    CAPTURE_RECORD_DESCRIPTOR = 2,  // Payload: HID report descriptor, written on connect
+    CAPTURE_RECORD_GAP        = 3   // Payload: uint32_t number of records lost to full buffers
+} capture_record_type_t;
+
+typedef struct __attribute__((packed)) {
+    char     magic[CAPTURE_MAGIC_LENGTH];
+    uint16_t version;
+} capture_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t length;        // Payload length in bytes
+    uint8_t  type;          // capture_record_type_t
+    uint8_t  device_id;     // Slot of the device in the device table, reused after disconnect
+    uint8_t  report_id;     // First payload byte for devices that use report IDs, 0 otherwise
+    uint8_t  reserved;
+    int64_t  timestamp_us;  // esp_timer_get_time() when the record was produced
+} capture_record_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t vid;
+    uint16_t pid;
+    uint8_t  interface;
+    uint8_t  sub_class;
+    uint8_t  protocol;
+    uint8_t  reserved;
+} capture_device_info_t;
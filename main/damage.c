@@ -0,0 +1,479 @@
+// damage.c
+//
+// Dirty rectangle tracking for the PAX framebuffer.
+// Draw calls register the area they touched in user (oriented) coordinates, the tracker
+// converts those to raw framebuffer coordinates, merges them and blits only the damaged
+// parts of the screen.
+//
+// With CONFIG_HID_FRAMEBUFFER_DOUBLE the damaged regions are copied into a second (front)
+// buffer at the end of a frame and a blit task sends them to the display, while the render
+// task already draws the next frame into the PAX framebuffer. The copy waits for the previous
+// transfer to complete, so at most one frame is in flight.
+//
+// With CONFIG_HID_FRAMEBUFFER_STRIPS the framebuffer is only a strip of a few rows. The screen
+// is rendered band by band from a draw list and only the bands that intersect the damage are
+// rendered and sent.
+
+#include "damage.h"
+#include <string.h>
+#include "bsp/display.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// Constants
+static char const TAG[] = "damage";
+
+// Global variables
+static const pax_buf_t* damage_fb     = NULL;
+static int              fb_width      = 0;
+static int              fb_height     = 0;
+static uint8_t          fb_bpp        = 0;
+static size_t           fb_stride     = 0;
+static int              pixel_align   = 1;
+static damage_rect_t    rects[DAMAGE_MAX_RECTS];
+static size_t           rect_count    = 0;
+static bool             full_damage   = false;
+static uint8_t*         staging       = NULL;
+static size_t           staging_size  = 0;
+static uint64_t         bytes_blitted = 0;
+
+/**
+ * @brief Damage of one frame handed to the blit task
+ */
+typedef struct {
+    damage_rect_t    rects[DAMAGE_MAX_RECTS];
+    size_t           rect_count;
+    bool             full;
+    damage_done_cb_t done;
+    void*            done_arg;
+} blit_job_t;
+
+#if CONFIG_HID_FRAMEBUFFER_DOUBLE
+static uint8_t*          front_buffer     = NULL;  // NULL when running single buffered
+static blit_job_t        blit_job;
+static SemaphoreHandle_t blit_idle        = NULL;  // Given by the blit task when the job is done
+static TaskHandle_t      blit_task_handle = NULL;
+#endif
+
+static inline int rect_area(const damage_rect_t* r) {
+    return (r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static inline damage_rect_t rect_union(const damage_rect_t* a, const damage_rect_t* b) {
+    return (damage_rect_t){
+        .x0 = a->x0 < b->x0 ? a->x0 : b->x0,
+        .y0 = a->y0 < b->y0 ? a->y0 : b->y0,
+        .x1 = a->x1 > b->x1 ? a->x1 : b->x1,
+        .y1 = a->y1 > b->y1 ? a->y1 : b->y1,
+    };
+}
+
+static inline bool rect_intersects(const damage_rect_t* a, const damage_rect_t* b) {
+    return a->x0 < b->x1 && b->x0 < a->x1 && a->y0 < b->y1 && b->y0 < a->y1;
+}
+
+static inline bool rect_touches(const damage_rect_t* a, const damage_rect_t* b) {
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+/**
+ * @brief Converts a rectangle from user coordinates to raw framebuffer coordinates
+ *
+ * Follows the PAX orientation transforms, where width and height are the raw buffer dimensions.
+ *
+ * @param[in]  x, y, w, h  Rectangle in user (oriented) coordinates
+ * @param[out] out         Rectangle in raw framebuffer coordinates
+ * @return true  Converted
+ * @return false Orientation not handled, caller should damage the whole screen
+ */
+static bool orient_rect(int x, int y, int w, int h, damage_rect_t* out) {
+    switch (pax_buf_get_orientation(damage_fb)) {
+        case PAX_O_UPRIGHT:
+            *out = (damage_rect_t){x, y, x + w, y + h};
+            return true;
+        case PAX_O_ROT_CCW:
+            *out = (damage_rect_t){y, fb_height - (x + w), y + h, fb_height - x};
+            return true;
+        case PAX_O_ROT_HALF:
+            *out = (damage_rect_t){fb_width - (x + w), fb_height - (y + h), fb_width - x, fb_height - y};
+            return true;
+        case PAX_O_ROT_CW:
+            *out = (damage_rect_t){fb_width - (y + h), x, fb_width - y, x + w};
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Marks a rectangle in user coordinates as dirty
+ *
+ * Overlapping and touching rectangles are merged. When the list is full the new rectangle
+ * is merged into the one whose area grows the least.
+ *
+ * @param[in] x, y           Top left corner in user coordinates
+ * @param[in] width, height  Size of the rectangle
+ */
+void damage_add(int x, int y, int width, int height) {
+    if (full_damage || width <= 0 || height <= 0) {
+        return;
+    }
+
+    damage_rect_t r;
+    // Pad by a pixel to cover anti-aliased edges
+    if (!orient_rect(x - 1, y - 1, width + 2, height + 2, &r)) {
+        damage_add_all();
+        return;
+    }
+
+    // Clip to the framebuffer and align to whole bytes for sub-byte pixel formats
+    r.x0 = r.x0 < 0 ? 0 : r.x0 - (r.x0 % pixel_align);
+    r.y0 = r.y0 < 0 ? 0 : r.y0;
+    if (r.x1 % pixel_align) {
+        r.x1 += pixel_align - (r.x1 % pixel_align);
+    }
+    r.x1 = r.x1 > fb_width ? fb_width : r.x1;
+    r.y1 = r.y1 > fb_height ? fb_height : r.y1;
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) {
+        return;
+    }
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rect_count; i++) {
+            if (rect_touches(&rects[i], &r)) {
+                r        = rect_union(&rects[i], &r);
+                rects[i] = rects[--rect_count];
+                merged   = true;
+                break;
+            }
+        }
+
+        if (!merged && rect_count == DAMAGE_MAX_RECTS) {
+            size_t best      = 0;
+            int    best_cost = -1;
+            for (size_t i = 0; i < rect_count; i++) {
+                damage_rect_t u    = rect_union(&rects[i], &r);
+                int           cost = rect_area(&u) - rect_area(&rects[i]);
+                if (best_cost < 0 || cost < best_cost) {
+                    best      = i;
+                    best_cost = cost;
+                }
+            }
+            r           = rect_union(&rects[best], &r);
+            rects[best] = rects[--rect_count];
+            merged      = true;
+        }
+    }
+
+    rects[rect_count++] = r;
+}
+
+/**
+ * @brief Marks the whole screen as dirty
+ */
+void damage_add_all(void) {
+    full_damage = true;
+    rect_count  = 0;
+}
+
+/**
+ * @brief Checks whether anything was damaged since the last flush
+ */
+bool damage_pending(void) {
+    return full_damage || rect_count > 0;
+}
+
+/**
+ * @brief Number of damaged pixels since the last flush, the whole screen after damage_add_all
+ */
+uint32_t damage_pending_area(void) {
+    if (full_damage) {
+        return (uint32_t)(fb_width * fb_height);
+    }
+
+    uint32_t area = 0;
+    for (size_t i = 0; i < rect_count; i++) {
+        area += rect_area(&rects[i]);
+    }
+    return area;
+}
+
+static void blit_full(const uint8_t* pixels) {
+    bsp_display_blit(0, 0, fb_width, fb_height, pixels);
+}
+
+#if CONFIG_HID_PARTIAL_BLIT
+static void blit_rect(const uint8_t* pixels, const damage_rect_t* r) {
+    size_t row_bytes = (size_t)(r->x1 - r->x0) * fb_bpp / 8;
+    size_t x_offset  = (size_t)r->x0 * fb_bpp / 8;
+
+    // Full width rows are contiguous in the framebuffer and can be blitted in place
+    if (r->x0 == 0 && r->x1 == fb_width) {
+        bsp_display_blit(0, r->y0, fb_width, r->y1, pixels + r->y0 * fb_stride);
+        return;
+    }
+
+    int rows_per_chunk = staging_size / row_bytes;
+    for (int y = r->y0; y < r->y1; y += rows_per_chunk) {
+        int rows = r->y1 - y < rows_per_chunk ? r->y1 - y : rows_per_chunk;
+        for (int row = 0; row < rows; row++) {
+            memcpy(staging + row * row_bytes, pixels + (y + row) * fb_stride + x_offset, row_bytes);
+        }
+        bsp_display_blit(r->x0, y, r->x1, y + rows, staging);
+    }
+}
+#endif
+
+static void blit_job_run(const uint8_t* pixels, const blit_job_t* job) {
+#if CONFIG_HID_PARTIAL_BLIT
+    if (!job->full) {
+        for (size_t i = 0; i < job->rect_count; i++) {
+            blit_rect(pixels, &job->rects[i]);
+        }
+        return;
+    }
+#endif
+    blit_full(pixels);
+}
+
+static size_t job_bytes(const blit_job_t* job) {
+    if (job->full) {
+        return fb_stride * fb_height;
+    }
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < job->rect_count; i++) {
+        const damage_rect_t* r  = &job->rects[i];
+        bytes                  += (size_t)(r->x1 - r->x0) * fb_bpp / 8 * (r->y1 - r->y0);
+    }
+    return bytes;
+}
+
+#if CONFIG_HID_FRAMEBUFFER_DOUBLE
+/**
+ * @brief Blit task, sends the front buffer regions of one frame at a time
+ *
+ * @param[in] arg  Not used
+ */
+static void blit_task(void* arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        blit_job_run(front_buffer, &blit_job);
+        if (blit_job.done != NULL) {
+            blit_job.done(esp_timer_get_time(), blit_job.done_arg);
+        }
+        xSemaphoreGive(blit_idle);
+    }
+}
+
+static void copy_to_front(const uint8_t* pixels, const blit_job_t* job) {
+    if (job->full) {
+        memcpy(front_buffer, pixels, fb_stride * fb_height);
+        return;
+    }
+
+    for (size_t i = 0; i < job->rect_count; i++) {
+        const damage_rect_t* r         = &job->rects[i];
+        size_t               row_bytes = (size_t)(r->x1 - r->x0) * fb_bpp / 8;
+        size_t               offset    = r->y0 * fb_stride + (size_t)r->x0 * fb_bpp / 8;
+
+        for (int y = r->y0; y < r->y1; y++, offset += fb_stride) {
+            memcpy(front_buffer + offset, pixels + offset, row_bytes);
+        }
+    }
+}
+
+/**
+ * @brief Allocates the front buffer and starts the blit task
+ *
+ * @return true when double buffering is available, false to continue single buffered
+ */
+static bool start_double_buffer(void) {
+    size_t size = fb_stride * fb_height;
+
+    front_buffer = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    blit_idle    = xSemaphoreCreateBinary();
+    if (front_buffer == NULL || blit_idle == NULL) {
+        ESP_LOGW(TAG, "No memory for a %u byte front buffer, using a single buffer", (unsigned)size);
+        heap_caps_free(front_buffer);
+        front_buffer = NULL;
+        return false;
+    }
+    xSemaphoreGive(blit_idle);
+
+    if (xTaskCreate(blit_task, "blit", CONFIG_HID_BLIT_TASK_STACK_SIZE, NULL, CONFIG_HID_RENDER_TASK_PRIORITY,
+                    &blit_task_handle) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create blit task, using a single buffer");
+        heap_caps_free(front_buffer);
+        front_buffer = NULL;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Double buffered, %u byte front buffer", (unsigned)size);
+    return true;
+}
+#endif
+
+/**
+ * @brief Initializes the damage tracker
+ *
+ * Starts the blit task when double buffering is configured and memory allows it.
+ *
+ * @param[in] fb              Framebuffer that is drawn into, one strip with CONFIG_HID_FRAMEBUFFER_STRIPS
+ * @param[in] width           Raw display width in pixels
+ * @param[in] height          Raw display height in pixels
+ * @param[in] bits_per_pixel  Bits per pixel of the framebuffer
+ * @return ESP_OK on success, ESP_ERR_NO_MEM when the staging buffer cannot be allocated
+ */
+esp_err_t damage_init(const pax_buf_t* fb, size_t width, size_t height, uint8_t bits_per_pixel) {
+    damage_fb   = fb;
+    fb_width    = width;
+    fb_height   = height;
+    fb_bpp      = bits_per_pixel;
+    fb_stride   = (width * bits_per_pixel + 7) / 8;
+    pixel_align = bits_per_pixel < 8 ? 8 / bits_per_pixel : 1;
+    rect_count  = 0;
+    full_damage = true;
+
+#if CONFIG_HID_PARTIAL_BLIT
+    // The staging buffer must at least hold one full raw row
+    staging_size = CONFIG_HID_DAMAGE_STAGING_SIZE > fb_stride ? CONFIG_HID_DAMAGE_STAGING_SIZE : fb_stride;
+    staging      = heap_caps_malloc(staging_size, MALLOC_CAP_DEFAULT);
+    if (staging == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte staging buffer", (unsigned)staging_size);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+#if CONFIG_HID_FRAMEBUFFER_DOUBLE
+    start_double_buffer();
+#endif
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Sends all damaged regions to the display and resets the tracker
+ *
+ * Falls back to a single full screen blit when the damaged area covers most of the screen.
+ * Single buffered the blit is done before returning; double buffered the regions are copied
+ * to the front buffer and sent by the blit task, after waiting for the previous frame.
+ *
+ * @param[in] done      Called with the completion time once the frame reached the display, may be NULL
+ * @param[in] done_arg  Passed to done
+ */
+void damage_flush(damage_done_cb_t done, void* done_arg) {
+    if (!damage_pending()) {
+        return;
+    }
+
+    blit_job_t job = {.full = full_damage, .done = done, .done_arg = done_arg};
+
+#if CONFIG_HID_PARTIAL_BLIT
+    int area = 0;
+    for (size_t i = 0; i < rect_count; i++) {
+        area += rect_area(&rects[i]);
+    }
+
+    if (area * 4 > fb_width * fb_height * 3) {
+        job.full = true;
+    }
+    if (!job.full) {
+        memcpy(job.rects, rects, rect_count * sizeof(rects[0]));
+        job.rect_count = rect_count;
+    }
+#else
+    job.full = true;
+#endif
+
+    full_damage    = false;
+    rect_count     = 0;
+    bytes_blitted += job_bytes(&job);
+
+#if CONFIG_HID_FRAMEBUFFER_DOUBLE
+    if (front_buffer != NULL) {
+        xSemaphoreTake(blit_idle, portMAX_DELAY);
+        copy_to_front(pax_buf_get_pixels(damage_fb), &job);
+        blit_job = job;
+        xTaskNotifyGive(blit_task_handle);
+        return;
+    }
+#endif
+
+    blit_job_run(pax_buf_get_pixels(damage_fb), &job);
+    if (done != NULL) {
+        done(esp_timer_get_time(), done_arg);
+    }
+}
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+static bool band_damaged(const damage_rect_t* band) {
+    if (full_damage) {
+        return true;
+    }
+    for (size_t i = 0; i < rect_count; i++) {
+        if (rect_intersects(&rects[i], band)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Renders and sends every damaged band of the screen, then resets the tracker
+ *
+ * The screen is cut into bands of lines user rows, the size of the framebuffer passed to
+ * damage_init. Each band that intersects the damage is rendered by the callback and blitted
+ * at the raw position of the band, which depends on the orientation. The last band is moved
+ * up to end at the bottom of the screen so all bands have the size of the strip.
+ *
+ * @param[in] lines       Height of a band in user rows
+ * @param[in] render      Renders a band into the framebuffer
+ * @param[in] render_arg  Passed to render
+ * @param[in] done        Called with the completion time once all bands were sent, may be NULL
+ * @param[in] done_arg    Passed to done
+ */
+void damage_flush_strips(int lines, damage_strip_cb_t render, void* render_arg, damage_done_cb_t done,
+                         void* done_arg) {
+    if (!damage_pending()) {
+        return;
+    }
+
+    pax_orientation_t orientation = pax_buf_get_orientation(damage_fb);
+    bool              rotated     = orientation == PAX_O_ROT_CCW || orientation == PAX_O_ROT_CW;
+    int               user_width  = rotated ? fb_height : fb_width;
+    int               user_height = rotated ? fb_width : fb_height;
+
+    for (int y = 0; y < user_height; y += lines) {
+        int           band_y = y + lines > user_height ? user_height - lines : y;
+        damage_rect_t band;
+        if (!orient_rect(0, band_y, user_width, lines, &band) || !band_damaged(&band)) {
+            continue;
+        }
+
+        render(band_y, render_arg);
+        bsp_display_blit(band.x0, band.y0, band.x1, band.y1, pax_buf_get_pixels(damage_fb));
+        bytes_blitted += (size_t)(band.x1 - band.x0) * fb_bpp / 8 * (band.y1 - band.y0);
+    }
+
+    full_damage = false;
+    rect_count  = 0;
+    if (done != NULL) {
+        done(esp_timer_get_time(), done_arg);
+    }
+}
+#endif
+
+/**
+ * @brief Returns the total number of bytes sent to the display
+ */
+uint64_t damage_get_bytes_blitted(void) {
+    return bytes_blitted;
+}
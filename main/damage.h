@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "pax_gfx.h"
+
+#define DAMAGE_MAX_RECTS 8
+
+/**
+ * @brief Dirty rectangle in raw framebuffer coordinates, end exclusive
+ */
+typedef struct {
+    int x0, y0;
+    int x1, y1;
+} damage_rect_t;
+
+/**
+ * @brief Called once the damage of a frame has been sent to the display
+ *
+ * Runs in the blit task when double buffered, in the caller of damage_flush otherwise.
+ */
+typedef void (*damage_done_cb_t)(int64_t blitted_us, void* arg);
+
+/**
+ * @brief Renders the band of user rows starting at y into the strip sized framebuffer
+ */
+typedef void (*damage_strip_cb_t)(int y, void* arg);
+
+esp_err_t damage_init(const pax_buf_t* fb, size_t width, size_t height, uint8_t bits_per_pixel);
+
+void damage_add(int x, int y, int width, int height);
+
+void damage_add_all(void);
+
+bool damage_pending(void);
+
+uint32_t damage_pending_area(void);
+
+void damage_flush(damage_done_cb_t done, void* done_arg);
+
+void damage_flush_strips(int lines, damage_strip_cb_t render, void* render_arg, damage_done_cb_t done,
+                         void* done_arg);
+
+uint64_t damage_get_bytes_blitted(void);
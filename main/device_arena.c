@@ -0,0 +1,113 @@
+// device_arena.c
+//
+// Per device arenas handed out from a fixed pool of equally sized blocks.
+// State that lives as long as a connection (report ring, descriptor copy) is bump allocated
+// from the arena of the device and released with it in one go, so hot-plugging peripherals
+// for weeks never touches the heap and cannot fragment it.
+
+#include "device_arena.h"
+#include <string.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/**
+ * @brief Sets up a pool on caller provided storage
+ *
+ * @param[in] pool         Pool
+ * @param[in] storage      block_count blocks of block_size bytes, aligned for any type
+ * @param[in] block_size   Size of one arena, a multiple of the maximum alignment
+ * @param[in] block_count  Number of arenas, at most DEVICE_ARENA_POOL_MAX
+ * @return false when the block size or count is not usable
+ */
+bool device_arena_pool_init(device_arena_pool_t* pool, void* storage, size_t block_size, size_t block_count) {
+    memset(pool, 0, sizeof(*pool));
+    if (block_count == 0 || block_count > DEVICE_ARENA_POOL_MAX || block_size == 0 || block_size % ARENA_ALIGN != 0) {
+        return false;
+    }
+
+    pool->storage     = storage;
+    pool->block_size  = block_size;
+    pool->block_count = block_count;
+    return true;
+}
+
+/**
+ * @brief Counts the blocks that are not held by a device
+ */
+size_t device_arena_pool_free(const device_arena_pool_t* pool) {
+    size_t count = 0;
+    for (size_t i = 0; i < pool->block_count; i++) {
+        if (!(pool->in_use & (1u << i))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Hands out a free block as an empty arena
+ *
+ * @param[in]  pool   Pool
+ * @param[out] arena  Arena of the device
+ * @return false when all blocks are held
+ */
+bool device_arena_acquire(device_arena_pool_t* pool, device_arena_t* arena) {
+    for (size_t i = 0; i < pool->block_count; i++) {
+        if (pool->in_use & (1u << i)) {
+            continue;
+        }
+
+        pool->in_use |= 1u << i;
+        arena->base   = pool->storage + i * pool->block_size;
+        arena->size   = pool->block_size;
+        arena->used   = 0;
+        arena->block  = i;
+
+        size_t blocks = pool->block_count - device_arena_pool_free(pool);
+        if (blocks > pool->peak_blocks) {
+            pool->peak_blocks = blocks;
+        }
+        return true;
+    }
+
+    memset(arena, 0, sizeof(*arena));
+    pool->exhausted++;
+    return false;
+}
+
+/**
+ * @brief Takes memory from an arena, only called by the owner of the arena
+ *
+ * @param[in] arena  Arena
+ * @param[in] size   Bytes needed, the memory is zero filled and aligned for any type
+ * @return Memory valid until the arena is released, NULL when it does not fit
+ */
+void* device_arena_alloc(device_arena_t* arena, size_t size) {
+    size_t aligned = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (arena->base == NULL || aligned < size || aligned > arena->size - arena->used) {
+        return NULL;
+    }
+
+    void* memory  = arena->base + arena->used;
+    arena->used  += aligned;
+    memset(memory, 0, size);
+    return memory;
+}
+
+/**
+ * @brief Returns the block of an arena to the pool, everything allocated from it is gone
+ *
+ * @param[in] pool   Pool the arena came from
+ * @param[in] arena  Arena, empty afterwards; releasing an empty arena does nothing
+ */
+void device_arena_release(device_arena_pool_t* pool, device_arena_t* arena) {
+    if (arena->base == NULL) {
+        return;
+    }
+
+    if (arena->used > pool->peak_used) {
+        pool->peak_used = arena->used;
+    }
+    pool->in_use &= ~(1u << arena->block);
+    memset(arena, 0, sizeof(*arena));
+}
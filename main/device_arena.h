@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEVICE_ARENA_POOL_MAX 32  // Blocks a pool can hold, one bit each in the in use mask
+
+/**
+ * @brief Connection lifetime storage of one device
+ *
+ * Carved front to back by device_arena_alloc() while the device is set up, there is no
+ * free of single allocations: everything goes back to the pool at once on disconnect.
+ */
+typedef struct {
+    uint8_t* base;   // NULL while no block is held
+    size_t   size;
+    size_t   used;
+    uint8_t  block;  // Index of the block in the pool
+} device_arena_t;
+
+/**
+ * @brief Fixed pool of equally sized arena blocks
+ *
+ * All blocks have the same size, so a released block always fits the next device and
+ * connect/disconnect cycles cannot fragment the pool. Not thread safe, the caller
+ * serializes device_arena_acquire() and device_arena_release().
+ */
+typedef struct {
+    uint8_t* storage;  // block_count blocks of block_size bytes
+    size_t   block_size;
+    size_t   block_count;
+    uint32_t in_use;       // One bit per block
+    size_t   peak_blocks;  // Most blocks held at the same time
+    size_t   peak_used;    // Most bytes a released arena had allocated
+    uint32_t exhausted;    // Acquires that found no free block
+} device_arena_pool_t;
+
+bool device_arena_pool_init(device_arena_pool_t* pool, void* storage, size_t block_size, size_t block_count);
+
+bool device_arena_acquire(device_arena_pool_t* pool, device_arena_t* arena);
+
+void* device_arena_alloc(device_arena_t* arena, size_t size);
+
+void device_arena_release(device_arena_pool_t* pool, device_arena_t* arena);
+
+size_t device_arena_pool_free(const device_arena_pool_t* pool);
@@ -0,0 +1,132 @@
+// draw_list.c
+//
+// Draw list for strip rendering, see draw_list.h. Only bounds, colors and text are stored;
+// the owner replays the operations with the graphics library of its choice.
+
+#include "draw_list.h"
+#include <string.h>
+
+/**
+ * @brief Initializes an empty draw list
+ *
+ * @param[in] list        List to initialize
+ * @param[in] ops         Storage for capacity operations
+ * @param[in] capacity    Number of operations the list holds
+ * @param[in] text        Storage for the text of text operations
+ * @param[in] text_size   Size of the text storage in bytes
+ * @param[in] background  Color of the empty screen
+ */
+void draw_list_init(draw_list_t* list, draw_op_t* ops, size_t capacity, char* text, size_t text_size,
+                    uint32_t background) {
+    list->ops        = ops;
+    list->capacity   = capacity;
+    list->text       = text;
+    list->text_size  = text_size;
+    list->background = background;
+    list->peak       = 0;
+    draw_list_reset(list);
+}
+
+/**
+ * @brief Empties the list, the screen it describes is the background only
+ */
+void draw_list_reset(draw_list_t* list) {
+    list->count     = 0;
+    list->text_used = 0;
+    list->overflow  = false;
+}
+
+static inline bool contains(int x, int y, int w, int h, const draw_op_t* op) {
+    return op->x >= x && op->y >= y && op->x + op->w <= x + w && op->y + op->h <= y + h;
+}
+
+static inline bool intersects(int x, int y, int w, int h, const draw_op_t* op) {
+    return op->x < x + w && x < op->x + op->w && op->y < y + h && y < op->y + op->h;
+}
+
+static draw_op_t* append(draw_list_t* list, draw_op_kind_t kind, uint32_t color, int x, int y, int w, int h) {
+    if (list->count == list->capacity) {
+        list->overflow = true;
+        return NULL;
+    }
+
+    draw_op_t* op = &list->ops[list->count++];
+    *op           = (draw_op_t){.kind = kind, .color = color, .x = x, .y = y, .w = w, .h = h};
+    if (list->count > list->peak) {
+        list->peak = list->count;
+    }
+    return op;
+}
+
+/**
+ * @brief Appends a filled rectangle
+ *
+ * Earlier operations entirely inside the rectangle are removed. A background colored
+ * rectangle that then covers nothing is not recorded at all.
+ *
+ * @param[in] list           List
+ * @param[in] color          Fill color
+ * @param[in] x, y           Top left corner
+ * @param[in] width, height  Size
+ */
+void draw_list_rect(draw_list_t* list, uint32_t color, int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    size_t kept    = 0;
+    bool   covered = false;
+    for (size_t i = 0; i < list->count; i++) {
+        if (contains(x, y, width, height, &list->ops[i])) {
+            continue;
+        }
+        covered          |= intersects(x, y, width, height, &list->ops[i]);
+        list->ops[kept++] = list->ops[i];
+    }
+    list->count = kept;
+
+    if (color != list->background || covered) {
+        append(list, DRAW_OP_RECT, color, x, y, width, height);
+    }
+}
+
+/**
+ * @brief Appends a filled circle
+ *
+ * @param[in] list    List
+ * @param[in] color   Fill color
+ * @param[in] x, y    Center
+ * @param[in] radius  Radius
+ */
+void draw_list_circle(draw_list_t* list, uint32_t color, int x, int y, int radius) {
+    if (radius > 0) {
+        append(list, DRAW_OP_CIRCLE, color, x - radius, y - radius, 2 * radius, 2 * radius);
+    }
+}
+
+/**
+ * @brief Appends a string, the text is copied into the text pool
+ *
+ * @param[in] list           List
+ * @param[in] color          Text color
+ * @param[in] x, y           Top left corner
+ * @param[in] width, height  Extent of the rendered text, used to cull and to drop it when painted over
+ * @param[in] text           Text to draw
+ */
+void draw_list_text(draw_list_t* list, uint32_t color, int x, int y, int width, int height, const char* text) {
+    size_t length = strlen(text) + 1;
+    if (length == 1 || width <= 0 || height <= 0) {
+        return;
+    }
+    if (list->text_used + length > list->text_size) {
+        list->overflow = true;
+        return;
+    }
+
+    draw_op_t* op = append(list, DRAW_OP_TEXT, color, x, y, width, height);
+    if (op != NULL) {
+        op->text = list->text_used;
+        memcpy(list->text + list->text_used, text, length);
+        list->text_used += length;
+    }
+}
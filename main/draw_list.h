@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    DRAW_OP_RECT = 0,  // Filled rectangle
+    DRAW_OP_CIRCLE,    // Filled circle inscribed in the bounds
+    DRAW_OP_TEXT,      // Text in the label font, top left at the bounds
+} draw_op_kind_t;
+
+/**
+ * @brief Recorded draw call, bounds in user (oriented) coordinates
+ */
+typedef struct {
+    uint8_t  kind;
+    uint32_t color;
+    int16_t  x, y;
+    int16_t  w, h;
+    uint16_t text;  // Offset of the text in the text pool, DRAW_OP_TEXT only
+} draw_op_t;
+
+/**
+ * @brief Replayable list of the draw calls that make up the screen
+ *
+ * Used instead of a framebuffer: draw calls are appended in order and replayed, clipped, into
+ * a strip buffer whenever part of the screen has to be sent to the display. Calls that a later
+ * rectangle completely paints over are dropped, so a screen that is redrawn in place keeps a
+ * short list. When the list or its text pool fills up it is marked as overflowed and the owner
+ * rebuilds it from scratch. Storage is provided by the caller.
+ */
+typedef struct {
+    draw_op_t* ops;
+    size_t     capacity;
+    size_t     count;
+    size_t     peak;  // Highest count since init
+    char*      text;
+    size_t     text_size;
+    size_t     text_used;
+    uint32_t   background;  // Color the strips are cleared to, rectangles of it over nothing are dropped
+    bool       overflow;
+} draw_list_t;
+
+void draw_list_init(draw_list_t* list, draw_op_t* ops, size_t capacity, char* text, size_t text_size,
+                    uint32_t background);
+
+void draw_list_reset(draw_list_t* list);
+
+void draw_list_rect(draw_list_t* list, uint32_t color, int x, int y, int width, int height);
+
+void draw_list_circle(draw_list_t* list, uint32_t color, int x, int y, int radius);
+
+void draw_list_text(draw_list_t* list, uint32_t color, int x, int y, int width, int height, const char* text);
+
+static inline const char* draw_list_op_text(const draw_list_t* list, const draw_op_t* op) {
+    return list->text + op->text;
+}
+
+static inline bool draw_op_in_rows(const draw_op_t* op, int y0, int y1) {
+    return op->y < y1 && y0 < op->y + op->h;
+}
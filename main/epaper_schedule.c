@@ -0,0 +1,88 @@
+// epaper_schedule.c
+//
+// Refresh scheduling for e-paper panels, where a refresh takes hundreds of milliseconds to
+// seconds. Changes are batched, refreshes are rate limited, small changes use a partial
+// refresh and a full refresh is forced regularly to clear the ghosting partial refreshes
+// leave behind.
+
+#include "epaper_schedule.h"
+
+/**
+ * @brief Initializes a schedule, the panel is assumed to have just been fully refreshed
+ *
+ * @param[in] schedule  Schedule to initialize
+ * @param[in] config    Refresh policy
+ * @param[in] now_us    Current time
+ */
+void epaper_schedule_init(epaper_schedule_t* schedule, const epaper_schedule_config_t* config, int64_t now_us) {
+    schedule->config          = *config;
+    schedule->changed_us      = -1;
+    schedule->last_refresh_us = now_us;
+    schedule->last_full_us    = now_us;
+    schedule->partial_count   = 0;
+}
+
+/**
+ * @brief Notes that the content to show changed
+ *
+ * @param[in] schedule  Schedule
+ * @param[in] now_us    Time of the change
+ */
+void epaper_schedule_changed(epaper_schedule_t* schedule, int64_t now_us) {
+    if (schedule->changed_us < 0) {
+        schedule->changed_us = now_us;
+    }
+}
+
+/**
+ * @brief Checks whether the panel should be refreshed now
+ *
+ * A refresh is due when content changed at least batch_us ago, or when partial refreshes
+ * have been left on the panel for full_interval_us. Never sooner than min_interval_us after
+ * the previous refresh.
+ *
+ * @param[in] schedule  Schedule
+ * @param[in] now_us    Current time
+ * @return true when the caller should draw and refresh
+ */
+bool epaper_schedule_due(const epaper_schedule_t* schedule, int64_t now_us) {
+    const epaper_schedule_config_t* config = &schedule->config;
+
+    if (now_us - schedule->last_refresh_us < config->min_interval_us) {
+        return false;
+    }
+    if (schedule->changed_us >= 0 && now_us - schedule->changed_us >= config->batch_us) {
+        return true;
+    }
+    return config->full_interval_us > 0 && schedule->partial_count > 0 &&
+           now_us - schedule->last_full_us >= config->full_interval_us;
+}
+
+/**
+ * @brief Chooses the kind of the refresh the caller is about to do and records it
+ *
+ * @param[in] schedule      Schedule
+ * @param[in] now_us        Start of the refresh
+ * @param[in] damaged_area  Pixels drawn since the previous refresh
+ * @return EPAPER_REFRESH_FULL for large changes, after full_every partial refreshes and for
+ *         the ghosting cleanup, EPAPER_REFRESH_PARTIAL otherwise
+ */
+epaper_refresh_t epaper_schedule_refresh(epaper_schedule_t* schedule, int64_t now_us, uint32_t damaged_area) {
+    const epaper_schedule_config_t* config = &schedule->config;
+
+    bool full = damaged_area > config->partial_max_area ||
+                (config->full_every > 0 && schedule->partial_count >= config->full_every) ||
+                (config->full_interval_us > 0 && schedule->partial_count > 0 &&
+                 now_us - schedule->last_full_us >= config->full_interval_us);
+
+    schedule->changed_us      = -1;
+    schedule->last_refresh_us = now_us;
+    if (full) {
+        schedule->last_full_us  = now_us;
+        schedule->partial_count = 0;
+        return EPAPER_REFRESH_FULL;
+    }
+
+    schedule->partial_count++;
+    return EPAPER_REFRESH_PARTIAL;
+}
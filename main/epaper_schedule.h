@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    EPAPER_REFRESH_PARTIAL = 0,  // Only the damaged regions
+    EPAPER_REFRESH_FULL          // Whole panel, clears ghosting
+} epaper_refresh_t;
+
+/**
+ * @brief E-paper refresh policy
+ */
+typedef struct {
+    uint32_t batch_us;          // Delay after the first change, changes within it share a refresh
+    uint32_t min_interval_us;   // Minimum time between the starts of two refreshes
+    uint32_t partial_max_area;  // Largest damaged area (pixels) refreshed partially
+    uint32_t full_every;        // Partial refreshes before the next one is full, 0 never forces one
+    uint32_t full_interval_us;  // Full refresh when partial refreshes are older than this, 0 disables
+} epaper_schedule_config_t;
+
+/**
+ * @brief Decides when the panel is refreshed and how
+ *
+ * Input changes only mark the schedule; the render task asks whether a refresh is due and
+ * draws the newest state then, so a burst of reports costs a single refresh.
+ */
+typedef struct {
+    epaper_schedule_config_t config;
+    int64_t                  changed_us;       // First change since the last refresh, -1 when none
+    int64_t                  last_refresh_us;  // Start of the last refresh
+    int64_t                  last_full_us;     // Start of the last full refresh
+    uint32_t                 partial_count;    // Partial refreshes since the last full one
+} epaper_schedule_t;
+
+void epaper_schedule_init(epaper_schedule_t* schedule, const epaper_schedule_config_t* config, int64_t now_us);
+
+void epaper_schedule_changed(epaper_schedule_t* schedule, int64_t now_us);
+
+bool epaper_schedule_due(const epaper_schedule_t* schedule, int64_t now_us);
+
+epaper_refresh_t epaper_schedule_refresh(epaper_schedule_t* schedule, int64_t now_us, uint32_t damaged_area);
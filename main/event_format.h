@@ -0,0 +1,59 @@
+#pragma once
+
+// Wire format of the binary event stream, shared between the firmware and the host decoder.
+//
+// Every decoded event is sent as one frame: an event_record_header_t, the payload of its
+// type and a CRC-8 over both, COBS encoded and terminated by a zero byte. Frames contain no
+// other zero bytes, so a reader can start anywhere and resynchronise on the next zero. Every
+// batch of frames starts with an extra zero byte, so log lines printed between batches form
+// frames of their own that fail the length or CRC check and are skipped. All fields are
+// little endian.
+
+#include <stdint.h>
+
+#define EVENT_RECORD_MAX 32                     // Largest header + payload + CRC
+#define EVENT_FRAME_MAX  (EVENT_RECORD_MAX + 2)  // COBS overhead byte and delimiter
+#define EVENT_CRC8_POLY  0x07                    // CRC-8/SMBUS, initial value 0
+
+/**
+ * @brief Record types
+ */
+typedef enum {
+    EVENT_RECORD_KEY      = 1,  // Payload: event_key_t
+    EVENT_RECORD_MOUSE    = 2,  // Payload: event_mouse_t
+    EVENT_RECORD_GAMEPAD  = 3,  // Payload: event_gamepad_t
+    EVENT_RECORD_LOST     = 4,  // Payload: uint32_t number of events dropped because the buffer was full
+    EVENT_RECORD_CONSUMER = 5   // Payload: event_consumer_t
+} event_record_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  type;          // event_record_type_t
+    uint8_t  device_id;     // Slot of the device in the device table, reused after disconnect
+    uint32_t timestamp_us;  // Low 32 bits of the esp_timer_get_time() arrival of the report
+} event_record_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t state;  // enum key_state
+    uint8_t modifier;
+    uint8_t key_code;
+} event_key_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t buttons;
+    int16_t x_displacement;
+    int16_t y_displacement;
+    int8_t  scroll;
+    int8_t  tilt;
+} event_mouse_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  state;  // enum key_state, pressed or released
+    uint16_t usage;  // Consumer page usage, e.g. 0x00E9 volume up
+} event_consumer_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t buttons;  // gamepad_button_bit_t bits
+    uint8_t  lx, ly;
+    uint8_t  rx, ry;
+    uint8_t  lt, rt;
+} event_gamepad_t;
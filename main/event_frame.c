@@ -0,0 +1,138 @@
+// event_frame.c
+//
+// Encoding and decoding of event stream frames (see event_format.h).
+// Used by the firmware to produce the stream and by the host decoder to read it back.
+
+#include "event_frame.h"
+#include <string.h>
+
+/**
+ * @brief COBS encodes a buffer
+ *
+ * @param[in]  src     Data to encode, may contain zero bytes
+ * @param[in]  length  Length of the data, at most 254 bytes
+ * @param[out] dst     Encoded data, length + 1 bytes without zero bytes
+ * @return Length of the encoded data
+ */
+size_t cobs_encode(const uint8_t* src, size_t length, uint8_t* dst) {
+    size_t code_pos = 0;
+    size_t out      = 1;
+    dst[code_pos]   = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        if (src[i] == 0) {
+            code_pos      = out++;
+            dst[code_pos] = 1;
+        } else {
+            dst[out++] = src[i];
+            dst[code_pos]++;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Decodes a COBS encoded buffer
+ *
+ * @param[in]  src     Encoded data without the zero delimiter
+ * @param[in]  length  Length of the encoded data
+ * @param[out] dst     Decoded data
+ * @param[in]  size    Size of dst
+ * @return Length of the decoded data, 0 when the data is malformed or does not fit
+ */
+size_t cobs_decode(const uint8_t* src, size_t length, uint8_t* dst, size_t size) {
+    size_t out = 0;
+    size_t pos = 0;
+
+    while (pos < length) {
+        uint8_t code = src[pos++];
+        if (code == 0 || pos + code - 1 > length || out + code - 1 > size) {
+            return 0;
+        }
+
+        for (uint8_t i = 1; i < code; i++) {
+            if (src[pos] == 0) {
+                return 0;
+            }
+            dst[out++] = src[pos++];
+        }
+
+        // A full block (0xFF) is not followed by an implicit zero, neither is the last block
+        if (code < 0xFF && pos < length) {
+            if (out == size) {
+                return 0;
+            }
+            dst[out++] = 0;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief CRC-8 with polynomial EVENT_CRC8_POLY
+ */
+uint8_t event_crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (uint8_t)(crc << 1) ^ EVENT_CRC8_POLY : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Builds a complete frame for one record
+ *
+ * @param[in]  header   Record header
+ * @param[in]  payload  Record payload
+ * @param[in]  length   Length of the payload
+ * @param[out] frame    Destination, at least EVENT_FRAME_MAX bytes
+ * @return Length of the frame including the zero delimiter, 0 when the record is too large
+ */
+size_t event_frame_encode(const event_record_header_t* header, const void* payload, size_t length, uint8_t* frame) {
+    uint8_t record[EVENT_RECORD_MAX];
+    size_t  record_length = sizeof(*header) + length + 1;
+
+    if (record_length > sizeof(record)) {
+        return 0;
+    }
+
+    memcpy(record, header, sizeof(*header));
+    memcpy(record + sizeof(*header), payload, length);
+    record[record_length - 1] = event_crc8(record, record_length - 1);
+
+    size_t frame_length   = cobs_encode(record, record_length, frame);
+    frame[frame_length++] = 0;
+    return frame_length;
+}
+
+/**
+ * @brief Decodes and checks one frame
+ *
+ * @param[in]  frame           Frame without the zero delimiter
+ * @param[in]  length          Length of the frame
+ * @param[out] header          Record header
+ * @param[out] payload         Record payload, at least EVENT_RECORD_MAX bytes
+ * @param[out] payload_length  Length of the payload
+ * @return false when the frame is malformed or fails the CRC check
+ */
+bool event_frame_decode(const uint8_t* frame, size_t length, event_record_header_t* header, uint8_t* payload,
+                        size_t* payload_length) {
+    uint8_t record[EVENT_RECORD_MAX];
+    size_t  record_length = cobs_decode(frame, length, record, sizeof(record));
+
+    if (record_length < sizeof(*header) + 1 || event_crc8(record, record_length - 1) != record[record_length - 1]) {
+        return false;
+    }
+
+    memcpy(header, record, sizeof(*header));
+    *payload_length = record_length - sizeof(*header) - 1;
+    memcpy(payload, record + sizeof(*header), *payload_length);
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "event_format.h"
+
+size_t cobs_encode(const uint8_t* src, size_t length, uint8_t* dst);
+
+size_t cobs_decode(const uint8_t* src, size_t length, uint8_t* dst, size_t size);
+
+uint8_t event_crc8(const uint8_t* data, size_t length);
+
+size_t event_frame_encode(const event_record_header_t* header, const void* payload, size_t length, uint8_t* frame);
+
+bool event_frame_decode(const uint8_t* frame, size_t length, event_record_header_t* header, uint8_t* payload,
+                        size_t* payload_length);
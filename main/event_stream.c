@@ -0,0 +1,169 @@
+// event_stream.c
+//
+// Binary output of decoded events on the console (see event_format.h).
+// The input task encodes every event into a COBS frame and appends it to a byte ring buffer
+// without blocking; a low priority task drains the buffer to stdout in large writes. When
+// the buffer is full events are dropped and a lost record is sent once space is available.
+// Decode the stream on the host with host/tools/hid_events.
+
+#include "event_stream.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_frame.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+// Constants
+static char const TAG[] = "event_stream";
+
+// Global variables
+static RingbufHandle_t ring = NULL;
+static uint32_t        lost = 0;  // Events dropped since the last lost record, only used by the input task
+
+static bool send_frame(const event_record_header_t* header, const void* payload, size_t length) {
+    uint8_t frame[EVENT_FRAME_MAX];
+    size_t  frame_length = event_frame_encode(header, payload, length, frame);
+
+    return frame_length > 0 && xRingbufferSend(ring, frame, frame_length, 0) == pdTRUE;
+}
+
+/**
+ * @brief Queues one event, never blocks
+ *
+ * @param[in] type          event_record_type_t
+ * @param[in] device_id     Slot of the device the event came from
+ * @param[in] timestamp_us  Arrival of the report the event was decoded from
+ * @param[in] payload       Record payload
+ * @param[in] length        Length of the payload
+ */
+static void event_stream_send(uint8_t type, uint8_t device_id, int64_t timestamp_us, const void* payload,
+                              size_t length) {
+    if (ring == NULL) {
+        return;
+    }
+
+    const event_record_header_t header = {
+        .type         = type,
+        .device_id    = device_id,
+        .timestamp_us = (uint32_t)timestamp_us,
+    };
+
+    if (lost > 0) {
+        // The dropped events have no single arrival, the lost record is stamped when it is sent
+        const event_record_header_t lost_header = {
+            .type         = EVENT_RECORD_LOST,
+            .timestamp_us = (uint32_t)esp_timer_get_time(),
+        };
+        if (!send_frame(&lost_header, &lost, sizeof(lost))) {
+            lost++;
+            return;
+        }
+        lost = 0;
+    }
+
+    if (!send_frame(&header, payload, length)) {
+        lost++;
+    }
+}
+
+void event_stream_key(uint8_t device_id, int64_t timestamp_us, const key_event_t* event) {
+    const event_key_t payload = {
+        .state    = event->state,
+        .modifier = event->modifier,
+        .key_code = event->key_code,
+    };
+    event_stream_send(EVENT_RECORD_KEY, device_id, timestamp_us, &payload, sizeof(payload));
+}
+
+void event_stream_mouse(uint8_t device_id, int64_t timestamp_us, const mouse_report_t* report) {
+    const event_mouse_t payload = {
+        .buttons        = report->buttons.val,
+        .x_displacement = report->x_displacement,
+        .y_displacement = report->y_displacement,
+        .scroll         = report->scroll,
+        .tilt           = report->tilt,
+    };
+    event_stream_send(EVENT_RECORD_MOUSE, device_id, timestamp_us, &payload, sizeof(payload));
+}
+
+void event_stream_gamepad(uint8_t device_id, int64_t timestamp_us, const gamepad_report_t* report) {
+    const event_gamepad_t payload = {
+        .buttons = report->buttons.val,
+        .lx      = report->lx,
+        .ly      = report->ly,
+        .rx      = report->rx,
+        .ry      = report->ry,
+        .lt      = report->lt,
+        .rt      = report->rt,
+    };
+    event_stream_send(EVENT_RECORD_GAMEPAD, device_id, timestamp_us, &payload, sizeof(payload));
+}
+
+void event_stream_consumer(uint8_t device_id, int64_t timestamp_us, const consumer_event_t* event) {
+    const event_consumer_t payload = {
+        .state = event->state,
+        .usage = event->usage,
+    };
+    event_stream_send(EVENT_RECORD_CONSUMER, device_id, timestamp_us, &payload, sizeof(payload));
+}
+
+/**
+ * @brief Drain task
+ *
+ * Waits CONFIG_HID_EVENT_STREAM_FLUSH_INTERVAL_MS after every write so the events of one
+ * interval go out in a single write.
+ *
+ * @param[in] arg  Not used
+ */
+static void event_stream_task(void* arg) {
+    while (true) {
+        size_t   length = 0;
+        uint8_t* data   = xRingbufferReceiveUpTo(ring, &length, portMAX_DELAY, CONFIG_HID_EVENT_STREAM_BUFFER_SIZE);
+        if (data == NULL) {
+            continue;
+        }
+
+        // The leading delimiter ends any log text printed since the last write, so the first
+        // frame is not glued to it
+        flockfile(stdout);
+        fputc(0, stdout);
+        fwrite(data, 1, length, stdout);
+        vRingbufferReturnItem(ring, data);
+
+        // The buffer wraps, write the part at its start right away
+        data = xRingbufferReceiveUpTo(ring, &length, 0, CONFIG_HID_EVENT_STREAM_BUFFER_SIZE);
+        if (data != NULL) {
+            fwrite(data, 1, length, stdout);
+            vRingbufferReturnItem(ring, data);
+        }
+        fflush(stdout);
+        funlockfile(stdout);
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_HID_EVENT_STREAM_FLUSH_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief Creates the ring buffer and starts the drain task
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM when the buffer or task cannot be created
+ */
+esp_err_t event_stream_init(void) {
+    ring = xRingbufferCreate(CONFIG_HID_EVENT_STREAM_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+    if (ring == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte event buffer", CONFIG_HID_EVENT_STREAM_BUFFER_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t task_created = xTaskCreate(event_stream_task, "event_stream", CONFIG_HID_EVENT_STREAM_TASK_STACK_SIZE,
+                                          NULL, CONFIG_HID_EVENT_STREAM_TASK_PRIORITY, NULL);
+    if (task_created != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to create drain task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
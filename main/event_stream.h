@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include "badge_hid_host.h"
+#include "esp_err.h"
+
+esp_err_t event_stream_init(void);
+
+void event_stream_key(uint8_t device_id, int64_t timestamp_us, const key_event_t* event);
+
+void event_stream_mouse(uint8_t device_id, int64_t timestamp_us, const mouse_report_t* report);
+
+void event_stream_gamepad(uint8_t device_id, int64_t timestamp_us, const gamepad_report_t* report);
+
+void event_stream_consumer(uint8_t device_id, int64_t timestamp_us, const consumer_event_t* event);
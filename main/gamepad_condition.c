@@ -0,0 +1,292 @@
+// gamepad_condition.c
+//
+// Gamepad axis conditioning: calibration, One Euro smoothing and deadzones.
+// Everything runs in integer arithmetic, axes are carried as Q15 (+-32767 for sticks,
+// 0..32767 for triggers) so the pipeline stays cheap on targets without an FPU.
+
+#include "gamepad_condition.h"
+#include <string.h>
+
+#define FILTER_FRACTION_BITS 8         // Extra fraction bits of the filtered value
+#define FILTER_MAX_DT_US     1000000   // Longer pauses restart the filter instead of smoothing across them
+#define FILTER_MAX_CUTOFF    1000000   // Upper bound of the adaptive cutoff in mHz
+#define TWO_PI_Q16           411775    // 2 * pi in Q16
+
+static inline int32_t clamp32(int32_t value, int32_t min, int32_t max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+static inline bool is_trigger(size_t axis) {
+    return axis >= GAMEPAD_AXIS_LT;
+}
+
+/**
+ * @brief Integer square root, rounded down
+ *
+ * @param[in] value  Radicand
+ * @return floor(sqrt(value))
+ */
+uint32_t gamepad_isqrt(uint32_t value) {
+    uint32_t result = 0;
+    uint32_t bit    = 1u << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+static void update_gains(gamepad_condition_t* cond) {
+    const gamepad_calibration_t* cal = &cond->calibration;
+
+    for (size_t axis = 0; axis < GAMEPAD_AXES; axis++) {
+        int32_t low = is_trigger(axis) ? cal->min[axis] : cal->center[axis];
+        int32_t neg = cal->center[axis] - cal->min[axis];
+        int32_t pos = cal->max[axis] - low;
+
+        cond->gain_neg[axis] = neg > 0 ? ((int32_t)GAMEPAD_AXIS_MAX << 16) / neg : 0;
+        cond->gain_pos[axis] = pos > 0 ? ((int32_t)GAMEPAD_AXIS_MAX << 16) / pos : 0;
+    }
+}
+
+/**
+ * @brief Initializes the conditioning state of a gamepad with the full 0..255 range
+ *
+ * @param[in] cond    State to initialize
+ * @param[in] config  Deadzones and filter parameters
+ */
+void gamepad_condition_init(gamepad_condition_t* cond, const gamepad_condition_config_t* config) {
+    memset(cond, 0, sizeof(*cond));
+    cond->config  = *config;
+    cond->last_us = -1;
+
+    gamepad_calibration_t calibration;
+    memset(calibration.min, 0, sizeof(calibration.min));
+    memset(calibration.center, 128, sizeof(calibration.center));
+    memset(calibration.max, 255, sizeof(calibration.max));
+    gamepad_condition_set_calibration(cond, &calibration);
+}
+
+/**
+ * @brief Replaces the calibration, e.g. with one loaded from NVS
+ *
+ * @param[in] cond         Conditioning state
+ * @param[in] calibration  New per axis ranges
+ */
+void gamepad_condition_set_calibration(gamepad_condition_t* cond, const gamepad_calibration_t* calibration) {
+    cond->calibration = *calibration;
+    update_gains(cond);
+}
+
+static int32_t calibrate(const gamepad_condition_t* cond, size_t axis, uint8_t raw) {
+    int32_t offset = (int32_t)raw - (is_trigger(axis) ? cond->calibration.min[axis] : cond->calibration.center[axis]);
+    int32_t gain   = offset < 0 ? cond->gain_neg[axis] : cond->gain_pos[axis];
+    int32_t value  = (int32_t)(((int64_t)offset * gain) >> 16);
+
+    return clamp32(value, is_trigger(axis) ? 0 : -GAMEPAD_AXIS_MAX, GAMEPAD_AXIS_MAX);
+}
+
+// Smoothing factor of a first order low pass, alpha = w / (1 + w) with w = 2 pi fc dt
+static int32_t smoothing_alpha(uint32_t cutoff_mhz, uint32_t dt_us) {
+    int64_t w = (int64_t)cutoff_mhz * dt_us * TWO_PI_Q16 / 1000000000;
+    return (int32_t)((w << 16) / (65536 + w));
+}
+
+// One Euro filter: the cutoff rises with the speed of the axis, slow motion is smoothed
+// heavily while fast motion passes with little lag.
+static int32_t filter(const gamepad_condition_config_t* config, gamepad_filter_t* state, int32_t value,
+                      uint32_t dt_us) {
+    int32_t input = value << FILTER_FRACTION_BITS;
+    int64_t speed = (int64_t)(input - state->value) * 1000000 / dt_us >> FILTER_FRACTION_BITS;
+
+    state->speed += (int32_t)(((int64_t)smoothing_alpha(config->d_cutoff_mhz, dt_us) * (speed - state->speed)) >> 16);
+
+    uint32_t magnitude = state->speed < 0 ? -state->speed : state->speed;
+    uint64_t cutoff    = config->min_cutoff_mhz + (uint64_t)config->beta * magnitude / GAMEPAD_AXIS_MAX;
+    if (cutoff > FILTER_MAX_CUTOFF) {
+        cutoff = FILTER_MAX_CUTOFF;
+    }
+
+    int32_t alpha = smoothing_alpha(cutoff, dt_us);
+    state->value += (int32_t)(((int64_t)alpha * (input - state->value)) >> 16);
+
+    return (state->value + (1 << (FILTER_FRACTION_BITS - 1))) >> FILTER_FRACTION_BITS;
+}
+
+// Removes the deadzone at the low end and rescales the rest to the full range
+static int32_t rescale(int32_t magnitude, int32_t deadzone, int32_t outer) {
+    if (magnitude <= deadzone) {
+        return 0;
+    }
+    if (magnitude >= outer) {
+        return GAMEPAD_AXIS_MAX;
+    }
+    return (int32_t)((int64_t)(magnitude - deadzone) * GAMEPAD_AXIS_MAX / (outer - deadzone));
+}
+
+static int32_t axial_deadzone(int32_t value, int32_t deadzone) {
+    int32_t magnitude = rescale(value < 0 ? -value : value, deadzone, GAMEPAD_AXIS_MAX);
+    return value < 0 ? -magnitude : magnitude;
+}
+
+// Scales the stick vector so that its length is remapped from inner..outer to 0..full scale,
+// keeping the direction. Gives a circular response instead of the square one of axial deadzones.
+static void radial_deadzone(const gamepad_condition_config_t* config, int32_t* x, int32_t* y) {
+    uint32_t length = gamepad_isqrt((uint32_t)(*x * *x) + (uint32_t)(*y * *y));
+    int32_t  scaled = rescale(length, config->radial_inner, config->radial_outer);
+
+    if (scaled == 0) {
+        *x = 0;
+        *y = 0;
+        return;
+    }
+
+    *x = clamp32((int32_t)((int64_t)*x * scaled / length), -GAMEPAD_AXIS_MAX, GAMEPAD_AXIS_MAX);
+    *y = clamp32((int32_t)((int64_t)*y * scaled / length), -GAMEPAD_AXIS_MAX, GAMEPAD_AXIS_MAX);
+}
+
+static void observe(gamepad_condition_t* cond, const uint8_t* raw) {
+    gamepad_calibration_t* seen = &cond->observed;
+
+    if (!cond->center_taken) {
+        // The sticks are expected to rest when calibration starts
+        memcpy(seen->min, raw, GAMEPAD_AXES);
+        memcpy(seen->center, raw, GAMEPAD_AXES);
+        memcpy(seen->max, raw, GAMEPAD_AXES);
+        cond->center_taken = true;
+        return;
+    }
+
+    for (size_t axis = 0; axis < GAMEPAD_AXES; axis++) {
+        if (raw[axis] < seen->min[axis]) {
+            seen->min[axis] = raw[axis];
+        }
+        if (raw[axis] > seen->max[axis]) {
+            seen->max[axis] = raw[axis];
+        }
+    }
+}
+
+// Back to the 0..255 report encoding, rounded so that an uncalibrated axis passes unchanged
+static inline uint8_t to_stick(int32_t value) {
+    int32_t scale = value < 0 ? 128 : 127;
+    int32_t half  = value < 0 ? -GAMEPAD_AXIS_MAX / 2 : GAMEPAD_AXIS_MAX / 2;
+    return (uint8_t)clamp32(128 + (value * scale + half) / GAMEPAD_AXIS_MAX, 0, 255);
+}
+
+static inline uint8_t to_trigger(int32_t value) {
+    return (uint8_t)((value * 255 + GAMEPAD_AXIS_MAX / 2) / GAMEPAD_AXIS_MAX);
+}
+
+/**
+ * @brief Conditions the axes of a parsed report in place
+ *
+ * @param[in] cond          Conditioning state of the device
+ * @param[in] rpt           Parsed report, axes are replaced by conditioned values in the same 0..255 encoding
+ * @param[in] timestamp_us  Arrival time of the report
+ */
+void gamepad_condition_apply(gamepad_condition_t* cond, gamepad_report_t* rpt, int64_t timestamp_us) {
+    uint8_t raw[GAMEPAD_AXES] = {rpt->lx, rpt->ly, rpt->rx, rpt->ry, rpt->lt, rpt->rt};
+    int32_t axes[GAMEPAD_AXES];
+
+    if (cond->calibrating) {
+        observe(cond, raw);
+    }
+
+    int64_t dt_us   = timestamp_us - cond->last_us;
+    bool    restart = cond->last_us < 0 || dt_us <= 0 || dt_us > FILTER_MAX_DT_US;
+    cond->last_us   = timestamp_us;
+
+    for (size_t axis = 0; axis < GAMEPAD_AXES; axis++) {
+        axes[axis] = calibrate(cond, axis, raw[axis]);
+
+        if (cond->config.min_cutoff_mhz == 0) {
+            continue;
+        }
+        if (restart) {
+            cond->filters[axis].value = axes[axis] << FILTER_FRACTION_BITS;
+            cond->filters[axis].speed = 0;
+            continue;
+        }
+        axes[axis] = filter(&cond->config, &cond->filters[axis], axes[axis], (uint32_t)dt_us);
+    }
+
+    for (size_t axis = 0; axis < GAMEPAD_AXIS_LT; axis++) {
+        axes[axis] = axial_deadzone(axes[axis], cond->config.axial_deadzone);
+    }
+    radial_deadzone(&cond->config, &axes[GAMEPAD_AXIS_LX], &axes[GAMEPAD_AXIS_LY]);
+    radial_deadzone(&cond->config, &axes[GAMEPAD_AXIS_RX], &axes[GAMEPAD_AXIS_RY]);
+    axes[GAMEPAD_AXIS_LT] = rescale(axes[GAMEPAD_AXIS_LT], cond->config.trigger_deadzone, GAMEPAD_AXIS_MAX);
+    axes[GAMEPAD_AXIS_RT] = rescale(axes[GAMEPAD_AXIS_RT], cond->config.trigger_deadzone, GAMEPAD_AXIS_MAX);
+
+    rpt->lx = to_stick(axes[GAMEPAD_AXIS_LX]);
+    rpt->ly = to_stick(axes[GAMEPAD_AXIS_LY]);
+    rpt->rx = to_stick(axes[GAMEPAD_AXIS_RX]);
+    rpt->ry = to_stick(axes[GAMEPAD_AXIS_RY]);
+    rpt->lt = to_trigger(axes[GAMEPAD_AXIS_LT]);
+    rpt->rt = to_trigger(axes[GAMEPAD_AXIS_RT]);
+}
+
+/**
+ * @brief Starts recording axis ranges, the sticks must rest when the next report arrives
+ *
+ * @param[in] cond  Conditioning state of the device
+ */
+void gamepad_calibration_begin(gamepad_condition_t* cond) {
+    cond->calibrating  = true;
+    cond->center_taken = false;
+}
+
+/**
+ * @brief Stops recording and applies the recorded ranges of the axes that were moved
+ *
+ * Axes that moved less than GAMEPAD_CALIBRATION_MIN_RANGE in either direction (or that the
+ * device does not have) keep their previous calibration.
+ *
+ * @param[in]  cond         Conditioning state of the device
+ * @param[out] calibration  Resulting calibration of all axes, written only on success
+ * @return true when at least one axis was recalibrated
+ */
+bool gamepad_calibration_end(gamepad_condition_t* cond, gamepad_calibration_t* calibration) {
+    const gamepad_calibration_t* seen   = &cond->observed;
+    gamepad_calibration_t        result = cond->calibration;
+    bool                         any    = false;
+
+    if (!cond->calibrating) {
+        return false;
+    }
+    cond->calibrating = false;
+    if (!cond->center_taken) {
+        return false;
+    }
+
+    for (size_t axis = 0; axis < GAMEPAD_AXES; axis++) {
+        bool usable = is_trigger(axis)
+                          ? seen->max[axis] - seen->min[axis] >= GAMEPAD_CALIBRATION_MIN_RANGE
+                          : seen->center[axis] - seen->min[axis] >= GAMEPAD_CALIBRATION_MIN_RANGE &&
+                                seen->max[axis] - seen->center[axis] >= GAMEPAD_CALIBRATION_MIN_RANGE;
+        if (usable) {
+            result.min[axis]    = seen->min[axis];
+            result.center[axis] = seen->center[axis];
+            result.max[axis]    = seen->max[axis];
+            any                 = true;
+        }
+    }
+
+    if (!any) {
+        return false;
+    }
+
+    gamepad_condition_set_calibration(cond, &result);
+    *calibration = result;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+
+#define GAMEPAD_AXIS_MAX              32767  // Full scale of a conditioned axis (Q15)
+#define GAMEPAD_CALIBRATION_MIN_RANGE 16     // Smallest usable calibrated range per half axis
+
+/**
+ * @brief Per axis calibration in raw report units (0..255)
+ */
+typedef struct {
+    uint8_t min[GAMEPAD_AXES];
+    uint8_t center[GAMEPAD_AXES];  // Rest position, not used for the triggers
+    uint8_t max[GAMEPAD_AXES];
+} gamepad_calibration_t;
+
+/**
+ * @brief Conditioning parameters, deadzones are in Q15 (GAMEPAD_AXIS_MAX is full scale)
+ */
+typedef struct {
+    uint16_t axial_deadzone;    // Per stick axis, removes cross talk near the axes
+    uint16_t radial_inner;      // Stick deflections below this radius read as centered
+    uint16_t radial_outer;      // Stick deflections beyond this radius read as full scale
+    uint16_t trigger_deadzone;  // Trigger travel below this reads as released
+    uint32_t min_cutoff_mhz;    // One Euro filter cutoff at rest, 0 disables the filter
+    uint32_t beta;              // Cutoff increase in mHz per full scale per second of speed
+    uint32_t d_cutoff_mhz;      // Cutoff of the speed estimate
+} gamepad_condition_config_t;
+
+/**
+ * @brief One Euro filter state of one axis
+ */
+typedef struct {
+    int32_t value;  // Filtered value, Q15 << 8 for sub-unit precision
+    int32_t speed;  // Filtered speed, Q15 units per second
+} gamepad_filter_t;
+
+/**
+ * @brief Conditioning state of one gamepad
+ */
+typedef struct {
+    gamepad_condition_config_t config;
+    gamepad_calibration_t      calibration;
+    int32_t                    gain_neg[GAMEPAD_AXES];  // Q16 scale from raw units below center to Q15
+    int32_t                    gain_pos[GAMEPAD_AXES];  // Q16 scale from raw units above center to Q15
+    gamepad_filter_t           filters[GAMEPAD_AXES];
+    int64_t                    last_us;  // Timestamp of the previous report, -1 before the first
+    bool                       calibrating;
+    bool                       center_taken;
+    gamepad_calibration_t      observed;  // Ranges seen while calibrating
+} gamepad_condition_t;
+
+void gamepad_condition_init(gamepad_condition_t* cond, const gamepad_condition_config_t* config);
+
+void gamepad_condition_set_calibration(gamepad_condition_t* cond, const gamepad_calibration_t* calibration);
+
+void gamepad_condition_apply(gamepad_condition_t* cond, gamepad_report_t* rpt, int64_t timestamp_us);
+
+void gamepad_calibration_begin(gamepad_condition_t* cond);
+
+bool gamepad_calibration_end(gamepad_condition_t* cond, gamepad_calibration_t* calibration);
+
+uint32_t gamepad_isqrt(uint32_t value);
@@ -0,0 +1,192 @@
+// hid_device.c
+//
+// Fixed table of connected HID interfaces and their report rings.
+// Every slot takes an arena from a fixed pool at connect, so the state of a connection is
+// released in one piece at disconnect and hot-plugging never allocates from the heap.
+
+#include "hid_device.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#define PERCENT_TO_Q15(percent) ((percent) * GAMEPAD_AXIS_MAX / 100)
+
+_Static_assert((CONFIG_HID_REPORT_RING_DEPTH & (CONFIG_HID_REPORT_RING_DEPTH - 1)) == 0,
+               "CONFIG_HID_REPORT_RING_DEPTH must be a power of two");
+// device_arena_pool_init() cannot fail with these
+_Static_assert(CONFIG_HID_DEVICE_ARENA_SIZE % _Alignof(max_align_t) == 0,
+               "CONFIG_HID_DEVICE_ARENA_SIZE must be a multiple of the maximum alignment");
+_Static_assert(CONFIG_HID_MAX_DEVICES <= DEVICE_ARENA_POOL_MAX, "CONFIG_HID_MAX_DEVICES exceeds the arena pool");
+_Static_assert(CONFIG_HID_REPORT_RING_DEPTH * sizeof(report_ring_entry_t) <= CONFIG_HID_DEVICE_ARENA_SIZE,
+               "The report ring does not fit CONFIG_HID_DEVICE_ARENA_SIZE");
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_CLAIMED,  // Being set up by hid_device_alloc(), not visible to hid_device_get() yet
+    SLOT_ACTIVE,
+} slot_state_t;
+
+// Constants
+static char const TAG[] = "hid_device";
+
+// Global variables
+static portMUX_TYPE         device_lock = portMUX_INITIALIZER_UNLOCKED;
+static hid_device_t        devices[CONFIG_HID_MAX_DEVICES];
+static slot_state_t        slot_state[CONFIG_HID_MAX_DEVICES];
+static device_arena_pool_t arena_pool;
+static _Alignas(max_align_t) uint8_t arena_storage[CONFIG_HID_MAX_DEVICES * CONFIG_HID_DEVICE_ARENA_SIZE];
+
+static void release_slot(hid_device_t* device) {
+    taskENTER_CRITICAL(&device_lock);
+    device_arena_release(&arena_pool, &device->arena);
+    slot_state[device->id] = SLOT_FREE;
+    taskEXIT_CRITICAL(&device_lock);
+}
+
+/**
+ * @brief Claims a free slot for a newly connected interface
+ *
+ * The slot comes back claimed: its state is reset for the new connection, but hid_device_get()
+ * does not return it until the connect handler has finished setting it up and calls
+ * hid_device_publish().
+ *
+ * @param[in] handle  HID Device handle
+ * @param[in] params  HID Device parameters
+ * @return Pointer to the device, or NULL when all slots are in use
+ */
+hid_device_t* hid_device_alloc(hid_host_device_handle_t handle, const hid_host_dev_params_t* params) {
+    hid_device_t* device = NULL;
+
+    taskENTER_CRITICAL(&device_lock);
+    if (arena_pool.storage == NULL) {
+        device_arena_pool_init(&arena_pool, arena_storage, CONFIG_HID_DEVICE_ARENA_SIZE, CONFIG_HID_MAX_DEVICES);
+    }
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        if (slot_state[i] == SLOT_FREE && device_arena_acquire(&arena_pool, &devices[i].arena)) {
+            slot_state[i] = SLOT_CLAIMED;
+            device        = &devices[i];
+            device->id    = i;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&device_lock);
+
+    if (device == NULL) {
+        ESP_LOGE(TAG, "No free device slot, increase CONFIG_HID_MAX_DEVICES");
+        return NULL;
+    }
+
+    report_ring_entry_t* ring_entries =
+        device_arena_alloc(&device->arena, CONFIG_HID_REPORT_RING_DEPTH * sizeof(report_ring_entry_t));
+    if (ring_entries == NULL) {
+        ESP_LOGE(TAG, "Report ring does not fit the device arena, increase CONFIG_HID_DEVICE_ARENA_SIZE");
+        release_slot(device);
+        return NULL;
+    }
+
+    device->handle = handle;
+    device->params = *params;
+    device->vid    = 0;
+    device->pid    = 0;
+
+    device->descriptor        = NULL;
+    device->descriptor_length = 0;
+    device->first_event_seen  = false;
+    hid_input_interface_init(&device->input, device->id, params->sub_class, params->proto, NULL, 0);
+#if CONFIG_HID_EVENT_OUTPUT_TEXT
+    device->mouse_x      = 0;
+    device->mouse_y      = 0;
+    device->mouse_scroll = 0;
+    device->mouse_tilt   = 0;
+#endif
+#if CONFIG_HID_KEY_REPEAT
+    key_repeat_init(&device->repeat, CONFIG_HID_KEY_REPEAT_DELAY_MS, CONFIG_HID_KEY_REPEAT_RATE_HZ);
+#endif
+#if CONFIG_HID_GAMEPAD_CONDITIONING
+    const gamepad_condition_config_t gamepad_config = {
+        .axial_deadzone   = PERCENT_TO_Q15(CONFIG_HID_GAMEPAD_AXIAL_DEADZONE),
+        .radial_inner     = PERCENT_TO_Q15(CONFIG_HID_GAMEPAD_RADIAL_INNER),
+        .radial_outer     = PERCENT_TO_Q15(CONFIG_HID_GAMEPAD_RADIAL_OUTER),
+        .trigger_deadzone = PERCENT_TO_Q15(CONFIG_HID_GAMEPAD_TRIGGER_DEADZONE),
+        .min_cutoff_mhz   = CONFIG_HID_GAMEPAD_FILTER_MIN_CUTOFF_MHZ,
+        .beta             = CONFIG_HID_GAMEPAD_FILTER_BETA,
+        .d_cutoff_mhz     = CONFIG_HID_GAMEPAD_FILTER_DCUTOFF_MHZ,
+    };
+    gamepad_condition_init(&device->gamepad, &gamepad_config);
+#endif
+    atomic_store_explicit(&device->disconnected, false, memory_order_relaxed);
+    rate_meter_init(&device->rate);
+    report_ring_init(&device->ring, ring_entries, CONFIG_HID_REPORT_RING_DEPTH);
+
+    return device;
+}
+
+/**
+ * @brief Hands a claimed device to the input task, call once the connect setup is complete
+ *
+ * Leaving the critical section orders all setup of the device before the state change.
+ *
+ * @param[in] device  Device returned by hid_device_alloc()
+ */
+void hid_device_publish(hid_device_t* device) {
+    taskENTER_CRITICAL(&device_lock);
+    slot_state[device->id] = SLOT_ACTIVE;
+    taskEXIT_CRITICAL(&device_lock);
+}
+
+/**
+ * @brief Keeps a copy of the report descriptor for the lifetime of the connection
+ *
+ * @param[in] device  Device
+ * @param[in] desc    Report descriptor, owned by the HID driver
+ * @param[in] length  Length of the report descriptor
+ * @return false when the descriptor does not fit the arena of the device
+ */
+bool hid_device_keep_descriptor(hid_device_t* device, const uint8_t* desc, size_t length) {
+    if (desc == NULL || length == 0) {
+        return true;
+    }
+
+    uint8_t* copy = device_arena_alloc(&device->arena, length);
+    if (copy == NULL) {
+        return false;
+    }
+    memcpy(copy, desc, length);
+    device->descriptor        = copy;
+    device->descriptor_length = length;
+    return true;
+}
+
+/**
+ * @brief Releases the slot of a device together with everything in its arena
+ *
+ * @param[in] device  Device to release
+ */
+void hid_device_free(hid_device_t* device) {
+    ESP_LOGD(TAG, "Device %u used %u of %u arena bytes", device->id, (unsigned)device->arena.used,
+             (unsigned)device->arena.size);
+    release_slot(device);
+}
+
+/**
+ * @brief Returns the arena pool of the device slots, for statistics
+ */
+const device_arena_pool_t* hid_device_arena_pool(void) {
+    return &arena_pool;
+}
+
+/**
+ * @brief Returns the device in a slot
+ *
+ * @param[in] index  Slot index, below CONFIG_HID_MAX_DEVICES
+ * @return Pointer to the device, or NULL when the slot is free or still being set up
+ */
+hid_device_t* hid_device_get(size_t index) {
+    bool active;
+
+    taskENTER_CRITICAL(&device_lock);
+    active = slot_state[index] == SLOT_ACTIVE;
+    taskEXIT_CRITICAL(&device_lock);
+
+    return active ? &devices[index] : NULL;
+}
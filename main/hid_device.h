@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "device_arena.h"
+#include "gamepad_condition.h"
+#include "hid_input.h"
+#include "key_repeat.h"
+#include "rate_meter.h"
+#include "report_ring.h"
+#include "sdkconfig.h"
+#include "usb/hid_host.h"
+
+/**
+ * @brief Connected HID interface
+ *
+ * Allocated on connect, published to the input task once set up and handed to the HID driver
+ * as callback_arg. The interface callback fills the ring, the input task drains it and
+ * releases the slot once the device has disconnected and its ring is empty. Storage that is
+ * only needed while the device is connected comes from the arena of the slot and goes back
+ * with it.
+ */
+typedef struct {
+    uint8_t                  id;  // Index in the device table
+    hid_host_device_handle_t handle;
+    hid_host_dev_params_t    params;
+    uint16_t                 vid;
+    uint16_t                 pid;
+    atomic_bool              disconnected;
+    int64_t                  connected_us;      // Arrival of the CONNECTED event
+    bool                     first_event_seen;  // Time to the first decoded event was reported
+    hid_input_interface_t    input;    // Report decoding, set up at connect, only touched by the input task
+    key_repeat_t             repeat;   // Only touched by the input task
+    gamepad_condition_t      gamepad;  // Axis conditioning, only touched by the input task
+    rate_meter_t             rate;     // Only touched by the input task
+#if CONFIG_HID_EVENT_OUTPUT_TEXT
+    int32_t                  mouse_x;  // Mouse motion accumulated for the console, only touched by the input task
+    int32_t                  mouse_y;
+    int32_t                  mouse_scroll;
+    int32_t                  mouse_tilt;
+#endif
+    device_arena_t           arena;  // Connection lifetime storage: ring entries, report descriptor
+    report_ring_t            ring;
+    const uint8_t*           descriptor;  // Copy of the report descriptor, NULL when there is none
+    size_t                   descriptor_length;
+} hid_device_t;
+
+hid_device_t* hid_device_alloc(hid_host_device_handle_t handle, const hid_host_dev_params_t* params);
+
+void hid_device_publish(hid_device_t* device);
+
+bool hid_device_keep_descriptor(hid_device_t* device, const uint8_t* desc, size_t length);
+
+void hid_device_free(hid_device_t* device);
+
+hid_device_t* hid_device_get(size_t index);
+
+const device_arena_pool_t* hid_device_arena_pool(void);
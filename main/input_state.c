@@ -0,0 +1,150 @@
+// input_state.c
+//
+// Coalesced view state shared between the input task and the render task.
+// Publishers overwrite the state under a short critical section, the render task
+// copies it out once per frame. The decoded input itself lives in the input snapshot.
+
+#include "input_state.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static portMUX_TYPE  state_lock     = portMUX_INITIALIZER_UNLOCKED;
+static input_state_t state          = {0};
+static input_stats_t stats          = {0};
+static uint8_t       origin_device  = 0;  // Set by the input task before dispatching a report
+static int64_t       origin_arrival = 0;
+
+static void copy_raw(const uint8_t* raw, size_t raw_length) {
+    if (raw_length > INPUT_STATE_RAW_MAX) {
+        raw_length = INPUT_STATE_RAW_MAX;
+    }
+    memcpy(state.raw, raw, raw_length);
+    state.raw_length = raw_length;
+}
+
+static void set_origin(int64_t parsed_us) {
+    state.origin.device_id  = origin_device;
+    state.origin.arrival_us = origin_arrival;
+    state.origin.parsed_us  = parsed_us;
+}
+
+/**
+ * @brief Sets the report the following keyboard, mouse and gamepad publishes belong to
+ *
+ * Only called from the input task, right before a report is dispatched.
+ *
+ * @param[in] device_id   Slot of the device the report came from
+ * @param[in] arrival_us  Arrival time of the report in the interface callback
+ */
+void input_state_set_origin(uint8_t device_id, int64_t arrival_us) {
+    origin_device  = device_id;
+    origin_arrival = arrival_us;
+}
+
+/**
+ * @brief Publishes a status line (connect, disconnect, errors)
+ *
+ * @param[in] text  Null-terminated status text, truncated to INPUT_STATE_STATUS_MAX
+ */
+void input_state_publish_status(const char* text) {
+    taskENTER_CRITICAL(&state_lock);
+    strncpy(state.status, text, sizeof(state.status) - 1);
+    state.raw_length        = 0;
+    state.origin.arrival_us = 0;
+    state.view              = INPUT_VIEW_STATUS;
+    state.generation++;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+/**
+ * @brief Publishes the newest keyboard, mouse or gamepad report
+ *
+ * The decoded state of the report is already in the input snapshot, this only switches the
+ * view and keeps the raw bytes and the origin for the latency measurement.
+ *
+ * @param[in] view        View of the device class of the report
+ * @param[in] raw         Raw report bytes
+ * @param[in] raw_length  Length of the raw report
+ */
+void input_state_publish_report(input_view_t view, const uint8_t* raw, size_t raw_length) {
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&state_lock);
+    copy_raw(raw, raw_length);
+    set_origin(now);
+    state.view = view;
+    state.generation++;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+/**
+ * @brief Publishes the report rate statistics of a device
+ *
+ * Does not trigger a redraw on its own, the statistics are drawn with the next frame.
+ *
+ * @param[in] device_id  Slot of the device
+ * @param[in] rate       Statistics of the last complete window
+ */
+void input_state_publish_rate(uint8_t device_id, const rate_meter_stats_t* rate) {
+    if (device_id >= CONFIG_HID_MAX_DEVICES) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&state_lock);
+    state.devices[device_id].connected = true;
+    state.devices[device_id].rate      = *rate;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+/**
+ * @brief Removes the statistics of a disconnected device
+ *
+ * @param[in] device_id  Slot of the device
+ */
+void input_state_clear_device(uint8_t device_id) {
+    if (device_id >= CONFIG_HID_MAX_DEVICES) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&state_lock);
+    state.devices[device_id].connected = false;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+/**
+ * @brief Copies the current state if anything was published since last_generation
+ *
+ * @param[out] out              Destination for the state copy
+ * @param[in]  last_generation  Generation of the previously drawn state
+ * @return true  New state was copied into out
+ * @return false Nothing changed
+ */
+bool input_state_get_if_changed(input_state_t* out, uint32_t last_generation) {
+    bool changed = false;
+    taskENTER_CRITICAL(&state_lock);
+    if (state.generation != last_generation) {
+        *out    = state;
+        changed = true;
+    }
+    taskEXIT_CRITICAL(&state_lock);
+    return changed;
+}
+
+void input_state_count_report(void) {
+    taskENTER_CRITICAL(&state_lock);
+    stats.reports_received++;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+void input_state_count_frame(void) {
+    taskENTER_CRITICAL(&state_lock);
+    stats.frames_drawn++;
+    taskEXIT_CRITICAL(&state_lock);
+}
+
+void input_state_get_stats(input_stats_t* out) {
+    taskENTER_CRITICAL(&state_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&state_lock);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+#include "rate_meter.h"
+#include "sdkconfig.h"
+
+#define INPUT_STATE_RAW_MAX    64
+#define INPUT_STATE_STATUS_MAX 64
+
+/**
+ * @brief Which input view the renderer should show
+ *
+ * Mirrors the old behaviour where every callback cleared the screen and drew its own view:
+ * the most recently published source wins.
+ */
+typedef enum {
+    INPUT_VIEW_STATUS = 0,
+    INPUT_VIEW_KEYBOARD,
+    INPUT_VIEW_MOUSE,
+    INPUT_VIEW_GAMEPAD
+} input_view_t;
+
+/**
+ * @brief What the render task shows: the view, the newest report and the device statistics
+ *
+ * Written by the input task, read by the render task. Reports that arrive between two frames
+ * overwrite each other; only the newest one is drawn. The decoded keys, pointer and pads come
+ * from the input snapshot (hid_input_snapshot.h), read by the render task when the
+ * generation changed.
+ */
+typedef struct {
+    uint32_t     generation;  // Incremented on every publish
+    input_view_t view;
+
+    char status[INPUT_STATE_STATUS_MAX];
+
+    uint8_t raw[INPUT_STATE_RAW_MAX];  // Raw bytes of the most recent report
+    size_t  raw_length;
+
+    struct {
+        uint8_t device_id;
+        int64_t arrival_us;  // 0 for states not caused by a report (status)
+        int64_t parsed_us;
+    } origin;  // Report the state was published for, used for latency measurement
+
+    struct {
+        bool               connected;
+        rate_meter_stats_t rate;
+    } devices[CONFIG_HID_MAX_DEVICES];  // Updated without bumping the generation
+} input_state_t;
+
+/**
+ * @brief Input and render counters
+ */
+typedef struct {
+    uint32_t reports_received;
+    uint32_t frames_drawn;
+} input_stats_t;
+
+void input_state_set_origin(uint8_t device_id, int64_t arrival_us);
+
+void input_state_publish_status(const char* text);
+
+void input_state_publish_report(input_view_t view, const uint8_t* raw, size_t raw_length);
+
+void input_state_publish_rate(uint8_t device_id, const rate_meter_stats_t* rate);
+
+void input_state_clear_device(uint8_t device_id);
+
+bool input_state_get_if_changed(input_state_t* out, uint32_t last_generation);
+
+void input_state_count_report(void);
+
+void input_state_count_frame(void);
+
+void input_state_get_stats(input_stats_t* out);
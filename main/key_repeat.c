@@ -0,0 +1,70 @@
+// key_repeat.c
+//
+// Typematic key repeat.
+// Keyboards are put in idle rate 0 so they only report changes; repeats are generated here
+// from the press time instead of from idle reports.
+
+#include "key_repeat.h"
+#include <string.h>
+
+/**
+ * @brief Resets the repeat state of a keyboard
+ *
+ * @param[in] repeat    Repeat state
+ * @param[in] delay_ms  Time a key has to be held before it repeats
+ * @param[in] rate_hz   Repeats per second
+ */
+void key_repeat_init(key_repeat_t* repeat, uint32_t delay_ms, uint32_t rate_hz) {
+    memset(repeat, 0, sizeof(*repeat));
+    repeat->delay_us  = delay_ms * 1000;
+    repeat->period_us = rate_hz > 0 ? 1000000 / rate_hz : 1000000;
+}
+
+/**
+ * @brief Feeds a key event of the keyboard into its repeat state
+ *
+ * @param[in] repeat  Repeat state
+ * @param[in] event   Press or release event
+ * @param[in] now_us  Time of the event
+ */
+void key_repeat_update(key_repeat_t* repeat, const key_event_t* event, int64_t now_us) {
+    repeat->modifier = event->modifier;
+
+    if (event->key_code >= KEY_BITMAP_MODIFIERS) {
+        return;
+    }
+
+    if (event->state == KEY_STATE_PRESSED) {
+        repeat->key_code = event->key_code;
+        repeat->due_us   = now_us + repeat->delay_us;
+    } else if (event->state == KEY_STATE_RELEASED && event->key_code == repeat->key_code) {
+        repeat->key_code = 0;
+    }
+}
+
+/**
+ * @brief Produces the repeat event that is due, if any
+ *
+ * When polled late only one event is produced and the schedule restarts from now, so a
+ * stalled task does not cause a burst of repeats.
+ *
+ * @param[in]  repeat  Repeat state
+ * @param[in]  now_us  Current time
+ * @param[out] event   Repeat event
+ * @return true if event was written
+ */
+bool key_repeat_poll(key_repeat_t* repeat, int64_t now_us, key_event_t* event) {
+    if (!key_repeat_active(repeat) || now_us < repeat->due_us) {
+        return false;
+    }
+
+    repeat->due_us += repeat->period_us;
+    if (repeat->due_us <= now_us) {
+        repeat->due_us = now_us + repeat->period_us;
+    }
+
+    event->state    = KEY_STATE_REPEAT;
+    event->modifier = repeat->modifier;
+    event->key_code = repeat->key_code;
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "badge_hid_host.h"
+
+/**
+ * @brief Typematic repeat state of one keyboard
+ *
+ * Like a PC keyboard, only the most recently pressed key repeats. Releasing it stops the
+ * repeat, pressing another key takes over. Modifiers never repeat but are carried in the
+ * repeat events.
+ */
+typedef struct {
+    uint32_t delay_us;   // Press to first repeat
+    uint32_t period_us;  // Between repeats
+    uint8_t  key_code;   // Repeating key, 0 when idle
+    uint8_t  modifier;   // Modifier state of the last event
+    int64_t  due_us;     // Time of the next repeat event
+} key_repeat_t;
+
+void key_repeat_init(key_repeat_t* repeat, uint32_t delay_ms, uint32_t rate_hz);
+
+void key_repeat_update(key_repeat_t* repeat, const key_event_t* event, int64_t now_us);
+
+bool key_repeat_poll(key_repeat_t* repeat, int64_t now_us, key_event_t* event);
+
+static inline bool key_repeat_active(const key_repeat_t* repeat) {
+    return repeat->key_code != 0;
+}
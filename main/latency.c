@@ -0,0 +1,186 @@
+// latency.c
+//
+// End-to-end input latency histograms, per device and per stage.
+// Only reports that reach the screen are measured: the timestamps of the newest report in
+// every drawn frame are recorded once the frame has been blitted. Recording happens in a
+// single task (the render task, or the blit task when double buffered), so the histograms
+// need no locking; a dump from the render task may be off by the sample being recorded.
+
+#include "latency.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+// Global variables
+static latency_hist_t hists[CONFIG_HID_MAX_DEVICES][LATENCY_STAGE_COUNT];
+static atomic_bool    dump_requested = false;
+
+static const char* const stage_names[LATENCY_STAGE_COUNT] = {"parse", "draw", "blit", "total"};
+
+static inline size_t bucket_index(uint32_t value_us) {
+    if (value_us < LATENCY_LINEAR_BUCKETS) {
+        return value_us;
+    }
+
+    int    exponent = 31 - __builtin_clz(value_us);  // At least 3
+    size_t index    = LATENCY_LINEAR_BUCKETS + (exponent - 3) * LATENCY_SUB_BUCKETS +
+                   ((value_us >> (exponent - 2)) & (LATENCY_SUB_BUCKETS - 1));
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+static inline uint32_t bucket_upper_bound(size_t index) {
+    if (index < LATENCY_LINEAR_BUCKETS) {
+        return index;
+    }
+
+    int      exponent = (index - LATENCY_LINEAR_BUCKETS) / LATENCY_SUB_BUCKETS + 3;
+    uint32_t sub      = (index - LATENCY_LINEAR_BUCKETS) % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 2)) - 1;
+}
+
+/**
+ * @brief Adds a sample to a histogram
+ *
+ * @param[in] hist      Histogram
+ * @param[in] value_us  Latency in microseconds
+ */
+void latency_hist_add(latency_hist_t* hist, uint32_t value_us) {
+    hist->buckets[bucket_index(value_us)]++;
+    hist->count++;
+    if (value_us > hist->max_us) {
+        hist->max_us = value_us;
+    }
+}
+
+/**
+ * @brief Estimates a percentile from a histogram
+ *
+ * @param[in] hist      Histogram
+ * @param[in] permille  Percentile in 1/1000, e.g. 990 for p99
+ * @return Upper bound of the bucket holding the percentile (capped at the maximum), 0 when empty
+ */
+uint32_t latency_hist_percentile(const latency_hist_t* hist, uint32_t permille) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t target = ((uint64_t)hist->count * permille + 999) / 1000;
+    uint64_t seen   = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target && seen > 0) {
+            // The last bucket is open ended
+            uint32_t bound = i < LATENCY_BUCKETS - 1 ? bucket_upper_bound(i) : hist->max_us;
+            return bound < hist->max_us ? bound : hist->max_us;
+        }
+    }
+
+    return hist->max_us;
+}
+
+const char* latency_stage_name(latency_stage_t stage) {
+    return stage < LATENCY_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+static inline uint32_t elapsed_us(int64_t from, int64_t to) {
+    return to > from ? (uint32_t)(to - from) : 0;
+}
+
+/**
+ * @brief Records the stage timestamps of a report that reached the screen
+ *
+ * @param[in] device_id   Slot of the device the report came from
+ * @param[in] arrival_us  Report arrival in the interface callback
+ * @param[in] parsed_us   Report parsed and published by the input task
+ * @param[in] drawn_us    Frame drawn into the framebuffer
+ * @param[in] blitted_us  Frame sent to the display
+ */
+void latency_record(uint8_t device_id, int64_t arrival_us, int64_t parsed_us, int64_t drawn_us, int64_t blitted_us) {
+    if (device_id >= CONFIG_HID_MAX_DEVICES) {
+        return;
+    }
+
+    latency_hist_t* device_hists = hists[device_id];
+    latency_hist_add(&device_hists[LATENCY_STAGE_PARSE], elapsed_us(arrival_us, parsed_us));
+    latency_hist_add(&device_hists[LATENCY_STAGE_DRAW], elapsed_us(parsed_us, drawn_us));
+    latency_hist_add(&device_hists[LATENCY_STAGE_BLIT], elapsed_us(drawn_us, blitted_us));
+    latency_hist_add(&device_hists[LATENCY_STAGE_TOTAL], elapsed_us(arrival_us, blitted_us));
+}
+
+const latency_hist_t* latency_get(uint8_t device_id, latency_stage_t stage) {
+    if (device_id >= CONFIG_HID_MAX_DEVICES || stage >= LATENCY_STAGE_COUNT) {
+        return NULL;
+    }
+    return &hists[device_id][stage];
+}
+
+/**
+ * @brief Clears the histograms of a device slot, called when a new device takes the slot
+ */
+void latency_reset_device(uint8_t device_id) {
+    if (device_id < CONFIG_HID_MAX_DEVICES) {
+        memset(hists[device_id], 0, sizeof(hists[device_id]));
+    }
+}
+
+/**
+ * @brief Formats a one line summary (p50/p99/max per stage) for the overlay
+ *
+ * @param[in]  device_id  Device slot
+ * @param[out] out        Destination buffer
+ * @param[in]  size       Size of the destination buffer
+ */
+void latency_format(uint8_t device_id, char* out, size_t size) {
+    const latency_hist_t* total = latency_get(device_id, LATENCY_STAGE_TOTAL);
+    if (total == NULL || total->count == 0) {
+        snprintf(out, size, "Latency: no samples");
+        return;
+    }
+
+    snprintf(out, size, "Latency us p50/p99/max: total %lu/%lu/%lu, p99 parse %lu draw %lu blit %lu",
+             (unsigned long)latency_hist_percentile(total, 500), (unsigned long)latency_hist_percentile(total, 990),
+             (unsigned long)total->max_us,
+             (unsigned long)latency_hist_percentile(latency_get(device_id, LATENCY_STAGE_PARSE), 990),
+             (unsigned long)latency_hist_percentile(latency_get(device_id, LATENCY_STAGE_DRAW), 990),
+             (unsigned long)latency_hist_percentile(latency_get(device_id, LATENCY_STAGE_BLIT), 990));
+}
+
+/**
+ * @brief Prints the percentiles and non-empty buckets of all devices to the console
+ */
+void latency_dump(void) {
+    printf("Latency (us)\n");
+    for (uint8_t device_id = 0; device_id < CONFIG_HID_MAX_DEVICES; device_id++) {
+        for (latency_stage_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            const latency_hist_t* hist = &hists[device_id][stage];
+            if (hist->count == 0) {
+                continue;
+            }
+
+            printf("device %u %-5s n=%lu p50=%lu p90=%lu p99=%lu p999=%lu max=%lu\n", device_id,
+                   latency_stage_name(stage), (unsigned long)hist->count,
+                   (unsigned long)latency_hist_percentile(hist, 500), (unsigned long)latency_hist_percentile(hist, 900),
+                   (unsigned long)latency_hist_percentile(hist, 990), (unsigned long)latency_hist_percentile(hist, 999),
+                   (unsigned long)hist->max_us);
+
+            for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                if (hist->buckets[i] > 0) {
+                    printf("  <= %lu: %lu\n", (unsigned long)bucket_upper_bound(i), (unsigned long)hist->buckets[i]);
+                }
+            }
+        }
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Asks the render task to dump the histograms, safe to call from any task
+ */
+void latency_request_dump(void) {
+    atomic_store(&dump_requested, true);
+}
+
+bool latency_take_dump_request(void) {
+    return atomic_exchange(&dump_requested, false);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Log-linear buckets: exact below 8 us, then 4 buckets per power of two (at most 25% wide)
+#define LATENCY_LINEAR_BUCKETS 8
+#define LATENCY_SUB_BUCKETS    4
+#define LATENCY_BUCKETS        (LATENCY_LINEAR_BUCKETS + 24 * LATENCY_SUB_BUCKETS)  // Up to ~134 s
+
+/**
+ * @brief Stages of a report on its way to the screen
+ */
+typedef enum {
+    LATENCY_STAGE_PARSE = 0,  // Arrival in the interface callback to parsed, includes queueing in the ring
+    LATENCY_STAGE_DRAW,       // Parsed to drawn into the framebuffer, includes waiting for the next frame
+    LATENCY_STAGE_BLIT,       // Drawn to bsp_display_blit() returning
+    LATENCY_STAGE_TOTAL,      // Arrival to bsp_display_blit() returning
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+void latency_hist_add(latency_hist_t* hist, uint32_t value_us);
+
+uint32_t latency_hist_percentile(const latency_hist_t* hist, uint32_t permille);
+
+const char* latency_stage_name(latency_stage_t stage);
+
+void latency_record(uint8_t device_id, int64_t arrival_us, int64_t parsed_us, int64_t drawn_us, int64_t blitted_us);
+
+const latency_hist_t* latency_get(uint8_t device_id, latency_stage_t stage);
+
+void latency_reset_device(uint8_t device_id);
+
+void latency_format(uint8_t device_id, char* out, size_t size);
+
+void latency_dump(void);
+
+void latency_request_dump(void);
+
+bool latency_take_dump_request(void);
@@ -1,21 +1,26 @@
 #include <stdio.h>
 #include "badge_hid_host.h"
 #include "bsp/device.h"
-#include "bsp/display.h"
 #include "bsp/led.h"
 #include "bsp/power.h"
+#include "calibration_store.h"
+#include "capture.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "event_stream.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
-#include "hal/lcd_types.h"
+#include "hid_device.h"
+#include "hid_input_usb.h"
+#include "input_state.h"
+#include "latency.h"
 #include "nvs_flash.h"
-#include "pax_fonts.h"
-#include "pax_gfx.h"
-#include "pax_text.h"
 #include "portmacro.h"
+#include "profile_store.h"
+#include "render.h"
 #include "usb/hid_host.h"
 #include "usb/hid_usage_keyboard.h"
 #include "usb/hid_usage_mouse.h"
@@ -25,35 +30,14 @@
 static char const TAG[] = "main";
 
 // Global variables
-static size_t                       display_h_res        = 0;
-static size_t                       display_v_res        = 0;
-static lcd_color_rgb_pixel_format_t display_color_format = LCD_COLOR_PIXEL_FORMAT_RGB565;
-static lcd_rgb_data_endian_t        display_data_endian  = LCD_RGB_DATA_ENDIAN_LITTLE;
-static pax_buf_t                    fb                   = {0};
-static QueueHandle_t                app_event_queue      = NULL;
-
-#if defined(CONFIG_BSP_TARGET_KAMI)
-#define BLACK 0
-#define WHITE 1
-#define RED   2
-#else
-#define BLACK 0xFF000000
-#define WHITE 0xFFFFFFFF
-#define RED   0xFFFF0000
-#endif
-
-#if defined(CONFIG_BSP_TARGET_KAMI)
-static pax_col_t palette[] = {0xffffffff, 0xff000000, 0xffff0000};  // white, black, red
+static QueueHandle_t    app_event_queue   = NULL;
+static TaskHandle_t     input_task_handle = NULL;
+static hid_input_bus_t* input_bus         = NULL;
+#if CONFIG_HID_KEY_REPEAT
+static esp_timer_handle_t key_repeat_timer    = NULL;
+static int64_t            key_repeat_armed_us = INT64_MAX;  // Expiry of the armed timer, only used by the input task
 #endif
 
-void blit(void) {
-    bsp_display_blit(0, 0, display_h_res, display_v_res, pax_buf_get_pixels(&fb));
-}
-
-void cls(void) {
-    pax_simple_rect(&fb, WHITE, 0, 0, pax_buf_get_width(&fb), pax_buf_get_height(&fb));
-}
-
 /**
  * @brief APP event group
  *
@@ -152,27 +136,33 @@ const uint8_t keycode2ascii[57][2] = {
     {'/', '?'}                     /* HID_KEY_SLASH           */
 };
 
+#if CONFIG_HID_EVENT_OUTPUT_TEXT
+// Source of the console output printed last, only used by the input task
+static int            header_device = -1;
+static hid_protocol_t header_proto  = HID_PROTOCOL_NONE;
+
 /**
- * @brief Makes new line depending on report output protocol type
+ * @brief Starts a new console section when the output switches to another device or protocol
  *
- * @param[in] proto Current protocol to output
+ * @param[in] device_id  Slot of the device to output
+ * @param[in] proto      Current protocol to output
  */
-static void hid_print_new_device_report_header(hid_protocol_t proto) {
-    static hid_protocol_t prev_proto_output = -1;
-
-    if (prev_proto_output != proto) {
-        prev_proto_output = proto;
+static void hid_print_new_device_report_header(uint8_t device_id, hid_protocol_t proto) {
+    if (header_device != device_id || header_proto != proto) {
+        header_device = device_id;
+        header_proto  = proto;
         printf("\r\n");
         if (proto == HID_PROTOCOL_MOUSE) {
-            printf("Mouse\r\n");
+            printf("Mouse %u\r\n", device_id);
         } else if (proto == HID_PROTOCOL_KEYBOARD) {
-            printf("Keyboard\r\n");
+            printf("Keyboard %u\r\n", device_id);
         } else {
-            printf("Generic\r\n");
+            printf("Generic %u\r\n", device_id);
         }
         fflush(stdout);
     }
 }
+#endif
 
 /**
  * @brief HID Keyboard modifier verification for capitalization application (right or left shift)
@@ -229,309 +219,541 @@ static inline void hid_keyboard_print_char(unsigned int key_char) {
     }
 }
 
+#if CONFIG_HID_GAMEPAD_CONDITIONING
 /**
- * @brief Key Event. Key event with the key code, state and modifier.
- *
- * @param[in] key_event Pointer to Key Event structure
+ * @brief Starts or finishes calibrating all connected gamepads
  *
+ * Started with the sticks at rest, finished after every axis went through its full range.
+ * Successful calibrations are stored per VID/PID.
  */
-static void key_event_callback(key_event_t* key_event) {
-    unsigned char key_char;
-
-    hid_print_new_device_report_header(HID_PROTOCOL_KEYBOARD);
+static void hid_toggle_gamepad_calibration(void) {
+    static bool calibrating = false;
+    size_t      saved       = 0;
+    char        text[64];
+
+    calibrating = !calibrating;
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        hid_device_t* device = hid_device_get(i);
+        if (device == NULL || HID_SUBCLASS_BOOT_INTERFACE == device->params.sub_class) {
+            continue;
+        }
 
-    if (KEY_STATE_PRESSED == key_event->state) {
-        if (hid_keyboard_get_char(key_event->modifier, key_event->key_code, &key_char)) {
+        // The same raw report conditions differently now, so it must not be dropped as a repeat
+        device->input.gamepad_settled = false;
+        if (calibrating) {
+            gamepad_calibration_begin(&device->gamepad);
+            continue;
+        }
 
-            hid_keyboard_print_char(key_char);
+        gamepad_calibration_t calibration;
+        if (gamepad_calibration_end(&device->gamepad, &calibration)) {
+            esp_err_t res = gamepad_calibration_save(device->vid, device->pid, &calibration);
+            if (res != ESP_OK) {
+                ESP_LOGW(TAG, "Storing gamepad calibration failed: %s", esp_err_to_name(res));
+            }
+#if CONFIG_HID_PROFILE_CACHE
+            device_profile_save_calibration(device->vid, device->pid, device->params.iface_num, &calibration);
+#endif
+            saved++;
         }
     }
+
+    if (calibrating) {
+        snprintf(text, sizeof(text), "Calibrating: move sticks and triggers, F11 when done");
+    } else {
+        snprintf(text, sizeof(text), "Calibrated %u gamepad(s)", (unsigned)saved);
+    }
+    input_state_publish_status(text);
 }
+#endif
 
 /**
- * @brief Key buffer scan code search.
+ * @brief Hot keys: F12 dumps the latency histograms, F11 starts and finishes gamepad calibration
  *
- * @param[in] src       Pointer to source buffer where to search
- * @param[in] key       Key scancode to search
- * @param[in] length    Size of the source buffer
+ * @param[in] event  Key event, only F11 and F12 are subscribed to
+ * @param[in] arg    Not used
  */
-static inline bool key_found(const uint8_t* const src, uint8_t key, unsigned int length) {
-    for (unsigned int i = 0; i < length; i++) {
-        if (src[i] == key) {
-            return true;
-        }
+static void hotkey_event_callback(const hid_input_event_t* event, void* arg) {
+    if (KEY_STATE_PRESSED != event->key.state) {
+        return;
     }
-    return false;
+
+    if (HID_KEY_F12 == event->key.key_code) {
+        latency_request_dump();
+    }
+#if CONFIG_HID_GAMEPAD_CONDITIONING
+    if (HID_KEY_F11 == event->key.key_code) {
+        hid_toggle_gamepad_calibration();
+    }
+#endif
 }
 
+#if CONFIG_HID_KEY_REPEAT
 /**
- * @brief USB HID Host Keyboard Interface report callback handler
+ * @brief Feeds the key presses and releases of a keyboard into its repeat state
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * @param[in] event  Key event
+ * @param[in] arg    Not used
  */
-static void hid_host_keyboard_report_callback(const uint8_t* const data, const int length) {
-    hid_keyboard_input_report_boot_t* kb_report = (hid_keyboard_input_report_boot_t*)data;
+static void key_repeat_event_callback(const hid_input_event_t* event, void* arg) {
+    hid_device_t* device = hid_device_get(event->device_id);
+    if (device != NULL && KEY_STATE_REPEAT != event->key.state) {
+        key_repeat_update(&device->repeat, &event->key, esp_timer_get_time());
+    }
+}
+#endif
 
-    if (length < sizeof(hid_keyboard_input_report_boot_t)) {
-        return;
+/**
+ * @brief Tells the render task which view to show for a decoded report
+ *
+ * The snapshot subscriber runs first, so the snapshot already holds the decoded report when
+ * the render task sees the new generation.
+ *
+ * @param[in] event  Keyboard, mouse or gamepad event
+ * @param[in] arg    Not used
+ */
+static void ui_event_callback(const hid_input_event_t* event, void* arg) {
+    switch (event->type) {
+        case HID_INPUT_EVENT_KEYBOARD:
+            input_state_publish_report(INPUT_VIEW_KEYBOARD, event->raw, event->raw_length);
+            break;
+        case HID_INPUT_EVENT_MOUSE:
+            // The cursor on screen is moved once per frame by the pointer motion in the snapshot
+            input_state_publish_report(INPUT_VIEW_MOUSE, event->raw, event->raw_length);
+            break;
+        case HID_INPUT_EVENT_GAMEPAD:
+            input_state_publish_report(INPUT_VIEW_GAMEPAD, event->raw, event->raw_length);
+            break;
+        default:
+            break;
     }
+}
+
+#if CONFIG_HID_EVENT_OUTPUT_TEXT
+static void output_key_event(const hid_input_event_t* event) {
+    unsigned char key_char;
 
-    static char hex_string[3 * 64] = {0};  // Safe for up to 64 bytes
-    char*       p                  = hex_string;
+    hid_print_new_device_report_header(event->device_id, HID_PROTOCOL_KEYBOARD);
 
-    for (int i = 0; i < length; i++) {
-        p += sprintf(p, "%02X ", data[i]);
+    if (KEY_STATE_PRESSED == event->key.state || KEY_STATE_REPEAT == event->key.state) {
+        if (hid_keyboard_get_char(event->key.modifier, event->key.key_code, &key_char)) {
+            hid_keyboard_print_char(key_char);
+        }
     }
-    if (p > hex_string) *(p - 1) = '\0';
+}
 
-    cls();
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 180, hex_string);
+static void output_mouse_event(const hid_input_event_t* event) {
+    const mouse_report_t* mouse_report = &event->mouse;
+    hid_device_t*         device       = hid_device_get(event->device_id);
+    if (device == NULL) {
+        return;
+    }
 
-    static uint8_t prev_keys[HID_KEYBOARD_KEY_MAX] = {0};
-    key_event_t    key_event;
+    // Calculate absolute position from displacement, per mouse
+    device->mouse_x      += mouse_report->x_displacement;
+    device->mouse_y      += mouse_report->y_displacement;
+    device->mouse_scroll += mouse_report->scroll;
+    device->mouse_tilt   += mouse_report->tilt;
 
-    char  text[64] = {0};
-    char* q        = text;
+    hid_print_new_device_report_header(device->id, HID_PROTOCOL_MOUSE);
 
-    for (int i = 0; i < HID_KEYBOARD_KEY_MAX; i++) {
+    printf("Mouse X: %06ld\tY: %06ld\t|%c|%c|%c| Scroll: %03ld Tilt: %03ld\n", (long)device->mouse_x,
+           (long)device->mouse_y, (mouse_report->buttons.button1 ? 'o' : ' '),
+           (mouse_report->buttons.button3 ? 'o' : ' '), (mouse_report->buttons.button2 ? 'o' : ' '),
+           (long)device->mouse_scroll, (long)device->mouse_tilt);
+    fflush(stdout);
+}
 
-        // key has been released verification
-        if (prev_keys[i] > HID_KEY_ERROR_UNDEFINED && !key_found(kb_report->key, prev_keys[i], HID_KEYBOARD_KEY_MAX)) {
-            key_event.key_code = prev_keys[i];
-            key_event.modifier = 0;
-            key_event.state    = KEY_STATE_RELEASED;
-            key_event_callback(&key_event);
-        }
+static void output_gamepad_event(const hid_input_event_t* event) {
+    const gamepad_report_t* rpt = &event->gamepad.report;
+    char                    button_line[128];
 
-        // key has been pressed verification
-        if (kb_report->key[i] > HID_KEY_ERROR_UNDEFINED &&
-            !key_found(prev_keys, kb_report->key[i], HID_KEYBOARD_KEY_MAX)) {
-            key_event.key_code = kb_report->key[i];
-            key_event.modifier = kb_report->modifier.val;
-            key_event.state    = KEY_STATE_PRESSED;
-            key_event_callback(&key_event);
-        }
+    hid_print_new_device_report_header(event->device_id, HID_PROTOCOL_NONE);
 
-        // add currently pressed key to text buffer
-        if (kb_report->key[i] > HID_KEY_ERROR_UNDEFINED) {
-            // Append as hex, or you can convert to ASCII if you have a lookup
-            int written = snprintf(q, sizeof(text) - (q - text), "%02X ", kb_report->key[i]);
-            if (written > 0) q += written;
-        }
+    if (!event->gamepad.valid) {
+        printf("Received too-short report (%d bytes)\n", event->raw_length);
+        return;
     }
 
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 10, text);
-    blit();
+    gamepad_format_buttons(rpt, button_line, sizeof(button_line));
 
-    memcpy(prev_keys, &kb_report->key, HID_KEYBOARD_KEY_MAX);
+    printf("%s\nReport ID: 0x%02X | Length: %2d\nAxes: LX=%3d LY=%3d RX=%3d RY=%3d LT=%3d RT=%3d\n", button_line,
+           rpt->report_id, event->raw_length, rpt->lx, rpt->ly, rpt->rx, rpt->ry, rpt->lt, rpt->rt);
+}
+
+static void output_consumer_event(const hid_input_event_t* event) {
+    hid_print_new_device_report_header(event->device_id, HID_PROTOCOL_NONE);
+    printf("Consumer 0x%04X %s\n", event->consumer.usage,
+           KEY_STATE_PRESSED == event->consumer.state ? "pressed" : "released");
+    fflush(stdout);
 }
 
 /**
- * @brief USB HID Host Mouse Interface report callback handler
+ * @brief Prints decoded events to the console
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * @param[in] event  Event to print
+ * @param[in] arg    Not used
  */
-static void hid_host_mouse_report_callback(const uint8_t* const data, const int length) {
-    if (length < sizeof(hid_mouse_input_report_boot_t)) {
-        return;
+static void output_event_callback(const hid_input_event_t* event, void* arg) {
+    switch (event->type) {
+        case HID_INPUT_EVENT_KEY:
+            output_key_event(event);
+            break;
+        case HID_INPUT_EVENT_MOUSE:
+            output_mouse_event(event);
+            break;
+        case HID_INPUT_EVENT_GAMEPAD:
+            output_gamepad_event(event);
+            break;
+        case HID_INPUT_EVENT_CONSUMER:
+            output_consumer_event(event);
+            break;
+        default:
+            break;
     }
-
-    static char hex_string[3 * 64] = {0};  // Safe for up to 64 bytes
-    char*       p                  = hex_string;
-
-    for (int i = 0; i < length; i++) {
-        p += sprintf(p, "%02X ", data[i]);
+}
+#else
+/**
+ * @brief Writes decoded events to the binary event stream
+ *
+ * @param[in] event  Event to write
+ * @param[in] arg    Not used
+ */
+static void output_event_callback(const hid_input_event_t* event, void* arg) {
+    switch (event->type) {
+        case HID_INPUT_EVENT_KEY:
+            event_stream_key(event->device_id, event->timestamp_us, &event->key);
+            break;
+        case HID_INPUT_EVENT_MOUSE:
+            event_stream_mouse(event->device_id, event->timestamp_us, &event->mouse);
+            break;
+        case HID_INPUT_EVENT_GAMEPAD:
+            if (event->gamepad.valid) {
+                event_stream_gamepad(event->device_id, event->timestamp_us, &event->gamepad.report);
+            }
+            break;
+        case HID_INPUT_EVENT_CONSUMER:
+            event_stream_consumer(event->device_id, event->timestamp_us, &event->consumer);
+            break;
+        default:
+            break;
     }
-    if (p > hex_string) *(p - 1) = '\0';
-
-    cls();
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 180, hex_string);
-
-    mouse_report_t mouse_report = parse_mouse_event(data, length);
-
-    static int x_pos    = 0;
-    static int y_pos    = 0;
-    static int x_scroll = 0;
-    static int y_scroll = 0;
-
-    // Calculate absolute position from displacement
-    x_pos    += mouse_report.x_displacement;
-    y_pos    += mouse_report.y_displacement;
-    x_scroll += mouse_report.scroll;
-    y_scroll += mouse_report.tilt;
-
-    hid_print_new_device_report_header(HID_PROTOCOL_MOUSE);
+}
+#endif
 
-    char text[64];
-    snprintf(text, sizeof(text), "Mouse X: %06d\tY: %06d\t|%c|%c|%c| Scroll: %03d Tilt: %03d", x_pos, y_pos,
-             (mouse_report.buttons.button1 ? 'o' : ' '), (mouse_report.buttons.button3 ? 'o' : ' '),
-             (mouse_report.buttons.button2 ? 'o' : ' '), x_scroll, y_scroll);
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 18, text);
-    blit();
-    printf("%s\n", text);
-    fflush(stdout);
+#if CONFIG_HID_GAMEPAD_CONDITIONING
+/**
+ * @brief Conditions the axes of a decoded gamepad report before it is published
+ *
+ * @param[in] report        Decoded report, conditioned in place
+ * @param[in] timestamp_us  Arrival time of the report, paces the axis smoothing
+ * @param[in] arg           Device the report came from
+ */
+static void hid_condition_gamepad(gamepad_report_t* report, int64_t timestamp_us, void* arg) {
+    hid_device_t* device = (hid_device_t*)arg;
+    gamepad_condition_apply(&device->gamepad, report, timestamp_us);
 }
+#endif
 
-static void print_gamepad_report(const gamepad_report_t* rpt, int length) {
-    char line1[64], line2[64], button_line[128];
-
-    snprintf(line1, sizeof(line1), "Report ID: 0x%02X | Length: %2d", rpt->report_id, length);
-    snprintf(line2, sizeof(line2), "Axes: LX=%3d LY=%3d RX=%3d RY=%3d LT=%3d RT=%3d", rpt->lx, rpt->ly, rpt->rx,
-             rpt->ry, rpt->lt, rpt->rt);
-
-    const char* btn_labels[] = {"A",  "B",  "X",      "Y",     "L1",   "R1",   "L2",    "R2", "L3",  "R3",
-                                "L4", "R4", "Select", "Start", "Home", "Left", "Right", "Up", "Down"};
-    const bool  btn_states[] = {rpt->buttons.a,      rpt->buttons.b,     rpt->buttons.x,    rpt->buttons.y,
-                                rpt->buttons.l1,     rpt->buttons.r1,    rpt->buttons.l2,   rpt->buttons.r2,
-                                rpt->buttons.l3,     rpt->buttons.r3,    rpt->buttons.l4,   rpt->buttons.r4,
-                                rpt->buttons.select, rpt->buttons.start, rpt->buttons.home, rpt->buttons.left,
-                                rpt->buttons.right,  rpt->buttons.up,    rpt->buttons.down};
-
-    button_line[0] = '\0';
-    strcat(button_line, "Buttons:");
-    for (int i = 0; i < sizeof(btn_labels) / sizeof(btn_labels[0]); i++) {
-        if (btn_states[i]) {
-            strcat(button_line, " ");
-            strcat(button_line, btn_labels[i]);
-        }
+static void hid_subscribe(const hid_input_filter_t* filter, hid_input_callback_t callback, void* arg) {
+    if (hid_input_subscribe(input_bus, filter, callback, arg) < 0) {
+        ESP_LOGE(TAG, "No free input subscriber slot, increase CONFIG_HID_INPUT_MAX_SUBSCRIBERS");
     }
+}
 
-    printf("%s\n%s\n%s\n", button_line, line1, line2);
+/**
+ * @brief Subscribes the consumers of the firmware itself to the input bus
+ *
+ * Subscribers are called in this order for every event: input state snapshot, key repeat,
+ * hot keys, display and console or event stream output.
+ */
+static void hid_subscribe_outputs(void) {
+    const hid_input_filter_t any_filter    = HID_INPUT_FILTER_ANY;
+    hid_input_filter_t       hotkey_filter = HID_INPUT_FILTER_ANY;
+    hid_input_filter_t       ui_filter     = HID_INPUT_FILTER_ANY;
+    hid_input_filter_t       state_filter  = HID_INPUT_FILTER_ANY;
+
+    hotkey_filter.types   = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEY);
+    hotkey_filter.key_min = HID_KEY_F11;
+    hotkey_filter.key_max = HID_KEY_F12;
+    ui_filter.types       = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEYBOARD) | HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_MOUSE) |
+                      HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_GAMEPAD);
+    state_filter.types    = ui_filter.types;
+
+    hid_subscribe(&state_filter, hid_input_snapshot_event, hid_input_get_snapshot());
+#if CONFIG_HID_KEY_REPEAT
+    hid_input_filter_t key_filter = HID_INPUT_FILTER_ANY;
+    key_filter.types              = HID_INPUT_TYPE_BIT(HID_INPUT_EVENT_KEY);
+    hid_subscribe(&key_filter, key_repeat_event_callback, NULL);
+#endif
+    hid_subscribe(&hotkey_filter, hotkey_event_callback, NULL);
+    hid_subscribe(&ui_filter, ui_event_callback, NULL);
+    hid_subscribe(&any_filter, output_event_callback, NULL);
+}
 
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 10, button_line);
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 26, line1);
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 42, line2);
-    blit();
+/**
+ * @brief Decodes one raw report and publishes its events on the input bus
+ *
+ * @param[in] device  Device the report came from
+ * @param[in] entry   Raw report
+ */
+static void hid_dispatch_report(hid_device_t* device, const report_ring_entry_t* entry) {
+    input_state_set_origin(device->id, entry->timestamp_us);
+    size_t published =
+        hid_input_interface_report(&device->input, input_bus, entry->data, entry->length, entry->timestamp_us);
+
+    if (published > 0 && !device->first_event_seen) {
+        device->first_event_seen = true;
+        ESP_LOGI(TAG, "Device %u: first event %lld us after connect", device->id,
+                 (long long)(entry->timestamp_us - device->connected_us));
+    }
 }
 
-void draw_gamepad_visual(const gamepad_report_t* rpt) {
-    const int center_y = 120;
+/**
+ * @brief Handles up to max queued reports of a device
+ *
+ * @param[in] device  Device to drain
+ * @param[in] max     Maximum number of reports to handle
+ * @return Number of reports handled
+ */
+static size_t hid_drain_device(hid_device_t* device, size_t max) {
+    const report_ring_entry_t* entry;
+    size_t                     count = 0;
 
-    const int l_center_x = 130;
-    pax_draw_circle(&fb, RED, l_center_x, center_y, 12);
+    while (count < max && (entry = report_ring_front(&device->ring)) != NULL) {
+        if (rate_meter_add(&device->rate, entry->timestamp_us)) {
+            input_state_publish_rate(device->id, &device->rate.stats);
+        }
+        hid_dispatch_report(device, entry);
+        report_ring_pop(&device->ring);
+        count++;
+    }
 
-    int lx_offset = ((int)rpt->lx - 128) / 6;
-    int ly_offset = ((int)rpt->ly - 128) / 6;
-    pax_draw_circle(&fb, BLACK, l_center_x + lx_offset, center_y + ly_offset, 3);
+    return count;
+}
 
-    const int bar_w     = 10;
-    const int bar_h_max = 40;
+#if CONFIG_HID_KEY_REPEAT
+/**
+ * @brief Key repeat timer callback, wakes the input task to emit the repeat
+ */
+static void key_repeat_timer_callback(void* arg) {
+    xTaskNotifyGive(input_task_handle);
+}
 
-    const int lt_x = 170;
-    int       lt_h = (rpt->lt * bar_h_max) / 255;
-    pax_draw_rect(&fb, BLACK, lt_x, center_y - lt_h, bar_w, lt_h);
+/**
+ * @brief Emits the key repeats that are due and arms the timer for the next one
+ *
+ * A single one shot timer serves all keyboards, it is always armed for the earliest repeat.
+ */
+static void hid_service_key_repeat(void) {
+    int64_t now  = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        hid_device_t* device = hid_device_get(i);
+        if (device == NULL || !key_repeat_active(&device->repeat)) {
+            continue;
+        }
 
-    const int rt_x = 190;
-    int       rt_h = (rpt->rt * bar_h_max) / 255;
-    pax_draw_rect(&fb, BLACK, rt_x, center_y - rt_h, bar_w, rt_h);
+        key_event_t event;
+        if (key_repeat_poll(&device->repeat, now, &event)) {
+            hid_input_publish_key(input_bus, device->id, &event, now);
+        }
+        if (device->repeat.due_us < next) {
+            next = device->repeat.due_us;
+        }
+    }
 
-    const int r_center_x = 230;
-    pax_draw_circle(&fb, RED, r_center_x, center_y, 12);
+    // The timer is still armed for the same repeat
+    if (next == key_repeat_armed_us && next > now) {
+        return;
+    }
 
-    int rx_offset = ((int)rpt->rx - 128) / 6;
-    int ry_offset = ((int)rpt->ry - 128) / 6;
-    pax_draw_circle(&fb, BLACK, r_center_x + rx_offset, center_y + ry_offset, 3);
+    esp_timer_stop(key_repeat_timer);
+    key_repeat_armed_us = next;
+    if (next != INT64_MAX) {
+        esp_timer_start_once(key_repeat_timer, next > now ? next - now : 1);
+    }
 }
+#endif
 
 /**
- * @brief USB HID Host Generic Interface report callback handler
+ * @brief Input task
  *
- * 'generic' means anything else than mouse or keyboard
+ * Woken by the interface callback, drains the report rings of all devices in batches of
+ * CONFIG_HID_INPUT_BATCH_SIZE (round robin) and releases devices that disconnected once
+ * their last report has been handled. Also woken by the key repeat timer.
  *
- * @param[in] data    Pointer to input report data buffer
- * @param[in] length  Length of input report data buffer
+ * @param[in] arg  Not used
  */
-static void hid_host_generic_report_callback(const uint8_t* const data, const int length) {
-    hid_print_new_device_report_header(HID_PROTOCOL_NONE);
+static void input_task(void* arg) {
+    char text[64];
 
-    // Hex string of full report (e.g., "03 08 04 00 80 80 80 80 89 00 00")
-    static char hex_string[3 * 64] = {0};  // Safe for up to 64 bytes
-    char*       p                  = hex_string;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        bool pending = true;
+        while (pending) {
+            pending = false;
+            for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+                hid_device_t* device = hid_device_get(i);
+                if (device == NULL) {
+                    continue;
+                }
 
-    for (int i = 0; i < length; i++) {
-        p += sprintf(p, "%02X ", data[i]);
-    }
-    if (p > hex_string) *(p - 1) = '\0';
+                // Sample the flag first so reports queued before the disconnect are still handled
+                bool disconnected = atomic_load(&device->disconnected);
 
-    cls();
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 10, 180, hex_string);
+                hid_drain_device(device, CONFIG_HID_INPUT_BATCH_SIZE);
 
-    if (length >= 10) {
-        gamepad_report_t rpt = parse_gamepad_report(data, length);
-        draw_gamepad_visual(&rpt);
-        print_gamepad_report(&rpt, length);
-    } else {
-        printf("Received too-short report (%d bytes)\n", length);
+                if (report_ring_count(&device->ring) > 0) {
+                    pending = true;
+                } else if (disconnected) {
+                    snprintf(text, sizeof(text), "HID Device, protocol '%s' DISCONNECTED",
+                             hid_proto_name_str[device->params.proto]);
+                    input_state_publish_status(text);
+                    input_state_clear_device(device->id);
+                    hid_input_snapshot_clear_device(hid_input_get_snapshot(), device->id);
+                    hid_device_free(device);
+                }
+            }
+        }
+
+#if CONFIG_HID_KEY_REPEAT
+        hid_service_key_repeat();
+#endif
     }
 }
 
 /**
  * @brief USB HID Host interface callback
  *
+ * Runs in the HID driver task: reports are only timestamped and queued, all processing
+ * happens in the input task.
+ *
  * @param[in] hid_device_handle  HID Device handle
  * @param[in] event              HID Host interface event
- * @param[in] arg                Pointer to arguments, does not used
+ * @param[in] arg                Pointer to the hid_device_t of this interface
  */
 void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle, const hid_host_interface_event_t event,
                                  void* arg) {
-    uint8_t               data[64]    = {0};
-    size_t                data_length = 0;
-    hid_host_dev_params_t dev_params;
-    ESP_ERROR_CHECK(hid_host_device_get_params(hid_device_handle, &dev_params));
-
-    char text[64];
+    hid_device_t*        device = (hid_device_t*)arg;
+    report_ring_entry_t* entry;
+    size_t               data_length = 0;
+    char                 text[64];
 
     switch (event) {
         case HID_HOST_INTERFACE_EVENT_INPUT_REPORT:
-            ESP_ERROR_CHECK(hid_host_device_get_raw_input_report_data(hid_device_handle, data, 64, &data_length));
+            input_state_count_report();
 
-            if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
-                if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
-                    hid_host_keyboard_report_callback(data, data_length);
-                } else if (HID_PROTOCOL_MOUSE == dev_params.proto) {
-                    hid_host_mouse_report_callback(data, data_length);
-                }
-            } else {
-                hid_host_generic_report_callback(data, data_length);
+            entry = report_ring_reserve(&device->ring);
+            if (entry == NULL) {
+                // Ring full, counted as dropped
+                break;
             }
 
+            entry->timestamp_us = esp_timer_get_time();
+            ESP_ERROR_CHECK(hid_host_device_get_raw_input_report_data(hid_device_handle, entry->data,
+                                                                       sizeof(entry->data), &data_length));
+            entry->length = data_length;
+#if CONFIG_HID_CAPTURE
+            capture_report(device->id, device->input.routes.uses_report_ids ? entry->data[0] : 0,
+                           entry->timestamp_us, entry->data, entry->length);
+#endif
+            report_ring_commit(&device->ring);
+
+            xTaskNotifyGive(input_task_handle);
             break;
         case HID_HOST_INTERFACE_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG, "HID Device, protocol '%s' DISCONNECTED", hid_proto_name_str[dev_params.proto]);
-
-            cls();
-            snprintf(text, sizeof(text), "HID Device, protocol '%s' DISCONNECTED",
-                     hid_proto_name_str[dev_params.proto]);
-            pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 18, text);
-            blit();
+            ESP_LOGI(TAG, "HID Device, protocol '%s' DISCONNECTED", hid_proto_name_str[device->params.proto]);
 
             ESP_ERROR_CHECK(hid_host_device_close(hid_device_handle));
+            atomic_store(&device->disconnected, true);
+            xTaskNotifyGive(input_task_handle);
             break;
         case HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR:
-            ESP_LOGI(TAG, "HID Device, protocol '%s' TRANSFER_ERROR", hid_proto_name_str[dev_params.proto]);
+            ESP_LOGI(TAG, "HID Device, protocol '%s' TRANSFER_ERROR", hid_proto_name_str[device->params.proto]);
 
-            cls();
             snprintf(text, sizeof(text), "HID Device, protocol '%s' TRANSFER_ERROR",
-                     hid_proto_name_str[dev_params.proto]);
-            pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 18, text);
-            blit();
+                     hid_proto_name_str[device->params.proto]);
+            input_state_publish_status(text);
 
             break;
         default:
-            ESP_LOGE(TAG, "HID Device, protocol '%s' Unhandled event", hid_proto_name_str[dev_params.proto]);
+            ESP_LOGE(TAG, "HID Device, protocol '%s' Unhandled event", hid_proto_name_str[device->params.proto]);
 
-            cls();
             snprintf(text, sizeof(text), "HID Device, protocol '%s' Unhandled event",
-                     hid_proto_name_str[dev_params.proto]);
-            pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 18, text);
-            blit();
+                     hid_proto_name_str[device->params.proto]);
+            input_state_publish_status(text);
 
             break;
     }
 }
 
+/**
+ * @brief Sets up the decoding and gamepad conditioning of a connected interface
+ *
+ * A known interface (same VID/PID, interface number and report descriptor) takes its compiled
+ * plan and calibration from the profile cache in a single NVS read, a new one compiles its
+ * report descriptor and is added to the cache. Not reentrant, called from the USB event loop
+ * in app_main only.
+ *
+ * @param[in] device       Device, VID/PID filled in
+ * @param[in] desc         Report descriptor
+ * @param[in] desc_length  Length of the report descriptor
+ * @return true when the profile came from the cache
+ */
+static bool hid_setup_input(hid_device_t* device, const uint8_t* desc, size_t desc_length) {
+    const hid_plan_t* cached_plan = NULL;
+    bool              cached      = false;
+#if CONFIG_HID_PROFILE_CACHE
+    // Static to keep the plan off the app_main stack, so only the USB event loop in app_main may call this
+    static device_profile_t profile;
+
+    uint32_t desc_hash = hid_plan_descriptor_hash(desc, desc_length);
+    cached = device_profile_load(device->vid, device->pid, device->params.iface_num, desc_hash, desc_length,
+                                 &profile) == ESP_OK;
+    if (cached && profile.has_plan) {
+        cached_plan = &profile.plan;
+    }
+#endif
+
+    // Compiles the report descriptor unless the plan is cached, and selects the protocol
+    ESP_ERROR_CHECK(hid_input_interface_open(&device->input, device->id, device->handle, cached_plan));
+
+#if CONFIG_HID_PROFILE_CACHE
+    if (!cached) {
+        profile.desc_hash       = desc_hash;
+        profile.desc_length     = desc_length;
+        profile.has_plan        = device->input.has_plan;
+        profile.plan            = device->input.plan;
+        profile.has_calibration = gamepad_calibration_load(device->vid, device->pid, &profile.calibration) == ESP_OK;
+
+        esp_err_t res = device_profile_save(device->vid, device->pid, device->params.iface_num, &profile);
+        if (res != ESP_OK) {
+            ESP_LOGW(TAG, "Caching the device profile failed: %s", esp_err_to_name(res));
+        }
+    }
+#endif
+#if CONFIG_HID_GAMEPAD_CONDITIONING
+    gamepad_calibration_t calibration;
+#if CONFIG_HID_PROFILE_CACHE
+    bool has_calibration = profile.has_calibration;
+    calibration          = profile.calibration;
+#else
+    bool has_calibration = gamepad_calibration_load(device->vid, device->pid, &calibration) == ESP_OK;
+#endif
+    if (has_calibration) {
+        ESP_LOGI(TAG, "Using stored gamepad calibration for %04x:%04x", device->vid, device->pid);
+        gamepad_condition_set_calibration(&device->gamepad, &calibration);
+    }
+    device->input.gamepad_filter     = hid_condition_gamepad;
+    device->input.gamepad_filter_arg = device;
+#endif
+
+    return cached;
+}
+
 /**
  * @brief USB HID Host Device event
  *
@@ -547,25 +769,50 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle, const hid
         case HID_HOST_DRIVER_EVENT_CONNECTED:
             ESP_LOGI(TAG, "HID Device, protocol '%s' CONNECTED", hid_proto_name_str[dev_params.proto]);
 
-            cls();
+            hid_device_t* device = hid_device_alloc(hid_device_handle, &dev_params);
+            if (device == NULL) {
+                input_state_publish_status("Too many HID devices connected");
+                break;
+            }
+            device->connected_us = esp_timer_get_time();
+
+            latency_reset_device(device->id);
+
             char text[64];
             snprintf(text, sizeof(text), "HID Device, protocol '%s' CONNECTED", hid_proto_name_str[dev_params.proto]);
-            pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 18, text);
-            blit();
+            input_state_publish_status(text);
 
-            const hid_host_device_config_t dev_config = {.callback = hid_host_interface_callback, .callback_arg = NULL};
+            const hid_host_device_config_t dev_config = {.callback     = hid_host_interface_callback,
+                                                         .callback_arg = device};
 
             ESP_ERROR_CHECK(hid_host_device_open(hid_device_handle, &dev_config));
-            if (HID_SUBCLASS_BOOT_INTERFACE == dev_params.sub_class) {
-                ESP_ERROR_CHECK(hid_class_request_set_protocol(hid_device_handle, HID_REPORT_PROTOCOL_BOOT));
-                if (HID_PROTOCOL_KEYBOARD == dev_params.proto) {
-                    ESP_ERROR_CHECK(hid_class_request_set_idle(hid_device_handle, 0, 0));
-                }
-                if (HID_PROTOCOL_MOUSE == dev_params.proto) {
-                    hid_class_request_set_protocol(hid_device_handle, HID_REPORT_PROTOCOL_REPORT);
-                }
+
+            hid_host_dev_info_t dev_info = {0};
+            hid_host_get_device_info(hid_device_handle, &dev_info);
+            device->vid = dev_info.VID;
+            device->pid = dev_info.PID;
+
+            size_t         desc_length = 0;
+            const uint8_t* desc        = hid_host_get_report_descriptor(hid_device_handle, &desc_length);
+            if (!hid_device_keep_descriptor(device, desc, desc_length)) {
+                ESP_LOGW(TAG, "Report descriptor of %u bytes does not fit the device arena", (unsigned)desc_length);
             }
+            bool cached = hid_setup_input(device, desc, desc_length);
+            hid_device_publish(device);
+#if CONFIG_HID_CAPTURE
+            capture_device_info_t capture_info = {
+                .vid       = dev_info.VID,
+                .pid       = dev_info.PID,
+                .interface = dev_params.iface_num,
+                .sub_class = dev_params.sub_class,
+                .protocol  = dev_params.proto,
+            };
+            capture_device(device->id, &capture_info, device->descriptor, device->descriptor_length);
+#endif
             ESP_ERROR_CHECK(hid_host_device_start(hid_device_handle));
+            ESP_LOGI(TAG, "Device %u: started %lld us after connect, %s", device->id,
+                     (long long)(esp_timer_get_time() - device->connected_us),
+                     cached ? "cached profile" : "report descriptor compiled");
             break;
         default:
             break;
@@ -598,10 +845,7 @@ static void usb_lib_task(void* arg) {
     }
 
     ESP_LOGI(TAG, "USB shutdown");
-
-    cls();
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 0, "USB shutdown");
-    blit();
+    input_state_publish_status("USB shutdown");
 
     // Clean up USB Host
     vTaskDelay(10);  // Short delay to allow clients clean-up
@@ -657,61 +901,19 @@ void app_main(void) {
     };
     bsp_led_write(led_data, sizeof(led_data));
 
-    // Get display parameters and rotation
-    res = bsp_display_get_parameters(&display_h_res, &display_v_res, &display_color_format, &display_data_endian);
-    ESP_ERROR_CHECK(res);  // Check that the display parameters have been initialized
-    bsp_display_rotation_t display_rotation = bsp_display_get_default_rotation();
+    // Initialize the display and start drawing from the shared input state
+    ESP_ERROR_CHECK(render_init());
+    ESP_ERROR_CHECK(render_start());
 
-    // Convert ESP-IDF color format into PAX buffer type
-    pax_buf_type_t format = PAX_BUF_24_888RGB;
-    switch (display_color_format) {
-        case LCD_COLOR_PIXEL_FORMAT_RGB565:
-            format = PAX_BUF_16_565RGB;
-            break;
-        case LCD_COLOR_PIXEL_FORMAT_RGB888:
-            format = PAX_BUF_24_888RGB;
-            break;
-        default:
-            break;
-    }
-
-    // Convert BSP display rotation format into PAX orientation type
-    pax_orientation_t orientation = PAX_O_UPRIGHT;
-    switch (display_rotation) {
-        case BSP_DISPLAY_ROTATION_90:
-            orientation = PAX_O_ROT_CCW;
-            break;
-        case BSP_DISPLAY_ROTATION_180:
-            orientation = PAX_O_ROT_HALF;
-            break;
-        case BSP_DISPLAY_ROTATION_270:
-            orientation = PAX_O_ROT_CW;
-            break;
-        case BSP_DISPLAY_ROTATION_0:
-        default:
-            orientation = PAX_O_UPRIGHT;
-            break;
+#if CONFIG_HID_CAPTURE
+    // Capturing is a debugging aid, keep running without it
+    if (capture_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Raw report capture disabled");
     }
-
-        // Initialize graphics stack
-#if defined(CONFIG_BSP_TARGET_KAMI)
-    format = PAX_BUF_2_PAL;
-#endif
-
-    pax_buf_init(&fb, NULL, display_h_res, display_v_res, format);
-    pax_buf_reversed(&fb, display_data_endian == LCD_RGB_DATA_ENDIAN_BIG);
-
-#if defined(CONFIG_BSP_TARGET_KAMI)
-    fb.palette      = palette;
-    fb.palette_size = sizeof(palette) / sizeof(pax_col_t);
 #endif
 
-    pax_buf_set_orientation(&fb, orientation);
-
     ESP_LOGW(TAG, "Hello HID!");
 
-    pax_background(&fb, WHITE);
-
     // Power to USB
     bsp_power_set_usb_host_boost_enabled(true);
 
@@ -730,6 +932,27 @@ void app_main(void) {
     // Wait for notification from usb_lib_task to proceed
     ulTaskNotifyTake(false, 1000);
 
+#if CONFIG_HID_EVENT_OUTPUT_BINARY
+    ESP_ERROR_CHECK(event_stream_init());
+#endif
+
+    // Attach the display and output to the input bus before the first report can arrive
+    input_bus = hid_input_get_bus();
+    hid_subscribe_outputs();
+
+    // Create the task that processes queued input reports
+    task_created = xTaskCreatePinnedToCore(input_task, "input", CONFIG_HID_INPUT_TASK_STACK_SIZE, NULL,
+                                           CONFIG_HID_INPUT_TASK_PRIORITY, &input_task_handle, tskNO_AFFINITY);
+    assert(task_created == pdTRUE);
+
+#if CONFIG_HID_KEY_REPEAT
+    const esp_timer_create_args_t key_repeat_timer_args = {
+        .callback = key_repeat_timer_callback,
+        .name     = "key_repeat",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&key_repeat_timer_args, &key_repeat_timer));
+#endif
+
     /*
      * HID host driver configuration
      * - create background task for handling low level event inside the HID driver
@@ -749,8 +972,7 @@ void app_main(void) {
 
     ESP_LOGI(TAG, "Waiting for HID Device to be connected");
 
-    pax_draw_text(&fb, BLACK, pax_font_sky_mono, 16, 0, 16, "Hello HID!");
-    blit();
+    input_state_publish_status("Hello HID!");
 
     while (1) {
         // Wait queue
@@ -0,0 +1,88 @@
+// mouse_motion.c
+//
+// Pointer acceleration with sub-pixel carry. Fed once per display frame with the summed
+// motion of all reports in that frame, so the cost does not grow with the mouse report rate.
+
+#include "mouse_motion.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MOUSE_MOTION_MIN_ELAPSED_US 1000  // Lower bound of the time a frame's motion is spread over
+
+/**
+ * @brief Initializes a cursor in the middle of the given area
+ *
+ * @param[in] motion  Cursor to initialize
+ * @param[in] accel   Acceleration curve
+ * @param[in] width   Width of the area the cursor stays in
+ * @param[in] height  Height of the area the cursor stays in
+ */
+void mouse_motion_init(mouse_motion_t* motion, const mouse_accel_t* accel, int32_t width, int32_t height) {
+    memset(motion, 0, sizeof(*motion));
+    motion->accel = *accel;
+    motion->max_x = width > 0 ? width - 1 : 0;
+    motion->max_y = height > 0 ? height - 1 : 0;
+    motion->x     = motion->max_x / 2;
+    motion->y     = motion->max_y / 2;
+}
+
+/**
+ * @brief Evaluates the acceleration curve for the motion of one frame
+ *
+ * @param[in] accel       Acceleration curve
+ * @param[in] dx          Summed horizontal motion in counts
+ * @param[in] dy          Summed vertical motion in counts
+ * @param[in] elapsed_us  Time the motion was made in
+ * @return Gain in Q8
+ */
+int32_t mouse_motion_gain(const mouse_accel_t* accel, int32_t dx, int32_t dy, uint32_t elapsed_us) {
+    uint32_t ax = abs(dx);
+    uint32_t ay = abs(dy);
+    // Vector length within 7 %, avoids a square root per frame
+    uint32_t magnitude = ax > ay ? ax + ay * 3 / 8 : ay + ax * 3 / 8;
+
+    if (elapsed_us < MOUSE_MOTION_MIN_ELAPSED_US) {
+        elapsed_us = MOUSE_MOTION_MIN_ELAPSED_US;
+    }
+
+    int64_t speed_q8 = (int64_t)magnitude * 256 * 1000 / elapsed_us;
+    int64_t gain_q8  = accel->sensitivity_q8;
+    if (speed_q8 > accel->threshold_q8) {
+        gain_q8 += (accel->accel_q8 * (speed_q8 - accel->threshold_q8)) >> 8;
+    }
+
+    return gain_q8 > accel->max_gain_q8 ? accel->max_gain_q8 : (int32_t)gain_q8;
+}
+
+static int32_t move_axis(int32_t position, int32_t* carry, int32_t delta, int32_t gain_q8, int32_t max) {
+    int64_t moved_q8 = (int64_t)delta * gain_q8 + *carry;
+    int64_t target   = position + (moved_q8 >> 8);
+
+    *carry = (int32_t)(moved_q8 & 0xFF);
+    // Pushing against an edge must not build up motion that is released when reversing
+    if (target < 0 || target > max) {
+        *carry = 0;
+        return target < 0 ? 0 : max;
+    }
+    return (int32_t)target;
+}
+
+/**
+ * @brief Moves the cursor by the summed motion of one frame
+ *
+ * @param[in] motion      Cursor
+ * @param[in] dx          Summed horizontal motion in counts
+ * @param[in] dy          Summed vertical motion in counts
+ * @param[in] elapsed_us  Time since the previous frame with motion
+ * @return true when the cursor moved by at least one pixel
+ */
+bool mouse_motion_apply(mouse_motion_t* motion, int32_t dx, int32_t dy, uint32_t elapsed_us) {
+    int32_t gain_q8 = mouse_motion_gain(&motion->accel, dx, dy, elapsed_us);
+    int32_t x       = move_axis(motion->x, &motion->carry_x, dx, gain_q8, motion->max_x);
+    int32_t y       = move_axis(motion->y, &motion->carry_y, dy, gain_q8, motion->max_y);
+    bool    moved   = x != motion->x || y != motion->y;
+
+    motion->x = x;
+    motion->y = y;
+    return moved;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Pointer acceleration curve, all gains in Q8 (256 = 1 pixel per count)
+ *
+ * The gain rises linearly with the pointer speed above a threshold and is capped:
+ * gain = sensitivity + accel * max(0, speed - threshold), speed in counts per millisecond.
+ */
+typedef struct {
+    int32_t sensitivity_q8;  // Gain of slow movements
+    int32_t accel_q8;        // Gain increase per count/ms above the threshold
+    int32_t threshold_q8;    // Speed in counts/ms (Q8) where acceleration starts
+    int32_t max_gain_q8;     // Upper bound of the gain
+} mouse_accel_t;
+
+/**
+ * @brief Cursor driven by coalesced mouse motion
+ *
+ * The motion of all reports in a frame is applied at once. Fractions of a pixel are carried
+ * over to the next frame so slow movements are not lost to rounding.
+ */
+typedef struct {
+    mouse_accel_t accel;
+    int32_t       max_x;    // Cursor bounds, inclusive
+    int32_t       max_y;
+    int32_t       x;        // Cursor position in pixels
+    int32_t       y;
+    int32_t       carry_x;  // Sub-pixel remainder in Q8, 0..255
+    int32_t       carry_y;
+} mouse_motion_t;
+
+void mouse_motion_init(mouse_motion_t* motion, const mouse_accel_t* accel, int32_t width, int32_t height);
+
+int32_t mouse_motion_gain(const mouse_accel_t* accel, int32_t dx, int32_t dy, uint32_t elapsed_us);
+
+bool mouse_motion_apply(mouse_motion_t* motion, int32_t dx, int32_t dy, uint32_t elapsed_us);
@@ -0,0 +1,119 @@
+// profile_store.c
+//
+// Caches device profiles (compiled report plan and gamepad calibration) in NVS, one blob per
+// USB VID/PID and interface number. The blob carries the hash and length of the report
+// descriptor it was made from, so a firmware update of the device invalidates it.
+
+#include "profile_store.h"
+#include <stdio.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+// Bump when device_profile_t or hid_plan_t change, older profiles are recompiled
+#define PROFILE_VERSION 1
+
+// Constants
+static char const TAG[]       = "profile";
+static char const NAMESPACE[] = "hid_profile";
+
+// Global variables
+static device_profile_t calibration_scratch;  // Too large for the stack of the input task
+
+static void make_key(uint16_t vid, uint16_t pid, uint8_t interface, char* key, size_t size) {
+    snprintf(key, size, "%04x%04x%02x", vid, pid, interface);
+}
+
+static esp_err_t read_profile(uint16_t vid, uint16_t pid, uint8_t interface, device_profile_t* profile) {
+    nvs_handle_t handle;
+    char         key[11];
+    size_t       size = sizeof(*profile);
+
+    esp_err_t res = nvs_open(NAMESPACE, NVS_READONLY, &handle);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    make_key(vid, pid, interface, key, sizeof(key));
+    res = nvs_get_blob(handle, key, profile, &size);
+    if (res == ESP_OK && (size != sizeof(*profile) || profile->version != PROFILE_VERSION)) {
+        ESP_LOGI(TAG, "Ignoring profile %s of an older firmware", key);
+        res = ESP_ERR_NVS_NOT_FOUND;
+    }
+    nvs_close(handle);
+
+    return res;
+}
+
+/**
+ * @brief Loads the cached profile of an interface
+ *
+ * @param[in]  vid          USB vendor ID
+ * @param[in]  pid          USB product ID
+ * @param[in]  interface    USB interface number
+ * @param[in]  desc_hash    hid_plan_descriptor_hash() of the current report descriptor
+ * @param[in]  desc_length  Length of the current report descriptor
+ * @param[out] profile      Cached profile
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND when there is no profile for this report descriptor, or
+ *         another NVS error
+ */
+esp_err_t device_profile_load(uint16_t vid, uint16_t pid, uint8_t interface, uint32_t desc_hash, size_t desc_length,
+                              device_profile_t* profile) {
+    esp_err_t res = read_profile(vid, pid, interface, profile);
+    if (res == ESP_OK && (profile->desc_hash != desc_hash || profile->desc_length != desc_length)) {
+        ESP_LOGI(TAG, "Report descriptor of %04x:%04x changed, recompiling", vid, pid);
+        res = ESP_ERR_NVS_NOT_FOUND;
+    }
+    return res;
+}
+
+/**
+ * @brief Stores the profile of an interface
+ *
+ * @param[in] vid        USB vendor ID
+ * @param[in] pid        USB product ID
+ * @param[in] interface  USB interface number
+ * @param[in] profile    Profile to store, the version is filled in
+ * @return ESP_OK or the NVS error
+ */
+esp_err_t device_profile_save(uint16_t vid, uint16_t pid, uint8_t interface, device_profile_t* profile) {
+    nvs_handle_t handle;
+    char         key[11];
+
+    esp_err_t res = nvs_open(NAMESPACE, NVS_READWRITE, &handle);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    profile->version = PROFILE_VERSION;
+    make_key(vid, pid, interface, key, sizeof(key));
+    res = nvs_set_blob(handle, key, profile, sizeof(*profile));
+    if (res == ESP_OK) {
+        res = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return res;
+}
+
+/**
+ * @brief Replaces the gamepad calibration in the cached profile of an interface
+ *
+ * Keeps the cache in step with gamepad_calibration_save(), only call from the input task.
+ *
+ * @param[in] vid          USB vendor ID
+ * @param[in] pid          USB product ID
+ * @param[in] interface    USB interface number
+ * @param[in] calibration  New calibration
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND when the interface has no profile, or another NVS error
+ */
+esp_err_t device_profile_save_calibration(uint16_t vid, uint16_t pid, uint8_t interface,
+                                          const gamepad_calibration_t* calibration) {
+    esp_err_t res = read_profile(vid, pid, interface, &calibration_scratch);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    calibration_scratch.has_calibration = true;
+    calibration_scratch.calibration     = *calibration;
+    return device_profile_save(vid, pid, interface, &calibration_scratch);
+}
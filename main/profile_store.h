@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "gamepad_condition.h"
+#include "hid_plan.h"
+
+/**
+ * @brief What is worked out about an interface at connect, cached for its next connect
+ *
+ * Valid for the report descriptor it was made from, identified by the descriptor hash and
+ * length.
+ */
+typedef struct {
+    uint32_t              version;  // Set by device_profile_save()
+    uint32_t              desc_hash;
+    uint32_t              desc_length;
+    bool                  has_plan;  // The report descriptor compiled, plan is valid
+    bool                  has_calibration;
+    hid_plan_t            plan;
+    gamepad_calibration_t calibration;  // Stored gamepad calibration of the VID/PID
+} device_profile_t;
+
+esp_err_t device_profile_load(uint16_t vid, uint16_t pid, uint8_t interface, uint32_t desc_hash, size_t desc_length,
+                              device_profile_t* profile);
+
+esp_err_t device_profile_save(uint16_t vid, uint16_t pid, uint8_t interface, device_profile_t* profile);
+
+esp_err_t device_profile_save_calibration(uint16_t vid, uint16_t pid, uint8_t interface,
+                                          const gamepad_calibration_t* calibration);
@@ -0,0 +1,113 @@
+// rate_meter.c
+//
+// Per-device report rate, interval jitter and missed poll estimation.
+// Intervals are accumulated per window of RATE_METER_WINDOW_US; long pauses (a mouse that
+// is not moved) are treated as idle and kept out of the statistics.
+
+#include "rate_meter.h"
+#include <math.h>
+#include <string.h>
+
+#define RATE_METER_IDLE_US 100000  // Idle threshold while the poll interval is still unknown
+
+/**
+ * @brief Resets a meter, called when a device connects
+ *
+ * @param[in] meter  Meter to reset
+ */
+void rate_meter_init(rate_meter_t* meter) {
+    memset(meter, 0, sizeof(*meter));
+    meter->last_us = -1;
+}
+
+/**
+ * @brief Snaps a measured interval to the closest interval USB can poll at
+ *
+ * @param[in] interval_us  Measured mean interval
+ * @return 125, 250, 500 or 1000 us below 1.5 ms, otherwise a whole number of milliseconds
+ */
+uint32_t rate_meter_snap_interval(uint32_t interval_us) {
+    if (interval_us == 0) {
+        return 0;
+    }
+
+    if (interval_us < 1500) {
+        uint32_t snapped = 125;
+        // Round in the log domain: move up while the next power of two is closer
+        while (snapped < 1000 && interval_us * interval_us > snapped * snapped * 2) {
+            snapped *= 2;
+        }
+        return snapped;
+    }
+
+    return (interval_us + 500) / 1000 * 1000;
+}
+
+static void publish_window(rate_meter_t* meter) {
+    rate_meter_stats_t* stats = &meter->stats;
+
+    if (meter->count > 0) {
+        uint64_t mean     = meter->sum_us / meter->count;
+        uint64_t mean_sq  = meter->sum_sq_us / meter->count;
+        uint64_t variance = mean_sq > mean * mean ? mean_sq - mean * mean : 0;
+
+        stats->rate_hz          = mean > 0 ? (1000000 + mean / 2) / mean : 0;
+        stats->poll_interval_us = rate_meter_snap_interval(mean);
+        stats->jitter_us        = (uint32_t)sqrt((double)variance);
+        stats->max_gap_us       = meter->max_gap_us;
+    } else {
+        stats->rate_hz    = 0;
+        stats->jitter_us  = 0;
+        stats->max_gap_us = 0;
+    }
+    stats->missed        = meter->missed;
+    stats->missed_total += meter->missed;
+
+    meter->count      = 0;
+    meter->sum_us     = 0;
+    meter->sum_sq_us  = 0;
+    meter->max_gap_us = 0;
+    meter->missed     = 0;
+}
+
+/**
+ * @brief Adds the arrival time of a report
+ *
+ * @param[in] meter         Meter of the device
+ * @param[in] timestamp_us  Arrival time of the report
+ * @return true when a window completed and meter->stats was updated
+ */
+bool rate_meter_add(rate_meter_t* meter, int64_t timestamp_us) {
+    if (meter->last_us < 0) {
+        meter->last_us         = timestamp_us;
+        meter->window_start_us = timestamp_us;
+        return false;
+    }
+
+    uint32_t interval = timestamp_us > meter->last_us ? (uint32_t)(timestamp_us - meter->last_us) : 0;
+    uint32_t poll     = meter->stats.poll_interval_us;
+    uint32_t idle_us  = poll > 0 ? poll * RATE_METER_IDLE_GAPS : RATE_METER_IDLE_US;
+
+    meter->last_us = timestamp_us;
+
+    if (interval < idle_us) {
+        meter->count++;
+        meter->sum_us    += interval;
+        meter->sum_sq_us += (uint64_t)interval * interval;
+        if (interval > meter->max_gap_us) {
+            meter->max_gap_us = interval;
+        }
+        // A report arriving well after the next poll was due means at least one poll was missed
+        if (poll > 0 && interval * 2 > poll * 3) {
+            meter->missed += (interval + poll / 2) / poll - 1;
+        }
+    }
+
+    if (timestamp_us - meter->window_start_us >= RATE_METER_WINDOW_US) {
+        publish_window(meter);
+        meter->window_start_us = timestamp_us;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RATE_METER_WINDOW_US 1000000  // Statistics are published once per window
+#define RATE_METER_IDLE_GAPS 8        // Gaps longer than this many poll intervals are idle, not missed polls
+
+/**
+ * @brief Report rate statistics of one complete window
+ */
+typedef struct {
+    uint32_t rate_hz;           // Reports per second while the device is sending
+    uint32_t poll_interval_us;  // Estimated endpoint polling interval, 0 while unknown
+    uint32_t jitter_us;         // Standard deviation of the report interval
+    uint32_t max_gap_us;        // Longest interval that was not idle
+    uint32_t missed;            // Suspected missed polls in the window
+    uint32_t missed_total;      // Suspected missed polls since connect
+} rate_meter_stats_t;
+
+/**
+ * @brief Report rate and jitter meter
+ *
+ * Fed with report arrival timestamps. The polling interval (bInterval) is not exposed by the
+ * HID host driver, so it is estimated from the mean interval and snapped to the intervals USB
+ * can schedule (125 us * 2^n below 1 ms, whole milliseconds above).
+ */
+typedef struct {
+    int64_t            last_us;
+    int64_t            window_start_us;
+    uint32_t           count;  // Non-idle intervals in the current window
+    uint64_t           sum_us;
+    uint64_t           sum_sq_us;
+    uint32_t           max_gap_us;
+    uint32_t           missed;
+    rate_meter_stats_t stats;  // Results of the last complete window
+} rate_meter_t;
+
+void rate_meter_init(rate_meter_t* meter);
+
+bool rate_meter_add(rate_meter_t* meter, int64_t timestamp_us);
+
+uint32_t rate_meter_snap_interval(uint32_t interval_us);
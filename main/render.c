@@ -0,0 +1,1033 @@
+// render.c
+//
+// Display ownership and the frame-capped render task.
+// All drawing happens here; the input task only publishes the view into input_state and the
+// decoded input into the input snapshot, which is read without taking a lock.
+// With CONFIG_HID_FRAMEBUFFER_STRIPS there is no full framebuffer: draw calls are recorded in
+// a draw list and replayed into a strip buffer of a few rows for every damaged band.
+
+#include "render.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bsp/display.h"
+#include "damage.h"
+#include "draw_list.h"
+#include "epaper_schedule.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal/lcd_types.h"
+#include "hid_device.h"
+#include "hid_input_usb.h"
+#include "input_state.h"
+#include "latency.h"
+#include "mouse_motion.h"
+#include "pax_fonts.h"
+#include "pax_gfx.h"
+#include "pax_text.h"
+#include "text_cache.h"
+
+// Constants
+static char const TAG[] = "render";
+
+// Global variables
+static size_t                       display_h_res        = 0;
+static size_t                       display_v_res        = 0;
+static lcd_color_rgb_pixel_format_t display_color_format = LCD_COLOR_PIXEL_FORMAT_RGB565;
+static lcd_rgb_data_endian_t        display_data_endian  = LCD_RGB_DATA_ENDIAN_LITTLE;
+static pax_buf_t                    fb                   = {0};
+static pax_buf_type_t               fb_format            = PAX_BUF_16_565RGB;
+static uint8_t                      fb_bits_per_pixel    = 16;
+static int                          screen_width         = 0;  // User (oriented) size of the screen
+static int                          screen_height        = 0;
+static input_state_t                frame_state          = {0};
+static hid_input_state_t            frame_input          = {0};  // Snapshot read with frame_state
+
+#if defined(CONFIG_BSP_TARGET_KAMI)
+#define BLACK 0
+#define WHITE 1
+#define RED   2
+#else
+#define BLACK 0xFF000000
+#define WHITE 0xFFFFFFFF
+#define RED   0xFFFF0000
+#endif
+
+#if defined(CONFIG_BSP_TARGET_KAMI)
+static pax_col_t palette[] = {0xffffffff, 0xff000000, 0xffff0000};  // white, black, red
+#endif
+
+#define FONT      pax_font_sky_mono
+#define FONT_SIZE 16
+
+/**
+ * @brief Text label that is only redrawn where its content changes
+ *
+ * The font is monospaced, so a label is a row of character cells: only cells whose character
+ * changed are erased and redrawn.
+ */
+typedef struct {
+    int  x, y;
+    char text[3 * INPUT_STATE_RAW_MAX];
+} ui_label_t;
+
+/**
+ * @brief Fixed width field inside the row of a caption label
+ */
+typedef struct {
+    ui_label_t* row;
+    uint8_t     column;  // First cell of the field in the row
+    uint8_t     cells;
+    ui_label_t  label;
+} ui_field_t;
+
+// Character cell of the label font, measured at init
+static float cell_width  = 8;
+static int   cell_height = FONT_SIZE;
+
+#if CONFIG_HID_TEXT_CACHE
+static text_cache_t       glyph_cache;
+static text_cache_entry_t glyph_cache_entries[CONFIG_HID_TEXT_CACHE_ENTRIES];
+#endif
+
+static ui_label_t status_label  = {.x = 0, .y = 18};
+static ui_label_t hex_label     = {.x = 10, .y = 180};
+static ui_label_t keys_label    = {.x = 10, .y = 10};
+static ui_label_t mouse_label   = {.x = 0, .y = 18};
+static ui_label_t buttons_label = {.x = 10, .y = 10};
+static ui_label_t report_label  = {.x = 10, .y = 26};
+static ui_label_t axes_label    = {.x = 10, .y = 42};
+static ui_label_t latency_label = {.x = 10, .y = 200};
+
+static ui_label_t* const labels[] = {
+    &status_label, &hex_label, &keys_label, &mouse_label, &buttons_label, &report_label, &axes_label, &latency_label,
+};
+
+// Captions with the values drawn into the gaps, so a changing value never touches the caption
+static char const MOUSE_CAPTION[] = "Mouse X:        Y:                Scroll:      Tilt:";
+static char const AXES_CAPTION[]  = "Axes: LX=    LY=    RX=    RY=    LT=    RT=";
+
+enum { MOUSE_X, MOUSE_Y, MOUSE_BUTTONS, MOUSE_SCROLL, MOUSE_TILT, MOUSE_FIELDS };
+
+static ui_field_t mouse_fields[MOUSE_FIELDS] = {
+    [MOUSE_X]       = {.row = &mouse_label, .column = 9, .cells = 6},
+    [MOUSE_Y]       = {.row = &mouse_label, .column = 19, .cells = 6},
+    [MOUSE_BUTTONS] = {.row = &mouse_label, .column = 26, .cells = 7},
+    [MOUSE_SCROLL]  = {.row = &mouse_label, .column = 42, .cells = 4},
+    [MOUSE_TILT]    = {.row = &mouse_label, .column = 53, .cells = 4},
+};
+
+static ui_field_t axes_fields[GAMEPAD_AXES] = {
+    {.row = &axes_label, .column = 9, .cells = 3},  {.row = &axes_label, .column = 16, .cells = 3},
+    {.row = &axes_label, .column = 23, .cells = 3}, {.row = &axes_label, .column = 30, .cells = 3},
+    {.row = &axes_label, .column = 37, .cells = 3}, {.row = &axes_label, .column = 44, .cells = 3},
+};
+
+// One line of report rate statistics per device slot, below the latency overlay
+#define RATE_LABEL_Y      220
+#define RATE_LABEL_HEIGHT 18
+static ui_label_t rate_labels[CONFIG_HID_MAX_DEVICES];
+
+// Area covered by the stick markers and trigger bars of draw_gamepad_visual
+static const pax_recti  gamepad_visual_area  = {.x = 100, .y = 76, .w = 160, .h = 72};
+static gamepad_report_t gamepad_visual_shown = {0};
+static bool             gamepad_visual_valid = false;
+
+static input_view_t shown_view = INPUT_VIEW_STATUS;
+
+// Mouse cursor, moved once per frame by the motion coalesced in input_state
+#define CURSOR_SIZE      5
+#define PERCENT_TO_Q8(p) ((p) * 256 / 100)
+static mouse_motion_t cursor          = {0};
+static int64_t        cursor_moved_us = 0;  // Frame of the previous cursor update
+static int32_t        pointer_x_taken = 0;  // Pointer of the snapshot the cursor was last moved to
+static int32_t        pointer_y_taken = 0;
+static pax_recti      cursor_shown    = {0};
+static bool           cursor_visible  = false;
+static bool           cursor_erased   = false;  // Something was drawn over the shown cursor this frame
+
+#if CONFIG_HID_LATENCY_OVERLAY
+static char    latency_text[128] = {0};
+static int64_t latency_updated   = 0;
+#endif
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+static draw_list_t scene;
+static draw_op_t   scene_ops[CONFIG_HID_DRAW_LIST_OPS];
+static char        scene_text[CONFIG_HID_DRAW_LIST_TEXT_SIZE];
+static int         strip_lines    = CONFIG_HID_STRIP_LINES;
+static uint32_t    scene_rebuilds = 0;
+#endif
+
+// Drawing primitives, recorded in the draw list when rendering in strips
+
+static void draw_rect(pax_col_t color, int x, int y, int width, int height) {
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    draw_list_rect(&scene, color, x, y, width, height);
+#else
+    pax_simple_rect(&fb, color, x, y, width, height);
+#endif
+}
+
+static void draw_circle(pax_col_t color, int x, int y, int radius) {
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    draw_list_circle(&scene, color, x, y, radius);
+#else
+    pax_draw_circle(&fb, color, x, y, radius);
+#endif
+}
+
+static void draw_text(int x, int y, int width, const char* text) {
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    draw_list_text(&scene, BLACK, x, y, width, cell_height, text);
+#else
+    pax_draw_text(&fb, BLACK, FONT, FONT_SIZE, x, y, text);
+#endif
+}
+
+static inline bool rect_overlaps(int x, int y, int width, int height, const pax_recti* rect) {
+    return x < rect->x + rect->w && rect->x < x + width && y < rect->y + rect->h && rect->y < y + height;
+}
+
+static void fill_rect(int x, int y, int width, int height) {
+    draw_rect(WHITE, x, y, width, height);
+    damage_add(x, y, width, height);
+    if (cursor_visible && rect_overlaps(x, y, width, height, &cursor_shown)) {
+        cursor_erased = true;
+    }
+}
+
+static void cls(void) {
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    draw_list_reset(&scene);
+#else
+    pax_simple_rect(&fb, WHITE, 0, 0, screen_width, screen_height);
+#endif
+    damage_add_all();
+
+    for (size_t i = 0; i < sizeof(labels) / sizeof(labels[0]); i++) {
+        labels[i]->text[0] = '\0';
+    }
+    for (size_t i = 0; i < MOUSE_FIELDS; i++) {
+        mouse_fields[i].label.text[0] = '\0';
+    }
+    for (size_t i = 0; i < GAMEPAD_AXES; i++) {
+        axes_fields[i].label.text[0] = '\0';
+    }
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        rate_labels[i] = (ui_label_t){.x = 10, .y = RATE_LABEL_Y + i * RATE_LABEL_HEIGHT};
+    }
+    gamepad_visual_valid = false;
+    cursor_visible       = false;
+    cursor_erased        = false;
+}
+
+static inline int cell_x(const ui_label_t* label, size_t cell) {
+    return label->x + (int)(cell * cell_width + 0.5f);
+}
+
+#if CONFIG_HID_TEXT_CACHE
+static void* render_glyph(void* ctx, const void* font, uint16_t size, const char* text, int* width, int* height,
+                          size_t* bytes) {
+    pax_vec2f  extent = pax_text_size(font, size, text);
+    pax_buf_t* buf    = malloc(sizeof(pax_buf_t));
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    *width  = (int)(extent.x + 0.999f);
+    *height = (int)(extent.y + 0.999f);
+    if (!pax_buf_init(buf, NULL, *width, *height, fb_format)) {
+        free(buf);
+        return NULL;
+    }
+    pax_buf_reversed(buf, display_data_endian == LCD_RGB_DATA_ENDIAN_BIG);
+    pax_background(buf, WHITE);
+    pax_draw_text(buf, BLACK, font, size, 0, 0, text);
+
+    *bytes = sizeof(pax_buf_t) + ((size_t)*width * *height * fb_bits_per_pixel + 7) / 8;
+    return buf;
+}
+
+static void destroy_glyph(void* ctx, void* surface) {
+    pax_buf_destroy(surface);
+    free(surface);
+}
+#endif
+
+/**
+ * @brief Draws the characters of a label in the cells [start, end)
+ *
+ * Glyphs are copied from the glyph cache when it is enabled, rasterizing each distinct
+ * character only once.
+ */
+static void draw_cells(const ui_label_t* label, size_t start, size_t end) {
+#if CONFIG_HID_TEXT_CACHE
+    for (size_t i = start; i < end; i++) {
+        char glyph[2] = {label->text[i], '\0'};
+        if (glyph[0] == ' ') {
+            continue;
+        }
+
+        const text_cache_entry_t* entry = text_cache_get(&glyph_cache, FONT, FONT_SIZE, glyph);
+        if (entry != NULL) {
+            pax_draw_image_op(&fb, entry->surface, cell_x(label, i), label->y);
+        } else {
+            pax_draw_text(&fb, BLACK, FONT, FONT_SIZE, cell_x(label, i), label->y, glyph);
+        }
+    }
+#else
+    char run[sizeof(label->text)];
+    memcpy(run, label->text + start, end - start);
+    run[end - start] = '\0';
+    draw_text(cell_x(label, start), label->y, cell_x(label, end) - cell_x(label, start), run);
+#endif
+}
+
+/**
+ * @brief Replaces the text of a label, redrawing only the cells that changed
+ *
+ * @param[in] label  Label to update
+ * @param[in] text   New text
+ */
+static void label_set(ui_label_t* label, const char* text) {
+    size_t old_length = strlen(label->text);
+    size_t new_length = strnlen(text, sizeof(label->text) - 1);
+    size_t cells      = old_length > new_length ? old_length : new_length;
+    size_t i          = 0;
+
+    while (i < cells) {
+        if (i < old_length && i < new_length && label->text[i] == text[i]) {
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < cells && !(i < old_length && i < new_length && label->text[i] == text[i])) {
+            label->text[i] = i < new_length ? text[i] : '\0';
+            i++;
+        }
+
+        fill_rect(cell_x(label, start), label->y, cell_x(label, i) - cell_x(label, start), cell_height);
+        if (start < new_length) {
+            draw_cells(label, start, i < new_length ? i : new_length);
+        }
+    }
+
+    label->text[new_length] = '\0';
+}
+
+/**
+ * @brief Draws the characters of a label again that lie in an erased area
+ *
+ * @param[in] label  Label
+ * @param[in] area   Area that was filled with the background
+ */
+static void label_redraw_area(const ui_label_t* label, const pax_recti* area) {
+    size_t length = strlen(label->text);
+    if (!rect_overlaps(label->x, label->y, cell_x(label, length) - label->x, cell_height, area)) {
+        return;
+    }
+
+    size_t start = 0;
+    while (start < length && cell_x(label, start + 1) <= area->x) {
+        start++;
+    }
+    size_t end = start;
+    while (end < length && cell_x(label, end) < area->x + area->w) {
+        end++;
+    }
+    if (start < end) {
+        draw_cells(label, start, end);
+    }
+}
+
+/**
+ * @brief Draws the labels of all views again where they lie in an erased area
+ *
+ * Labels of other views are empty, so only what is on the screen is drawn.
+ *
+ * @param[in] area  Area that was filled with the background
+ */
+static void labels_redraw_area(const pax_recti* area) {
+    for (size_t i = 0; i < sizeof(labels) / sizeof(labels[0]); i++) {
+        label_redraw_area(labels[i], area);
+    }
+    for (size_t i = 0; i < MOUSE_FIELDS; i++) {
+        label_redraw_area(&mouse_fields[i].label, area);
+    }
+    for (size_t i = 0; i < GAMEPAD_AXES; i++) {
+        label_redraw_area(&axes_fields[i].label, area);
+    }
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        label_redraw_area(&rate_labels[i], area);
+    }
+}
+
+/**
+ * @brief Shows a value right aligned in a field, only the changed digits are redrawn
+ *
+ * @param[in] field  Field to update
+ * @param[in] value  Value to show, '#' fills the field when it does not fit
+ */
+static void field_set_number(ui_field_t* field, int32_t value) {
+    char text[12];
+
+    if (snprintf(text, sizeof(text), "%*ld", field->cells, (long)value) > field->cells) {
+        memset(text, '#', field->cells);
+        text[field->cells] = '\0';
+    }
+
+    field->label.x = cell_x(field->row, field->column);
+    field->label.y = field->row->y;
+    label_set(&field->label, text);
+}
+
+static void field_set_text(ui_field_t* field, const char* text) {
+    field->label.x = cell_x(field->row, field->column);
+    field->label.y = field->row->y;
+    label_set(&field->label, text);
+}
+
+static void draw_hex_line(const input_state_t* state) {
+    char  hex_string[3 * INPUT_STATE_RAW_MAX] = {0};
+    char* p                                   = hex_string;
+
+    for (size_t i = 0; i < state->raw_length; i++) {
+        p += sprintf(p, "%02X ", state->raw[i]);
+    }
+    if (p > hex_string) *(p - 1) = '\0';
+
+    label_set(&hex_label, hex_string);
+}
+
+static void draw_keyboard(const hid_input_state_t* input) {
+    char   text[64] = {0};
+    size_t used     = 0;
+
+    // Held keys in usage order, as many as fit on the line
+    for (unsigned int w = 0; w < KEY_BITMAP_WORDS && used + 3 < sizeof(text); w++) {
+        uint32_t bits = input->keys.words[w];
+        while (bits && used + 3 < sizeof(text)) {
+            used += snprintf(text + used, sizeof(text) - used, "%02X ", w * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    label_set(&keys_label, text);
+}
+
+/**
+ * @brief Applies the pointer motion of all reports since the previous update to the cursor
+ *
+ * @param[in] input  Snapshot taken for this frame
+ * @param[in] now    Start of the frame
+ */
+static void update_cursor(const hid_input_state_t* input, int64_t now) {
+    // The pointer only counts up, differences stay right when it wraps
+    int32_t dx = (int32_t)((uint32_t)input->pointer.x - (uint32_t)pointer_x_taken);
+    int32_t dy = (int32_t)((uint32_t)input->pointer.y - (uint32_t)pointer_y_taken);
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+
+    int64_t elapsed = now - cursor_moved_us;
+    cursor_moved_us = now;
+    pointer_x_taken = input->pointer.x;
+    pointer_y_taken = input->pointer.y;
+
+    mouse_motion_apply(&cursor, dx, dy, elapsed < 1000000 ? (uint32_t)elapsed : 1000000);
+}
+
+static void draw_mouse(const hid_input_state_t* input) {
+    mouse_report_t rpt = {0};
+    char           buttons[8];
+
+    rpt.buttons.val = input->pointer.buttons;
+    snprintf(buttons, sizeof(buttons), "|%c|%c|%c|", (rpt.buttons.button1 ? 'o' : ' '),
+             (rpt.buttons.button3 ? 'o' : ' '), (rpt.buttons.button2 ? 'o' : ' '));
+
+    label_set(&mouse_label, MOUSE_CAPTION);
+    field_set_number(&mouse_fields[MOUSE_X], cursor.x);
+    field_set_number(&mouse_fields[MOUSE_Y], cursor.y);
+    field_set_text(&mouse_fields[MOUSE_BUTTONS], buttons);
+    field_set_number(&mouse_fields[MOUSE_SCROLL], input->pointer.scroll);
+    field_set_number(&mouse_fields[MOUSE_TILT], input->pointer.tilt);
+}
+
+/**
+ * @brief Moves the cursor, drawn after everything else of the frame so it stays on top
+ *
+ * The labels under its previous position are drawn again, and it is drawn again when a label
+ * update erased it.
+ */
+static void draw_cursor(void) {
+    if (cursor_visible && !cursor_erased && cursor_shown.x == cursor.x && cursor_shown.y == cursor.y) {
+        return;
+    }
+    if (cursor_visible && (cursor_shown.x != cursor.x || cursor_shown.y != cursor.y)) {
+        fill_rect(cursor_shown.x, cursor_shown.y, CURSOR_SIZE, CURSOR_SIZE);
+        labels_redraw_area(&cursor_shown);
+    }
+    draw_rect(BLACK, cursor.x, cursor.y, CURSOR_SIZE, CURSOR_SIZE);
+    damage_add(cursor.x, cursor.y, CURSOR_SIZE, CURSOR_SIZE);
+    cursor_shown   = (pax_recti){.x = cursor.x, .y = cursor.y, .w = CURSOR_SIZE, .h = CURSOR_SIZE};
+    cursor_visible = true;
+    cursor_erased  = false;
+}
+
+static void draw_gamepad_visual(const gamepad_report_t* rpt) {
+    if (gamepad_visual_valid && rpt->lx == gamepad_visual_shown.lx && rpt->ly == gamepad_visual_shown.ly &&
+        rpt->rx == gamepad_visual_shown.rx && rpt->ry == gamepad_visual_shown.ry &&
+        rpt->lt == gamepad_visual_shown.lt && rpt->rt == gamepad_visual_shown.rt) {
+        return;
+    }
+
+    fill_rect(gamepad_visual_area.x, gamepad_visual_area.y, gamepad_visual_area.w, gamepad_visual_area.h);
+    gamepad_visual_shown = *rpt;
+    gamepad_visual_valid = true;
+
+    const int center_y = 120;
+
+    const int l_center_x = 130;
+    draw_circle(RED, l_center_x, center_y, 12);
+
+    int lx_offset = ((int)rpt->lx - 128) / 6;
+    int ly_offset = ((int)rpt->ly - 128) / 6;
+    draw_circle(BLACK, l_center_x + lx_offset, center_y + ly_offset, 3);
+
+    const int bar_w     = 10;
+    const int bar_h_max = 40;
+
+    const int lt_x = 170;
+    int       lt_h = (rpt->lt * bar_h_max) / 255;
+    draw_rect(BLACK, lt_x, center_y - lt_h, bar_w, lt_h);
+
+    const int rt_x = 190;
+    int       rt_h = (rpt->rt * bar_h_max) / 255;
+    draw_rect(BLACK, rt_x, center_y - rt_h, bar_w, rt_h);
+
+    const int r_center_x = 230;
+    draw_circle(RED, r_center_x, center_y, 12);
+
+    int rx_offset = ((int)rpt->rx - 128) / 6;
+    int ry_offset = ((int)rpt->ry - 128) / 6;
+    draw_circle(BLACK, r_center_x + rx_offset, center_y + ry_offset, 3);
+}
+
+/**
+ * @brief Shows the pad of the device that sent the newest report
+ *
+ * @param[in] state  State being drawn
+ * @param[in] input  Snapshot taken with the state
+ */
+static void draw_gamepad(const input_state_t* state, const hid_input_state_t* input) {
+    uint8_t device_id = state->origin.device_id;
+    if (device_id >= HID_INPUT_SNAPSHOT_DEVICES || !input->pads[device_id].valid) {
+        if (gamepad_visual_valid) {
+            fill_rect(gamepad_visual_area.x, gamepad_visual_area.y, gamepad_visual_area.w, gamepad_visual_area.h);
+            gamepad_visual_valid = false;
+        }
+        label_set(&buttons_label, "");
+        label_set(&report_label, "");
+        label_set(&axes_label, "");
+        return;
+    }
+
+    const gamepad_report_t* rpt = &input->pads[device_id].report;
+    const uint8_t           axes[GAMEPAD_AXES] = {rpt->lx, rpt->ly, rpt->rx, rpt->ry, rpt->lt, rpt->rt};
+    char                    line1[64], button_line[128];
+
+    gamepad_format_buttons(rpt, button_line, sizeof(button_line));
+    snprintf(line1, sizeof(line1), "Report ID: 0x%02X | Length: %2d", rpt->report_id, (int)state->raw_length);
+
+    draw_gamepad_visual(rpt);
+    label_set(&buttons_label, button_line);
+    label_set(&report_label, line1);
+    label_set(&axes_label, AXES_CAPTION);
+    for (size_t i = 0; i < GAMEPAD_AXES; i++) {
+        field_set_number(&axes_fields[i], axes[i]);
+    }
+}
+
+/**
+ * @brief Shows the latency percentiles of the device that produced the state
+ *
+ * The text is recomputed at most every CONFIG_HID_LATENCY_OVERLAY_INTERVAL_MS so the overlay
+ * does not add a redraw to every frame it measures.
+ *
+ * @param[in] state  State being drawn
+ */
+static void draw_latency_overlay(const input_state_t* state) {
+#if CONFIG_HID_LATENCY_OVERLAY
+    if (state->origin.arrival_us == 0) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (latency_text[0] == '\0' || now - latency_updated >= CONFIG_HID_LATENCY_OVERLAY_INTERVAL_MS * 1000LL) {
+        latency_format(state->origin.device_id, latency_text, sizeof(latency_text));
+        latency_updated = now;
+    }
+
+    label_set(&latency_label, latency_text);
+#endif
+}
+
+/**
+ * @brief Shows the report rate, jitter and missed polls of every connected device
+ *
+ * The statistics change once per second per device, labels are only redrawn then.
+ *
+ * @param[in] state  State being drawn
+ */
+static void draw_rate_overlay(const input_state_t* state) {
+#if CONFIG_HID_RATE_OVERLAY
+    char text[128];
+
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        const rate_meter_stats_t* rate = &state->devices[i].rate;
+
+        if (!state->devices[i].connected) {
+            text[0] = '\0';
+        } else if (rate->poll_interval_us == 0) {
+            snprintf(text, sizeof(text), "Device %u: measuring", (unsigned)i);
+        } else {
+            snprintf(text, sizeof(text),
+                     "Device %u: %lu Hz (poll %lu us) jitter %lu us, max gap %lu us, missed %lu/%lu", (unsigned)i,
+                     (unsigned long)rate->rate_hz, (unsigned long)rate->poll_interval_us,
+                     (unsigned long)rate->jitter_us, (unsigned long)rate->max_gap_us, (unsigned long)rate->missed,
+                     (unsigned long)rate->missed_total);
+        }
+
+        label_set(&rate_labels[i], text);
+    }
+#endif
+}
+
+/**
+ * @brief Brings the screen up to date with the given state
+ *
+ * A view switch clears the screen; within a view only labels and widgets whose content
+ * changed are redrawn, and only their areas are marked as damaged.
+ *
+ * @param[in] state  State to draw
+ * @param[in] input  Snapshot of the decoded input taken with the state
+ */
+static void draw_state(const input_state_t* state, const hid_input_state_t* input) {
+    if (state->view != shown_view) {
+        cls();
+        shown_view = state->view;
+    }
+
+    switch (state->view) {
+        case INPUT_VIEW_KEYBOARD:
+            draw_hex_line(state);
+            draw_keyboard(input);
+            break;
+        case INPUT_VIEW_MOUSE:
+            draw_hex_line(state);
+            draw_mouse(input);
+            break;
+        case INPUT_VIEW_GAMEPAD:
+            draw_hex_line(state);
+            draw_gamepad(state, input);
+            break;
+        case INPUT_VIEW_STATUS:
+        default:
+            label_set(&status_label, state->status);
+            break;
+    }
+
+    draw_latency_overlay(state);
+    draw_rate_overlay(state);
+
+    if (state->view == INPUT_VIEW_MOUSE) {
+        draw_cursor();
+    }
+}
+
+/**
+ * @brief Draws the state for a frame
+ *
+ * When rendering in strips and the draw list overflowed, the screen is drawn again from
+ * scratch, which leaves only the calls for what is visible now in the list.
+ *
+ * @param[in] state  State to draw
+ * @param[in] input  Snapshot of the decoded input taken with the state
+ */
+static void draw_frame(const input_state_t* state, const hid_input_state_t* input) {
+    draw_state(state, input);
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    if (scene.overflow) {
+        cls();
+        draw_state(state, input);
+        scene_rebuilds++;
+        if (scene.overflow) {
+            ESP_LOGW(TAG, "Screen does not fit the draw list (%d ops, %d bytes of text)", CONFIG_HID_DRAW_LIST_OPS,
+                     CONFIG_HID_DRAW_LIST_TEXT_SIZE);
+        }
+    }
+#endif
+}
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+/**
+ * @brief Replays the draw list into the strip buffer for the band of rows starting at y
+ *
+ * @param[in] y    First user row of the band
+ * @param[in] arg  Not used
+ */
+static void render_strip(int y, void* arg) {
+    pax_background(&fb, WHITE);
+
+    for (size_t i = 0; i < scene.count; i++) {
+        const draw_op_t* op = &scene.ops[i];
+        if (!draw_op_in_rows(op, y, y + strip_lines)) {
+            continue;
+        }
+
+        switch (op->kind) {
+            case DRAW_OP_RECT:
+                pax_simple_rect(&fb, op->color, op->x, op->y - y, op->w, op->h);
+                break;
+            case DRAW_OP_CIRCLE:
+                pax_draw_circle(&fb, op->color, op->x + op->w / 2, op->y - y + op->h / 2, op->w / 2);
+                break;
+            case DRAW_OP_TEXT:
+                pax_draw_text(&fb, op->color, FONT, FONT_SIZE, op->x, op->y - y, draw_list_op_text(&scene, op));
+                break;
+            default:
+                break;
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Sends the damaged parts of the screen to the display
+ *
+ * @param[in] done      Called once the damage reached the display, may be NULL
+ * @param[in] done_arg  Passed to done
+ */
+static void send_damage(damage_done_cb_t done, void* done_arg) {
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    damage_flush_strips(strip_lines, render_strip, NULL, done, done_arg);
+#else
+    damage_flush(done, done_arg);
+#endif
+}
+
+static void log_stats(int64_t now, int64_t* last_log, input_stats_t* last, uint64_t* last_bytes) {
+#if CONFIG_HID_STATS_LOG_INTERVAL_MS > 0
+    if (now - *last_log < CONFIG_HID_STATS_LOG_INTERVAL_MS * 1000LL) {
+        return;
+    }
+
+    input_stats_t stats;
+    input_state_get_stats(&stats);
+
+    uint64_t bytes = damage_get_bytes_blitted();
+
+    int64_t elapsed_ms = (now - *last_log) / 1000;
+    ESP_LOGI(TAG, "reports received: %lu (%lu/s), frames drawn: %lu (%lu/s), blitted: %lu bytes/s",
+             (unsigned long)stats.reports_received,
+             (unsigned long)((stats.reports_received - last->reports_received) * 1000LL / elapsed_ms),
+             (unsigned long)stats.frames_drawn,
+             (unsigned long)((stats.frames_drawn - last->frames_drawn) * 1000LL / elapsed_ms),
+             (unsigned long)((bytes - *last_bytes) * 1000LL / elapsed_ms));
+
+    for (size_t i = 0; i < CONFIG_HID_MAX_DEVICES; i++) {
+        hid_device_t* device = hid_device_get(i);
+        if (device != NULL) {
+            const rate_meter_stats_t* rate = &frame_state.devices[i].rate;
+            ESP_LOGI(TAG, "device %u: queued %u, high watermark %lu/%d, dropped %lu, %lu Hz, missed polls %lu",
+                     (unsigned)i, (unsigned)report_ring_count(&device->ring),
+                     (unsigned long)report_ring_high_watermark(&device->ring), CONFIG_HID_REPORT_RING_DEPTH,
+                     (unsigned long)report_ring_dropped(&device->ring), (unsigned long)rate->rate_hz,
+                     (unsigned long)rate->missed_total);
+        }
+    }
+
+    // Peak of the internal heap since boot, the figure that limits the small targets
+    size_t heap_total = heap_caps_get_total_size(MALLOC_CAP_INTERNAL);
+    ESP_LOGI(TAG, "internal heap: %u bytes free, peak use %u of %u bytes",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)(heap_total - heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)), (unsigned)heap_total);
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    ESP_LOGI(TAG, "draw list: %u ops (peak %u/%d), %u/%d bytes of text, rebuilds %lu", (unsigned)scene.count,
+             (unsigned)scene.peak, CONFIG_HID_DRAW_LIST_OPS, (unsigned)scene.text_used, CONFIG_HID_DRAW_LIST_TEXT_SIZE,
+             (unsigned long)scene_rebuilds);
+#endif
+
+#if CONFIG_HID_TEXT_CACHE
+    ESP_LOGI(TAG, "glyph cache: %u bytes, hits %lu, misses %lu, evictions %lu", (unsigned)glyph_cache.bytes,
+             (unsigned long)glyph_cache.hits, (unsigned long)glyph_cache.misses,
+             (unsigned long)glyph_cache.evictions);
+#endif
+
+    *last       = stats;
+    *last_bytes = bytes;
+    *last_log   = now;
+#endif
+}
+
+/**
+ * @brief Stage timestamps of a drawn frame, completed when its blit is done
+ */
+typedef struct {
+    uint8_t device_id;
+    int64_t arrival_us;
+    int64_t parsed_us;
+    int64_t drawn_us;
+} frame_sample_t;
+
+static frame_sample_t frame_samples[2];
+static uint32_t       frame_sample_index = 0;
+
+static void record_frame_latency(int64_t blitted_us, void* arg) {
+    const frame_sample_t* sample = arg;
+    latency_record(sample->device_id, sample->arrival_us, sample->parsed_us, sample->drawn_us, blitted_us);
+}
+
+/**
+ * @brief Sends the damage of the frame just drawn to the display
+ *
+ * @param[in] drawn_us        Time the frame was drawn
+ * @param[in] record_latency  Record the latency of the newest report in frame_state
+ */
+static void flush_frame(int64_t drawn_us, bool record_latency) {
+    if (record_latency && frame_state.origin.arrival_us != 0) {
+        // Alternating samples: the blit of the previous frame is complete before this one is queued
+        frame_sample_t* sample = &frame_samples[frame_sample_index++ & 1];
+        sample->device_id      = frame_state.origin.device_id;
+        sample->arrival_us     = frame_state.origin.arrival_us;
+        sample->parsed_us      = frame_state.origin.parsed_us;
+        sample->drawn_us       = drawn_us;
+        send_damage(record_frame_latency, sample);
+    } else {
+        send_damage(NULL, NULL);
+    }
+}
+
+/**
+ * @brief Render task
+ *
+ * Wakes at CONFIG_HID_RENDER_FPS and redraws the screen only when new input was published
+ * since the previous frame. Only the damaged regions are sent to the display. The latency of
+ * the newest report in each frame is recorded once the frame has been blitted.
+ *
+ * With the e-paper schedule the newest state is still taken every period, so mouse motion is
+ * accumulated and the event stream is unaffected, but it is only drawn when a refresh is due.
+ *
+ * @param[in] arg  Not used
+ */
+static void render_task(void* arg) {
+    TickType_t period = pdMS_TO_TICKS(1000 / CONFIG_HID_RENDER_FPS);
+    if (period == 0) {
+        period = 1;
+    }
+
+    TickType_t    last_wake  = xTaskGetTickCount();
+    uint32_t      generation = 0;
+    int64_t       last_log   = esp_timer_get_time();
+    input_stats_t last_stats = {0};
+    uint64_t      last_bytes = 0;
+
+#if CONFIG_HID_EPAPER_SCHEDULE
+    const epaper_schedule_config_t epaper_config = {
+        .batch_us         = CONFIG_HID_EPAPER_BATCH_MS * 1000,
+        .min_interval_us  = CONFIG_HID_EPAPER_MIN_INTERVAL_MS * 1000,
+        .partial_max_area = (uint32_t)(display_h_res * display_v_res * CONFIG_HID_EPAPER_PARTIAL_MAX_PERCENT / 100),
+        .full_every       = CONFIG_HID_EPAPER_FULL_EVERY,
+        .full_interval_us = CONFIG_HID_EPAPER_FULL_INTERVAL_S * 1000000,
+    };
+    epaper_schedule_t epaper;
+    epaper_schedule_init(&epaper, &epaper_config, esp_timer_get_time());
+    bool changed = false;
+#endif
+
+    while (true) {
+        xTaskDelayUntil(&last_wake, period);
+
+        // Published after the snapshot was updated, so the snapshot holds at least this state. When
+        // the input task was preempted in the middle of a write the generation is taken next frame.
+        if (input_state_get_if_changed(&frame_state, generation) &&
+            hid_input_snapshot_read(hid_input_get_snapshot(), &frame_input)) {
+            generation = frame_state.generation;
+            update_cursor(&frame_input, esp_timer_get_time());
+#if CONFIG_HID_EPAPER_SCHEDULE
+            epaper_schedule_changed(&epaper, esp_timer_get_time());
+            changed = true;
+#else
+            draw_frame(&frame_state, &frame_input);
+            int64_t drawn_us = esp_timer_get_time();
+            input_state_count_frame();
+            flush_frame(drawn_us, true);
+#endif
+        }
+
+#if CONFIG_HID_EPAPER_SCHEDULE
+        int64_t now = esp_timer_get_time();
+        if (epaper_schedule_due(&epaper, now)) {
+            draw_frame(&frame_state, &frame_input);
+            int64_t drawn_us = esp_timer_get_time();
+            if (epaper_schedule_refresh(&epaper, now, damage_pending_area()) == EPAPER_REFRESH_FULL) {
+                damage_add_all();
+            }
+            input_state_count_frame();
+            // A ghosting cleanup shows no new input, its latency would only be the idle time
+            flush_frame(drawn_us, changed);
+            changed = false;
+        }
+#endif
+
+        if (latency_take_dump_request()) {
+            latency_dump();
+        }
+
+        log_stats(esp_timer_get_time(), &last_log, &last_stats, &last_bytes);
+    }
+}
+
+/**
+ * @brief Initializes the display and the PAX framebuffer
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t render_init(void) {
+    // Get display parameters and rotation
+    esp_err_t res =
+        bsp_display_get_parameters(&display_h_res, &display_v_res, &display_color_format, &display_data_endian);
+    if (res != ESP_OK) {
+        return res;
+    }
+    bsp_display_rotation_t display_rotation = bsp_display_get_default_rotation();
+
+    // Convert ESP-IDF color format into PAX buffer type
+    pax_buf_type_t format         = PAX_BUF_24_888RGB;
+    uint8_t        bits_per_pixel = 24;
+    switch (display_color_format) {
+        case LCD_COLOR_PIXEL_FORMAT_RGB565:
+            format         = PAX_BUF_16_565RGB;
+            bits_per_pixel = 16;
+            break;
+        case LCD_COLOR_PIXEL_FORMAT_RGB888:
+            format         = PAX_BUF_24_888RGB;
+            bits_per_pixel = 24;
+            break;
+        default:
+            break;
+    }
+
+    // Convert BSP display rotation format into PAX orientation type
+    pax_orientation_t orientation = PAX_O_UPRIGHT;
+    switch (display_rotation) {
+        case BSP_DISPLAY_ROTATION_90:
+            orientation = PAX_O_ROT_CCW;
+            break;
+        case BSP_DISPLAY_ROTATION_180:
+            orientation = PAX_O_ROT_HALF;
+            break;
+        case BSP_DISPLAY_ROTATION_270:
+            orientation = PAX_O_ROT_CW;
+            break;
+        case BSP_DISPLAY_ROTATION_0:
+        default:
+            orientation = PAX_O_UPRIGHT;
+            break;
+    }
+
+    // Initialize graphics stack
+#if defined(CONFIG_BSP_TARGET_KAMI)
+    format         = PAX_BUF_2_PAL;
+    bits_per_pixel = 2;
+#endif
+
+    bool rotated  = orientation == PAX_O_ROT_CCW || orientation == PAX_O_ROT_CW;
+    screen_width  = rotated ? display_v_res : display_h_res;
+    screen_height = rotated ? display_h_res : display_v_res;
+
+#if CONFIG_HID_FRAMEBUFFER_STRIPS
+    // A strip is a band of user rows, which are raw columns when rotated: keep whole bytes per raw row
+    int pixel_align = bits_per_pixel < 8 ? 8 / bits_per_pixel : 1;
+    if (rotated) {
+        strip_lines = (strip_lines + pixel_align - 1) / pixel_align * pixel_align;
+    }
+    if (strip_lines > screen_height) {
+        strip_lines = screen_height;
+    }
+    bool fb_allocated = rotated ? pax_buf_init(&fb, NULL, strip_lines, display_v_res, format)
+                                : pax_buf_init(&fb, NULL, display_h_res, strip_lines, format);
+    draw_list_init(&scene, scene_ops, CONFIG_HID_DRAW_LIST_OPS, scene_text, sizeof(scene_text), WHITE);
+    ESP_LOGI(TAG, "Rendering in strips of %d rows, %u byte strip buffer, %u byte draw list", strip_lines,
+             (unsigned)((size_t)screen_width * strip_lines * bits_per_pixel / 8),
+             (unsigned)(sizeof(scene_ops) + sizeof(scene_text)));
+#else
+    bool fb_allocated = pax_buf_init(&fb, NULL, display_h_res, display_v_res, format);
+#endif
+    if (!fb_allocated) {
+        ESP_LOGE(TAG, "Failed to allocate framebuffer");
+        return ESP_ERR_NO_MEM;
+    }
+    fb_format         = format;
+    fb_bits_per_pixel = bits_per_pixel;
+    pax_buf_reversed(&fb, display_data_endian == LCD_RGB_DATA_ENDIAN_BIG);
+
+#if defined(CONFIG_BSP_TARGET_KAMI)
+    fb.palette      = palette;
+    fb.palette_size = sizeof(palette) / sizeof(pax_col_t);
+#endif
+
+    pax_buf_set_orientation(&fb, orientation);
+
+    pax_background(&fb, WHITE);
+
+    pax_vec2f cell = pax_text_size(FONT, FONT_SIZE, "0");
+    cell_width     = cell.x;
+    cell_height    = (int)(cell.y + 0.999f);
+#if CONFIG_HID_TEXT_CACHE
+    const text_cache_ops_t glyph_ops = {.render = render_glyph, .destroy = destroy_glyph};
+    text_cache_init(&glyph_cache, glyph_cache_entries, CONFIG_HID_TEXT_CACHE_ENTRIES, CONFIG_HID_TEXT_CACHE_SIZE,
+                    &glyph_ops);
+#endif
+
+    res = damage_init(&fb, display_h_res, display_v_res, bits_per_pixel);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    const mouse_accel_t accel = {
+        .sensitivity_q8 = PERCENT_TO_Q8(CONFIG_HID_MOUSE_SENSITIVITY),
+        .accel_q8       = PERCENT_TO_Q8(CONFIG_HID_MOUSE_ACCEL),
+        .threshold_q8   = CONFIG_HID_MOUSE_ACCEL_THRESHOLD * 256,
+        .max_gain_q8    = PERCENT_TO_Q8(CONFIG_HID_MOUSE_ACCEL_MAX),
+    };
+    mouse_motion_init(&cursor, &accel, screen_width - CURSOR_SIZE + 1, screen_height - CURSOR_SIZE + 1);
+
+    cls();
+    return ESP_OK;
+}
+
+/**
+ * @brief Starts the render task
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t render_start(void) {
+    BaseType_t core = CONFIG_HID_RENDER_TASK_CORE < portNUM_PROCESSORS ? CONFIG_HID_RENDER_TASK_CORE : tskNO_AFFINITY;
+
+    BaseType_t task_created = xTaskCreatePinnedToCore(render_task, "render", CONFIG_HID_RENDER_TASK_STACK_SIZE, NULL,
+                                                      CONFIG_HID_RENDER_TASK_PRIORITY, NULL, core);
+    if (task_created != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to create render task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
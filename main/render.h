@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t render_init(void);
+
+esp_err_t render_start(void);
@@ -0,0 +1,114 @@
+// report_ring.c
+//
+// Lock-free single-producer/single-consumer ring buffer for timestamped raw HID reports.
+// The producer never blocks: when the ring is full the report is counted as dropped.
+
+#include "report_ring.h"
+
+/**
+ * @brief Initializes a ring on caller provided storage
+ *
+ * @param ring Ring to initialize.
+ * @param entries Storage for depth entries.
+ * @param depth Number of entries, must be a power of two.
+ * @return true on success, false when depth is not a power of two.
+ */
+bool report_ring_init(report_ring_t* ring, report_ring_entry_t* entries, size_t depth) {
+    if (depth == 0 || (depth & (depth - 1)) != 0) {
+        return false;
+    }
+
+    ring->entries = entries;
+    ring->mask    = depth - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->high_watermark, 0);
+    return true;
+}
+
+/**
+ * @brief Returns the next free slot for the producer to fill in place
+ *
+ * The slot only becomes visible to the consumer after report_ring_commit().
+ *
+ * @param ring Ring to write to.
+ * @return Pointer to the free slot, or NULL when the ring is full (the report is counted as dropped).
+ */
+report_ring_entry_t* report_ring_reserve(report_ring_t* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    return &ring->entries[head & ring->mask];
+}
+
+/**
+ * @brief Publishes the slot returned by report_ring_reserve() to the consumer
+ *
+ * @param ring Ring to write to.
+ */
+void report_ring_commit(report_ring_t* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed) + 1;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+
+    uint32_t used = head - tail;
+    if (used > atomic_load_explicit(&ring->high_watermark, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_watermark, used, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Returns the oldest report without removing it
+ *
+ * @param ring Ring to read from.
+ * @return Pointer to the oldest report, or NULL when the ring is empty.
+ */
+const report_ring_entry_t* report_ring_front(report_ring_t* ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    return &ring->entries[tail & ring->mask];
+}
+
+/**
+ * @brief Removes the report returned by report_ring_front()
+ *
+ * @param ring Ring to read from.
+ */
+void report_ring_pop(report_ring_t* ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * @brief Number of reports currently queued
+ */
+size_t report_ring_count(report_ring_t* ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+/**
+ * @brief Number of reports dropped because the ring was full
+ */
+uint32_t report_ring_dropped(report_ring_t* ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+/**
+ * @brief Highest number of reports that were queued at once
+ */
+uint32_t report_ring_high_watermark(report_ring_t* ring) {
+    return atomic_load_explicit(&ring->high_watermark, memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPORT_RING_PAYLOAD_MAX 64
+
+/**
+ * @brief Raw input report as received from the HID driver
+ */
+typedef struct {
+    int64_t timestamp_us;  // Arrival time, esp_timer_get_time()
+    uint8_t length;
+    uint8_t data[REPORT_RING_PAYLOAD_MAX];
+} report_ring_entry_t;
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of raw input reports
+ *
+ * The producer (HID driver task) only writes head, dropped and high_watermark; the consumer
+ * only writes tail. Storage is provided by the caller, depth must be a power of two.
+ */
+typedef struct {
+    report_ring_entry_t* entries;
+    uint32_t             mask;
+    _Atomic uint32_t     head;
+    _Atomic uint32_t     tail;
+    _Atomic uint32_t     dropped;
+    _Atomic uint32_t     high_watermark;
+} report_ring_t;
+
+bool report_ring_init(report_ring_t* ring, report_ring_entry_t* entries, size_t depth);
+
+report_ring_entry_t* report_ring_reserve(report_ring_t* ring);
+
+void report_ring_commit(report_ring_t* ring);
+
+const report_ring_entry_t* report_ring_front(report_ring_t* ring);
+
+void report_ring_pop(report_ring_t* ring);
+
+size_t report_ring_count(report_ring_t* ring);
+
+uint32_t report_ring_dropped(report_ring_t* ring);
+
+uint32_t report_ring_high_watermark(report_ring_t* ring);
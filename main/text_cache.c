@@ -0,0 +1,149 @@
+// text_cache.c
+//
+// LRU cache of pre-rendered text surfaces. Rasterizing a string is far more expensive than
+// copying its pixels, so strings that are drawn over and over (glyphs of changing numbers,
+// captions) are rendered once and blitted from the cache afterwards.
+
+#include "text_cache.h"
+#include <string.h>
+
+// FNV-1a, cheap and good enough to skip most string compares
+static uint32_t hash_key(const void* font, uint16_t size, const char* text) {
+    uint32_t hash = 2166136261u ^ (uint32_t)(uintptr_t)font ^ ((uint32_t)size << 16);
+
+    for (const char* c = text; *c != '\0'; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void release(text_cache_t* cache, text_cache_entry_t* entry) {
+    cache->ops.destroy(cache->ops.ctx, entry->surface);
+    cache->bytes    -= entry->bytes;
+    entry->surface   = NULL;
+    entry->bytes     = 0;
+    entry->last_used = 0;
+}
+
+static text_cache_entry_t* least_recently_used(text_cache_t* cache) {
+    text_cache_entry_t* oldest = NULL;
+
+    for (size_t i = 0; i < cache->capacity; i++) {
+        text_cache_entry_t* entry = &cache->entries[i];
+        if (entry->last_used != 0 && (oldest == NULL || entry->last_used < oldest->last_used)) {
+            oldest = entry;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Initializes an empty cache on caller provided storage
+ *
+ * @param[in] cache     Cache to initialize
+ * @param[in] entries   Storage for capacity entries
+ * @param[in] capacity  Maximum number of cached strings
+ * @param[in] budget    Maximum total size of the cached surfaces in bytes
+ * @param[in] ops       Functions to render and free surfaces
+ */
+void text_cache_init(text_cache_t* cache, text_cache_entry_t* entries, size_t capacity, size_t budget,
+                     const text_cache_ops_t* ops) {
+    memset(cache, 0, sizeof(*cache));
+    memset(entries, 0, capacity * sizeof(*entries));
+    cache->entries  = entries;
+    cache->capacity = capacity;
+    cache->budget   = budget;
+    cache->ops      = *ops;
+}
+
+/**
+ * @brief Looks up the surface of a string, rendering and caching it on a miss
+ *
+ * Older surfaces are evicted until the new one fits in the entries and the memory budget.
+ *
+ * @param[in] cache  Cache
+ * @param[in] font   Font the string is drawn in
+ * @param[in] size   Font size
+ * @param[in] text   String
+ * @return Cached surface, or NULL when the string is too long, larger than the whole budget or
+ *         could not be rendered; the caller then draws the text directly
+ */
+const text_cache_entry_t* text_cache_get(text_cache_t* cache, const void* font, uint16_t size, const char* text) {
+    size_t length = strlen(text);
+    if (length == 0 || length >= TEXT_CACHE_TEXT_MAX || cache->capacity == 0) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_key(font, size, text);
+    if (++cache->clock == 0) {
+        // 0 marks free entries, start over rather than confuse the ages
+        text_cache_clear(cache);
+        cache->clock = 1;
+    }
+
+    for (size_t i = 0; i < cache->capacity; i++) {
+        text_cache_entry_t* entry = &cache->entries[i];
+        if (entry->last_used != 0 && entry->hash == hash && entry->font == font && entry->size == size &&
+            strcmp(entry->text, text) == 0) {
+            entry->last_used = cache->clock;
+            cache->hits++;
+            return entry;
+        }
+    }
+
+    cache->misses++;
+
+    int    width, height;
+    size_t bytes;
+    void*  surface = cache->ops.render(cache->ops.ctx, font, size, text, &width, &height, &bytes);
+    if (surface == NULL) {
+        return NULL;
+    }
+    if (bytes > cache->budget) {
+        cache->ops.destroy(cache->ops.ctx, surface);
+        return NULL;
+    }
+
+    // Make room: a free entry and enough of the budget
+    text_cache_entry_t* slot = NULL;
+    for (size_t i = 0; i < cache->capacity && slot == NULL; i++) {
+        if (cache->entries[i].last_used == 0) {
+            slot = &cache->entries[i];
+        }
+    }
+    while (slot == NULL || cache->bytes + bytes > cache->budget) {
+        text_cache_entry_t* victim = least_recently_used(cache);
+        release(cache, victim);
+        cache->evictions++;
+        if (slot == NULL) {
+            slot = victim;
+        }
+    }
+
+    slot->font      = font;
+    slot->size      = size;
+    slot->hash      = hash;
+    slot->last_used = cache->clock;
+    slot->surface   = surface;
+    slot->bytes     = bytes;
+    slot->width     = width;
+    slot->height    = height;
+    memcpy(slot->text, text, length + 1);
+    cache->bytes += bytes;
+
+    return slot;
+}
+
+/**
+ * @brief Frees all cached surfaces
+ *
+ * @param[in] cache  Cache
+ */
+void text_cache_clear(text_cache_t* cache) {
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].last_used != 0) {
+            release(cache, &cache->entries[i]);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TEXT_CACHE_TEXT_MAX 24  // Longest cacheable string, including the terminator
+
+/**
+ * @brief Rasterizes and frees text surfaces for the cache
+ *
+ * render returns the surface of the text (NULL on failure) and fills in its size in pixels
+ * and the memory it occupies; destroy releases a surface returned by render.
+ */
+typedef struct {
+    void* (*render)(void* ctx, const void* font, uint16_t size, const char* text, int* width, int* height,
+                    size_t* bytes);
+    void (*destroy)(void* ctx, void* surface);
+    void* ctx;
+} text_cache_ops_t;
+
+/**
+ * @brief Pre-rendered text surface
+ */
+typedef struct {
+    const void* font;
+    uint16_t    size;
+    uint32_t    hash;
+    uint32_t    last_used;  // Cache clock at the last lookup, 0 for a free entry
+    void*       surface;
+    size_t      bytes;
+    int         width;
+    int         height;
+    char        text[TEXT_CACHE_TEXT_MAX];
+} text_cache_entry_t;
+
+/**
+ * @brief Text surfaces keyed by (font, size, string), least recently used evicted first
+ *
+ * Bounded both by the number of entries and by the memory of the surfaces. Storage for the
+ * entries is provided by the caller. Not thread safe, meant to be owned by the render task.
+ */
+typedef struct {
+    text_cache_entry_t* entries;
+    size_t              capacity;
+    size_t              budget;  // Maximum total size of the surfaces in bytes
+    size_t              bytes;   // Current total size of the surfaces
+    uint32_t            clock;
+    text_cache_ops_t    ops;
+    uint32_t            hits;
+    uint32_t            misses;
+    uint32_t            evictions;
+} text_cache_t;
+
+void text_cache_init(text_cache_t* cache, text_cache_entry_t* entries, size_t capacity, size_t budget,
+                     const text_cache_ops_t* ops);
+
+const text_cache_entry_t* text_cache_get(text_cache_t* cache, const void* font, uint16_t size, const char* text);
+
+void text_cache_clear(text_cache_t* cache);